@@ -0,0 +1,263 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#if !defined(NAKED)
+   #include <stdlib.h>
+   #include <string.h>
+   #include <assert.h>
+#endif
+
+#include "bn.h"
+
+#if defined(_MSC_VER)
+   #define ARENA_TLS __declspec(thread)
+#else
+   #define ARENA_TLS __thread
+#endif
+
+/*! Allocator outside arena scopes. */
+#if defined(BN_POOL)
+   #define _arena_heap_alloc(x) pool_alloc(x)
+   #define _arena_heap_realloc(x, y) pool_realloc(x, y)
+   #define _arena_heap_free(x) pool_free(x)
+#else
+   #define _arena_heap_alloc(x) malloc(x)
+   #define _arena_heap_realloc(x, y) realloc(x, y)
+   #define _arena_heap_free(x) free(x)
+#endif
+
+/*! Alignment of every block, enough for any limb or vector load. */
+#define ARENA_ALIGN 16
+
+/*! Chunk header, the data follows it. */
+typedef struct _arena_chunk_t
+{
+   struct _arena_chunk_t *next;
+   size_t size, used;
+   /*! Arena the chunk belongs to. */
+   arena_t *arena;
+   u8 pad[ARENA_ALIGN - (2 * sizeof(size_t) + 2 * sizeof(void *)) % ARENA_ALIGN];
+} arena_chunk_t;
+
+/*! Block header: the block's size and the chunk it was bumped from, NULL for a heap block. */
+typedef struct _arena_block_t
+{
+   size_t size;
+   arena_chunk_t *chunk;
+} arena_block_t;
+
+/*! Every block, heap blocks included, starts with a header padded to keep the data aligned. */
+#define ARENA_HDR ARENA_ALIGN
+
+#define _arena_data(c) ((u8 *)((c) + 1))
+#define _arena_block(p) ((arena_block_t *)((u8 *)(p) - ARENA_HDR))
+
+// Innermost scope and scratch arena of the calling thread
+static ARENA_TLS arena_scope_t *_arena_top = NULL;
+static ARENA_TLS arena_t *_arena_scratch = NULL;
+
+arena_t *arena_alloc(size_t chunk)
+{
+   arena_t *a = malloc(sizeof(arena_t));
+
+   a->first = a->cur = NULL;
+   a->chunk = chunk;
+
+   return a;
+}
+
+void arena_free(arena_t *a)
+{
+   if(a == NULL)
+      return;
+
+   for(arena_chunk_t *c = a->first, *n; c != NULL; c = n)
+   {
+      n = c->next;
+      free(c);
+   }
+
+   free(a);
+}
+
+arena_t *arena_scratch(void)
+{
+   if(_arena_scratch == NULL)
+      _arena_scratch = arena_alloc(BN_ARENA_CHUNK_BYTES);
+
+   return _arena_scratch;
+}
+
+void arena_scratch_free(void)
+{
+   arena_free(_arena_scratch);
+   _arena_scratch = NULL;
+}
+
+void arena_push(arena_scope_t *s, arena_t *a)
+{
+   s->arena = a;
+   s->prev = _arena_top;
+   s->cur = a ? a->cur : NULL;
+   s->used = (a && a->cur) ? a->cur->used : 0;
+
+   _arena_top = s;
+}
+
+void arena_pop(arena_scope_t *s)
+{
+   arena_t *a = s->arena;
+
+   if(a != NULL && a->cur != NULL)
+   {
+      // Empty the chunks bumped in the scope, so that a free from them can be told apart
+      for(arena_chunk_t *c = s->cur ? s->cur->next : a->first; c != a->cur->next; c = c->next)
+         c->used = 0;
+
+      a->cur = s->cur;
+
+      if(s->cur != NULL)
+         s->cur->used = s->used;
+   }
+
+   _arena_top = s->prev;
+}
+
+// Bump SIZE bytes (already aligned) off A, moving on to the next chunk that fits
+static void *_arena_bump(arena_t *a, size_t size)
+{
+   arena_chunk_t *c = a->cur;
+   size_t need = size + ARENA_HDR;
+
+   if(c == NULL || c->used + need > c->size)
+   {
+      arena_chunk_t *n = c ? c->next : a->first;
+
+      // Chunks past the current one are free, insert a new one if the next is too small
+      if(n == NULL || n->size < need)
+      {
+         size_t sz = MAX(a->chunk, need);
+         arena_chunk_t *t = malloc(sizeof(arena_chunk_t) + sz);
+
+         t->size = sz;
+         t->next = n;
+         t->arena = a;
+
+         if(c)
+            c->next = t;
+         else
+            a->first = t;
+
+         // Grow geometrically, to keep the number of chunks logarithmic
+         a->chunk = 2 * sz;
+         n = t;
+      }
+
+      n->used = 0;
+      a->cur = c = n;
+   }
+
+   arena_block_t *b = (arena_block_t *)(_arena_data(c) + c->used);
+
+   b->size = size;
+   b->chunk = c;
+   c->used += need;
+
+   return (u8 *)b + ARENA_HDR;
+}
+
+// Is the arena block P still live, i.e., not in a region a scope has released?
+static int _arena_is_live(u8 *p)
+{
+   arena_chunk_t *c = _arena_block(p)->chunk;
+
+   return p + _arena_block(p)->size <= _arena_data(c) + c->used;
+}
+
+// Is the arena block P the last one bumped off its arena?
+static int _arena_is_last(u8 *p)
+{
+   arena_chunk_t *c = _arena_block(p)->chunk;
+
+   return c == c->arena->cur && p + _arena_block(p)->size == _arena_data(c) + c->used;
+}
+
+void *arena_mem_alloc(size_t size)
+{
+   if(_arena_top == NULL || _arena_top->arena == NULL)
+   {
+      arena_block_t *b = _arena_heap_alloc(size + ARENA_HDR);
+
+      if(b == NULL)
+         return NULL;
+
+      b->chunk = NULL;
+
+      return (u8 *)b + ARENA_HDR;
+   }
+
+   return _arena_bump(_arena_top->arena, (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+}
+
+void *arena_mem_realloc(void *p, size_t size)
+{
+   arena_t *a;
+
+   if(p == NULL)
+      return arena_mem_alloc(size);
+
+   if(_arena_block(p)->chunk == NULL)
+   {
+      arena_block_t *b = _arena_heap_realloc(_arena_block(p), size + ARENA_HDR);
+
+      return b ? (u8 *)b + ARENA_HDR : NULL;
+   }
+
+   assert(_arena_is_live(p));
+
+   a = _arena_block(p)->chunk->arena;
+
+   size_t old = _arena_block(p)->size;
+
+   size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+   if(size <= old)
+      return p;
+
+   // Grow in place when nothing was bumped after P
+   if(_arena_is_last(p) && a->cur->used + size - old <= a->cur->size)
+   {
+      _arena_block(p)->size = size;
+      a->cur->used += size - old;
+      return p;
+   }
+
+   void *q = _arena_bump(a, size);
+
+   memcpy(q, p, old);
+
+   return q;
+}
+
+void arena_mem_free(void *p)
+{
+   arena_chunk_t *c;
+
+   if(p == NULL)
+      return;
+
+   if((c = _arena_block(p)->chunk) == NULL)
+   {
+      _arena_heap_free(_arena_block(p));
+      return;
+   }
+
+   // A block from a region that arena_pop already released is a dangling pointer
+   assert(_arena_is_live(p));
+
+   // Only the last block goes back, the rest waits for arena_pop
+   if(_arena_is_last(p))
+      c->used -= _arena_block(p)->size + ARENA_HDR;
+}
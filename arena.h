@@ -0,0 +1,92 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#if !defined(NAKED)
+   #include <stddef.h>
+#endif
+
+/*!
+* Bump allocator for the temporaries of one high-level operation. Between
+* arena_push and arena_pop, mem_alloc on the calling thread takes memory from
+* the scope's arena, mem_free only takes back the most recent allocation, and
+* arena_pop releases everything in one go. Anything that has to outlive the
+* scope (cached contexts, results) is allocated in a nested heap scope, i.e.,
+* one pushed with a NULL arena.
+*/
+
+struct _arena_chunk_t;
+
+/*! Arena: a list of chunks, kept across scopes and bumped one after another. */
+typedef struct _arena_t
+{
+   /*! First chunk, and the one being bumped (NULL before the first allocation). */
+   struct _arena_chunk_t *first, *cur;
+   /*! Size (in bytes) of the next chunk. */
+   size_t chunk;
+} arena_t;
+
+/*! Scope on the calling thread, kept on the caller's stack. */
+typedef struct _arena_scope_t
+{
+   /*! Arena allocations come from, NULL for the heap. */
+   arena_t *arena;
+   /*! Enclosing scope. */
+   struct _arena_scope_t *prev;
+   /*! Where the arena stood at arena_push. */
+   struct _arena_chunk_t *cur;
+   size_t used;
+} arena_scope_t;
+
+/*!
+* \brief Allocate an arena whose first chunk is of the given size (in bytes).
+*/
+arena_t *arena_alloc(size_t chunk);
+
+/*!
+* \brief Free the arena and all of its chunks. It must not be in any scope.
+*/
+void arena_free(arena_t *a);
+
+/*!
+* \brief The calling thread's scratch arena, allocated on first use.
+*/
+arena_t *arena_scratch(void);
+
+/*!
+* \brief Free the calling thread's scratch arena, e.g., before the thread exits.
+*/
+void arena_scratch_free(void);
+
+/*!
+* \brief Enter a scope allocating from A (or from the heap, for A = NULL).
+*/
+void arena_push(arena_scope_t *s, arena_t *a);
+
+/*!
+* \brief Leave the innermost scope, releasing what was allocated in it.
+*/
+void arena_pop(arena_scope_t *s);
+
+/*!
+* \brief Allocate from the innermost scope.
+*/
+void *arena_mem_alloc(size_t size);
+
+/*!
+* \brief Resize memory from arena_mem_alloc. Heap blocks stay on the heap.
+*/
+void *arena_mem_realloc(void *p, size_t size);
+
+/*!
+* \brief Free memory from arena_mem_alloc. Blocks know their arena, so this works
+*        from any scope, but not for a block whose scope has been popped (an
+*        assert with BN_ASSERT).
+*/
+void arena_mem_free(void *p);
+
+#endif // _ARENA_H_
@@ -31,6 +31,10 @@ void bls_sign(bls_ctxt_t *ctxt, ec_pqr_point_t *sig, bn_t *m)
 
 int bls_verify(bls_ctxt_t *ctxt, ec_pqr_point_t *sig, bn_t *m)
 {
+	// Both pairings and everything around them share the scratch arena.
+	arena_scope_t s;
+	arena_push(&s, arena_scratch());
+
 	int res = 0;
 
 	poly_t *a = poly_alloc(ctxt->ecg->p->degree - 1, ctxt->p, 1);
@@ -49,5 +53,7 @@ int bls_verify(bls_ctxt_t *ctxt, ec_pqr_point_t *sig, bn_t *m)
 	poly_free(b, 1);
 	poly_free(a, 1);
 
+	arena_pop(&s);
+
 	return res;
 }
@@ -19,9 +19,27 @@
 #endif
 
 #include "bn.h"
+#include "recode.h"
+
+// The contexts cached in a bignum are published once, with a CAS, and never replaced while in use
+#if defined(_MSC_VER)
+   #define _bn_ctxt_load(p) (*(void * volatile *)(p))
+   #define _bn_ctxt_cas(p, n) (InterlockedCompareExchangePointer((PVOID volatile *)(p), (n), NULL) == NULL)
+#else
+   #define _bn_ctxt_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+   #define _bn_ctxt_cas(p, n) __extension__({ __typeof__(n) _o = NULL; \
+      __atomic_compare_exchange_n((p), &_o, (n), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); })
+#endif
+
+// Hand-written x86-64 kernels, picked at load time through CPUID
+#if defined(BN_ASM) && BN_LIMB_SIZE == 64 && defined(__x86_64__) && defined(__GNUC__)
+   #define BN_X86_64
+   #include <cpuid.h>
+   #include <immintrin.h>
+#endif
 
 // Fast Montgomery initialization (taken from PolarSSL)
-static void _bn_mon_init(bn_t *n)
+static ul_t _bn_mon_init(bn_t *n)
 {
    ul_t x, m0 = n->l[0];
 
@@ -31,7 +49,7 @@ static void _bn_mon_init(bn_t *n)
    for(int i = BN_LIMB_BITS; i >= 8; i /= 2)
       x *= (2 - (m0 * x));
 
-   n->mp = ~x + 1;
+   return ~x + 1;
 }
 
 static u8 _bn_str_to_u8(const s8 *str)
@@ -57,13 +75,37 @@ static u8 _bn_str_to_u8(const s8 *str)
    return res;
 }
 
+// Set the used limbs of A, knowing that all its limbs from top up are zero.
+static bn_t *_bn_norm(bn_t *a, int top)
+{
+   while(top > 0 && !a->l[top - 1])
+      top--;
+
+   a->used = top;
+
+   return a;
+}
+
+// Finish a write of D's limbs below top, out of its nl low ones: whatever D
+// still had between top and nl is cleared, then the used limbs are updated.
+static void _bn_clear_top(bn_t *d, int top, int nl)
+{
+   for(int i = top; i < MIN(nl, d->used); i++)
+      d->l[i] = 0;
+
+   _bn_norm(d, MAX(d->used, top));
+}
+
+// The loops below stop at the used limbs of the operands, past which only a
+// carry or borrow can still change D.
 static int _bn_add(bn_t *d, bn_t *a, bn_t *b)
 {
    ull_t C = 0;
+   int nl = MIN(a->n_limbs, b->n_limbs), top = MAX(a->used, b->used), i;
 
 //   assert(a->n == b->n);
 
-   for(int i = 0; i < MIN(a->n_limbs, b->n_limbs); i++)
+   for(i = 0; i < nl && (i < top || C); i++)
    {
       C += (ull_t)a->l[i] + b->l[i];
       d->l[i] = C;
@@ -71,14 +113,17 @@ static int _bn_add(bn_t *d, bn_t *a, bn_t *b)
       C >>= BN_LIMB_BITS;
    }
 
+   _bn_clear_top(d, i, nl);
+
    return C;
 }
 
 static int _bn_add_ui(bn_t *d, bn_t *a, ul_t b)
 {
    ull_t C = b;
+   int nl = a->n_limbs, top = a->used, i;
 
-   for(int i = 0; i < a->n_limbs; i++)
+   for(i = 0; i < nl && (i < top || C); i++)
    {
       C += (ull_t)a->l[i];
       d->l[i] = C;
@@ -86,16 +131,19 @@ static int _bn_add_ui(bn_t *d, bn_t *a, ul_t b)
       C >>= BN_LIMB_BITS;
    }
 
+   _bn_clear_top(d, i, nl);
+
    return C;
 }
 
 static int _bn_sub(bn_t *d, bn_t *a, bn_t *b)
 {
    ull_t C = 1;
+   int nl = MIN(a->n_limbs, b->n_limbs), top = MAX(a->used, b->used), i;
 
 //   assert(a->n == b->n);
 
-   for(int i = 0; i < MIN(a->n_limbs, b->n_limbs); i++)
+   for(i = 0; i < nl && (i < top || !C); i++)
    {
       C += (ull_t)a->l[i] + BN_MAX_DIGIT - b->l[i];
       d->l[i] = C;
@@ -103,22 +151,28 @@ static int _bn_sub(bn_t *d, bn_t *a, bn_t *b)
       C >>= BN_LIMB_BITS;
    }
 
+   _bn_clear_top(d, i, nl);
+
    return 1 - C;
 }
 
 static int _bn_sub_ui(bn_t *d, bn_t *a, ul_t b)
 {
-   ull_t C = 1 + BN_MAX_DIGIT - b;
+   ul_t B = b;
+   int nl = a->n_limbs, top = a->used, i;
 
-   for(int i = 0; i < a->n_limbs; i++)
+   // The borrow has to ripple through all the limbs, not just the first
+   for(i = 0; i < nl && (i < top || B); i++)
    {
-      C += (ull_t)a->l[i];
-      d->l[i] = C;
+      ul_t t = a->l[i];
 
-      C >>= BN_LIMB_BITS;
+      d->l[i] = t - B;
+      B = t < B;
    }
 
-   return 1 - C;
+   _bn_clear_top(d, i, nl);
+
+   return B;
 }
 
 // Runtime endianess detection. A bit slower, but no macro magic needed
@@ -137,13 +191,13 @@ static bn_t *_bn_lshift_limbs(bn_t *a, int n)
 {
    int i;
 
-   for(i = a->n_limbs; i >= n; i--)
+   for(i = a->n_limbs - 1; i >= n; i--)
       a->l[i] = a->l[i-n];
 
    while(i >= 0)
       a->l[i--] = 0;
 
-   return a;
+   return _bn_norm(a, MIN(a->n_limbs, a->used + n));
 }
 
 static bn_t *_bn_lshift(bn_t *a, int b)
@@ -155,7 +209,10 @@ static bn_t *_bn_lshift(bn_t *a, int b)
    if(b != BN_LIMB_BITS)
       mask = ~(mask >> b);
 
-   for(int x = 0; x < a->n_limbs; x++)
+   // Nothing gets shifted into the limbs past the one above the top
+   int top = MIN(a->n_limbs, a->used + 1);
+
+   for(int x = 0; x < top; x++)
    {
       c = a->l[x] & mask;
 
@@ -168,13 +225,14 @@ static bn_t *_bn_lshift(bn_t *a, int b)
       prev_c = c;
    }
 
-   return a;
+   return _bn_norm(a, top);
 }
 
 static bn_t *_bn_rshift_limbs(bn_t *a, int n)
 {
    // Makes the code run faster
    memmove(a->l, &a->l[n], (a->n_limbs - n) * BN_LIMB_BYTES);
+   memset(&a->l[a->n_limbs - n], 0, n * BN_LIMB_BYTES);
 
 /*
    int x;
@@ -185,7 +243,7 @@ static bn_t *_bn_rshift_limbs(bn_t *a, int n)
    while(x <= n)
       a->l[x++] = 0;
 */
-   return a;
+   return _bn_norm(a, MAX(a->used - n, 0));
 }
 
 static bn_t *_bn_rshift(bn_t *a, int b)
@@ -197,7 +255,7 @@ static bn_t *_bn_rshift(bn_t *a, int b)
    // Create the mask
    mask = ((ull_t)1 << b) - 1;
 
-   for(int x = a->n_limbs - 1; x >= 0; x--)
+   for(int x = a->used - 1; x >= 0; x--)
    {
       c = a->l[x] & mask;
 
@@ -210,854 +268,3490 @@ static bn_t *_bn_rshift(bn_t *a, int b)
       prev_c = c;
    }
 
-   return a;
+   return _bn_norm(a, a->used);
 }
 
-// Helper function which multiplies and adds in a single run.
-static bn_t *_bn_mad_ui(bn_t *d, bn_t *a, ul_t b)
+static int _bn_cmp_limbs(const ul_t *a, const ul_t *b, int nl)
 {
-   // D = D + A * b
-   int x;
-   ull_t S = 0;
+   for(int x = nl - 1; x >= 0; x--)
+   {
+      if(a[x] < b[x])
+         return BN_CMP_L;
+      else if(a[x] > b[x])
+         return BN_CMP_G;
+   }
 
-   // Can a hold the result?
-   assert(d->n >= (a->n + 2));
+   return BN_CMP_E;
+}
 
-   for(x = 0; x < a->n_limbs; x++)
+static void _bn_sub_limbs(ul_t *d, const ul_t *a, const ul_t *b, int nl)
+{
+   ull_t C = 1;
+
+   for(int i = 0; i < nl; i++)
    {
-      S += (ull_t)a->l[x] * (ull_t)b + (ull_t)d->l[x];
-      d->l[x] = S;
+      C += (ull_t)a[i] + BN_MAX_DIGIT - b[i];
+      d[i] = C;
 
-      S >>= BN_LIMB_BITS;
+      C >>= BN_LIMB_BITS;
    }
+}
 
-   // Add in the remaining carry
-   while(S)
-   {
-      S += d->l[x];
-      d->l[x] = S;
+// Copy the low nl limbs of a, padding with zeroes.
+static ul_t *_bn_load_limbs(ul_t *d, bn_t *a, int nl)
+{
+   int s = MIN(a->used, nl);
 
-      S >>= BN_LIMB_BITS;
-      x++;
-   }
+   memcpy(d, a->l, s * BN_LIMB_BYTES);
+   memset(&d[s], 0, (nl - s) * BN_LIMB_BYTES);
 
    return d;
 }
 
-int bn_maxbit(bn_t *a)
+// Store nl limbs into d, with the same truncation rules as bn_copy.
+static bn_t *_bn_store_limbs(bn_t *d, const ul_t *s, int nl)
 {
-   for(int x = a->n_limbs * BN_LIMB_BITS; x >= 0; x--)
-      if(bn_getbit(a, x) != 0)
-         return x;
+   int k = MIN(d->n_limbs, nl);
+
+   memcpy(d->l, s, k * BN_LIMB_BYTES);
+   _bn_clear_top(d, k, d->n_limbs);
 
-   return 0;
+   return d;
 }
 
-int bn_getbit(bn_t *a, int x)
+// D = A + B on raw limbs. Returns the carry.
+static ul_t _bn_add_limbs(ul_t *d, const ul_t *a, const ul_t *b, int nl)
 {
-   return (a->l[x / BN_LIMB_BITS] >> (x % BN_LIMB_BITS)) & 1;
+   ull_t C = 0;
+
+   for(int i = 0; i < nl; i++)
+   {
+      C += (ull_t)a[i] + b[i];
+      d[i] = C;
+
+      C >>= BN_LIMB_BITS;
+   }
+
+   return C;
 }
 
-void bn_setbit(bn_t *a, int x)
+// Add a carry into d, rippling up to at most nl limbs.
+static void _bn_carry_limbs(ul_t *d, ul_t c, int nl)
 {
-   a->l[x / BN_LIMB_BITS] |= 1 << (x % BN_LIMB_BITS);
+   for(int i = 0; c && i < nl; i++)
+   {
+      d[i] += c;
+      c = d[i] < c;
+   }
 }
 
-bn_t *bn_from_bin(bn_t *a, s8 *s, int len)
+// D = A - B, where A has nl limbs and B has bl <= nl limbs. Returns the borrow.
+static ul_t _bn_subx_limbs(ul_t *d, const ul_t *a, int nl, const ul_t *b, int bl)
 {
-   int x, y, z, w;
-
-   ul_t limb;
-   u8 *p_limb = (u8 *)&limb;
+   ull_t C = 1;
 
-   for(x = len - 1, y = 0; x >= 0; y++)
+   for(int i = 0; i < nl; i++)
    {
-      limb = 0;
-
-      for(z = 0, w = 0; z < BN_LIMB_BYTES; z += 1, w += 1)
-      {
-         if(x < 0)
-            break;
-
-         p_limb[w] = s[x];
-
-         x -= 1;
-      }
-
-      if(_bn_big_endian())
-         limb = SWAP(limb);
+      C += (ull_t)a[i] + BN_MAX_DIGIT - (i < bl ? b[i] : 0);
+      d[i] = C;
 
-      a->l[y] = limb;
+      C >>= BN_LIMB_BITS;
    }
 
-   return a;
+   return 1 - C;
 }
 
-u8 *bn_to_bin(u8 *s, bn_t *a)
+// D = |A - B|, where A has nl limbs and B has bl <= nl limbs. Returns 1 if
+// B was the bigger one.
+static int _bn_absdiff_limbs(ul_t *d, const ul_t *a, int nl, const ul_t *b, int bl)
 {
-   ul_t *p = (ul_t *)s;
+   int x = nl - 1, neg;
+   ull_t C = 1;
 
-   int be = _bn_big_endian();
+   // Find the highest differing limb
+   while(x >= 0 && a[x] == (x < bl ? b[x] : 0))
+      x--;
 
-   for(int x = a->n_limbs - 1, y = 0; x >= 0; x--, y++)
+   neg = (x >= 0 && x < bl && a[x] < b[x]);
+
+   for(int i = 0; i < nl; i++)
    {
-      if(be)
-         p[y] = a->l[x];
+      ul_t ai = a[i], bi = (i < bl) ? b[i] : 0;
+
+      if(neg)
+         C += (ull_t)bi + BN_MAX_DIGIT - ai;
       else
-         p[y] = SWAP(a->l[x]);
+         C += (ull_t)ai + BN_MAX_DIGIT - bi;
+
+      d[i] = C;
+
+      C >>= BN_LIMB_BITS;
    }
 
-   return s;
+   return neg;
 }
 
-bn_t *bn_from_str(bn_t *a, const s8 *s)
+// Number of limbs up to and including the highest non-zero one.
+static int _bn_used_limbs(bn_t *a)
 {
-   int len = strlen(s);
-   int x, y, z, w;
-
-   ul_t limb;
-   u8 *p_limb = (u8 *)&limb;
-
-   // The x2 is for two ascii chars representing a single byte
-   int step = (BN_LIMB_BYTES * 2);
+   return a->used;
+}
 
-   if(len % 2)
-      return NULL;
+// D = D + A * b on raw limbs, for A of nl limbs. Returns the carry limb.
+// This is the row kernel all the quadratic loops are built from.
+static ul_t _bn_addmul_1_c(ul_t *d, const ul_t *a, int nl, ul_t b)
+{
+   ull_t S = 0;
 
-   for(x = len - 2, y = 0; x >= 0; y++)
+   for(int x = 0; x < nl; x++)
    {
-      limb = 0;
-
-      for(z = 0, w = 0; z < step && x >= 0; z += 2, w += 1)
-      {
-         p_limb[w] = _bn_str_to_u8(&s[x]);
-
-         x -= 2;
-      }
-
-      if(_bn_big_endian())
-         limb = SWAP(limb);
+      S += (ull_t)a[x] * b + d[x];
+      d[x] = S;
 
-      a->l[y] = limb;
+      S >>= BN_LIMB_BITS;
    }
 
-   return a;
+   return S;
 }
 
-bn_t *bn_zero(bn_t *a)
+#if defined(BN_X86_64)
+// BMI2/ADX version of _bn_addmul_1_c. MULX leaves the flags alone, so the
+// additions of the low halves ride on the CF chain (ADCX) and those of the
+// high halves on the OF chain (ADOX), without waiting on each other. The
+// loops are counted in rcx (JRCXZ, LEA) so nothing else touches the flags.
+static ul_t _bn_addmul_1_adx(ul_t *d, const ul_t *a, int nl, ul_t b)
 {
-   memset((char *)a->l, 0, a->n_limbs * BN_LIMB_BYTES);
-   return a;
+   ul_t n4 = nl / 4, n1 = nl % 4, hi, lo, t;
+
+   __asm__ volatile(
+      "xor %k[hi], %k[hi]\n\t"
+      "1:\n\t"
+      "jrcxz 2f\n\t"
+      "mulx (%[a]), %[lo], %[t]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "adcx (%[d]), %[lo]\n\t"
+      "mov %[lo], (%[d])\n\t"
+      "mulx 8(%[a]), %[lo], %[hi]\n\t"
+      "adox %[t], %[lo]\n\t"
+      "adcx 8(%[d]), %[lo]\n\t"
+      "mov %[lo], 8(%[d])\n\t"
+      "mulx 16(%[a]), %[lo], %[t]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "adcx 16(%[d]), %[lo]\n\t"
+      "mov %[lo], 16(%[d])\n\t"
+      "mulx 24(%[a]), %[lo], %[hi]\n\t"
+      "adox %[t], %[lo]\n\t"
+      "adcx 24(%[d]), %[lo]\n\t"
+      "mov %[lo], 24(%[d])\n\t"
+      "lea 32(%[a]), %[a]\n\t"
+      "lea 32(%[d]), %[d]\n\t"
+      "lea -1(%%rcx), %%rcx\n\t"
+      "jmp 1b\n\t"
+      "2:\n\t"
+      "mov %[n1], %%rcx\n\t"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mulx (%[a]), %[lo], %[t]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "adcx (%[d]), %[lo]\n\t"
+      "mov %[lo], (%[d])\n\t"
+      "mov %[t], %[hi]\n\t"
+      "lea 8(%[a]), %[a]\n\t"
+      "lea 8(%[d]), %[d]\n\t"
+      "lea -1(%%rcx), %%rcx\n\t"
+      "jmp 3b\n\t"
+      "4:\n\t"
+      "mov $0, %k[lo]\n\t"
+      "adcx %[lo], %[hi]\n\t"
+      "adox %[lo], %[hi]\n\t"
+      : [d] "+r" (d), [a] "+r" (a), "+c" (n4), [hi] "=&r" (hi), [lo] "=&r" (lo), [t] "=&r" (t)
+      : "d" (b), [n1] "r" (n1)
+      : "cc", "memory");
+
+   return hi;
 }
 
-bn_t *bn_alloc(int size)
-{
-   int s;
-
-   bn_t *ret = (bn_t *)mem_alloc(sizeof(bn_t));
-   memset((char *)ret, 0x00, sizeof(bn_t));
+static ul_t (*_bn_addmul_1)(ul_t *d, const ul_t *a, int nl, ul_t b) = _bn_addmul_1_c;
 
-   ret->n = size;
-   ret->n_limbs = BYTES_TO_LIMBS(size);
+// Set if the AVX-512 IFMA exponentiation can be used
+static int _bn_has_ifma;
 
-   // Always allocate 4 limbs more than we need, so that potential bn_mon_mul is faster
-   s = sizeof(ul_t) * (ret->n_limbs + 4);
-   ret->l = (ul_t *)mem_alloc(s);
-   memset((char *)ret->l, 0x00, s);
+// In IFMA form numbers are kept as m digits of 52 bits, with m a multiple of 8
+// so that a zmm register holds 8 digits, and VPMADD52LUQ/HUQ multiply 8 digits
+// at once. The Montgomery radix of this representation is
+// R' = 2**(52 * m) > 4 * 2**(BN_LIMB_BITS * nl), which lets "almost
+// Montgomery" products of values below 2N stay below 2N without any final
+// subtraction.
+#define _BN_IFMA_MASK (((u64)1 << 52) - 1)
+#define _BN_IFMA_MAX_VECS 20
 
-   return ret;
+static int _bn_ifma_digits(int nl)
+{
+   return ((BN_LIMB_BITS * nl + 2 + 51) / 52 + 7) & ~7;
 }
 
-bn_t *bn_alloc_limbs(int limbs)
+static int _bn_ifma_usable(bn_t *n)
 {
-   return bn_alloc(LIMBS_TO_BYTES(limbs));
+   return _bn_has_ifma && n->n_limbs >= BN_IFMA_THRESHOLD && _bn_ifma_digits(n->n_limbs) <= 8 * _BN_IFMA_MAX_VECS;
 }
 
-bn_t *bn_copy(bn_t *a, bn_t *b)
+// Pick the kernels once, when the library gets loaded.
+__attribute__((constructor)) static void _bn_cpu_init(void)
 {
-   int s = MIN(a->n_limbs, b->n_limbs);
+   unsigned int eax, ebx, ecx, edx, f7, xcr0 = 0;
 
-   bn_zero(a);
-   memcpy((s8 *)a->l, (s8 *)b->l, sizeof(ul_t) * s);
+   if(!__get_cpuid_count(7, 0, &eax, &f7, &ecx, &edx))
+      return;
 
-   return a;
+   if((f7 & bit_BMI2) && (f7 & bit_ADX))
+      _bn_addmul_1 = _bn_addmul_1_adx;
+
+   // AVX-512 also needs the OS to save the opmask and zmm state
+   if(__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_OSXSAVE))
+      __asm__("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+
+   if((f7 & bit_AVX512F) && (f7 & bit_AVX512IFMA) && (xcr0 & 0xe6) == 0xe6)
+      _bn_has_ifma = 1;
 }
+#else
+   #define _bn_addmul_1 _bn_addmul_1_c
+#endif
 
-void bn_free(bn_t *a)
+// D = A * B (schoolbook) on raw limbs. D holds an + bl limbs and must not
+// overlap A or B.
+static void _bn_mul_limbs(ul_t *d, const ul_t *a, int an, const ul_t *b, int bl)
 {
-   // Zero it out, just for good measure
-   bn_zero(a);
+   memset(d, 0, (an + bl) * BN_LIMB_BYTES);
 
-   mem_free(a->l);
-   mem_free(a);
+   for(int x = 0; x < an; x++)
+      d[x + bl] = _bn_addmul_1(&d[x], b, bl, a[x]);
 }
 
-inline bn_t *bn_set_ui(bn_t *a, u64 val)
+// D = A * A on raw limbs. The cross products a_x * a_y (x < y) are only
+// computed once and doubled, which saves close to half of the
+// multiplications. D holds 2 * nl limbs and must not overlap A.
+static void _bn_sqr_limbs(ul_t *d, const ul_t *a, int nl)
 {
-   for(int x = 0; x < sizeof(val) / sizeof(ul_t); x++)
+   ull_t S;
+   ul_t c = 0;
+
+   memset(d, 0, 2 * nl * BN_LIMB_BYTES);
+
+   // D = sum of a_x * a_y * r**(x + y), for x < y
+   for(int x = 0; x < nl; x++)
+      d[x + nl] = _bn_addmul_1(&d[2 * x + 1], &a[x + 1], nl - x - 1, a[x]);
+
+   // D = 2 * D + sum of a_x**2 * r**(2 * x)
+   for(int x = 0; x < 2 * nl; x++)
    {
-      a->l[x] = val & (ul_t)-1;
-      val >>= BN_LIMB_BITS;
+      ul_t h = d[x] >> (BN_LIMB_BITS - 1);
+
+      d[x] = (d[x] << 1) | c;
+      c = h;
    }
 
-   return a;
-}
+   S = 0;
 
-bn_t *bn_add(bn_t *d, bn_t *a, bn_t *b, bn_t *n)
-{
-   // D = A + B % N
+   for(int x = 0; x < nl; x++)
+   {
+      S += (ull_t)a[x] * a[x] + d[2 * x];
+      d[2 * x] = S;
 
-   // Prevent overflow
-   if(_bn_add(d, a, b))
-      _bn_sub(d, d, n);
+      S >>= BN_LIMB_BITS;
 
-   bn_reduce(d, n);
+      S += d[2 * x + 1];
+      d[2 * x + 1] = S;
 
-   return d;
+      S >>= BN_LIMB_BITS;
+   }
 }
 
-bn_t *bn_add_ui(bn_t *d, bn_t *a, unsigned int b, bn_t *n)
+static void _bn_mul_n(ul_t *d, const ul_t *a, const ul_t *b, int nl, ul_t *ws);
+static void _bn_sqr_n(ul_t *d, const ul_t *a, int nl, ul_t *ws);
+
+// Adds the middle term T = Z0 + Z2 -/+ M back into D = Z2 * r**(2 * h) + Z0,
+// where M is the product of the two half differences.
+static void _bn_kara_merge(ul_t *d, ul_t *t, const ul_t *m, int h, int k, int add)
 {
-   // D = A + B % N
+   memset(t, 0, (2 * k + 1) * BN_LIMB_BYTES);
+   memcpy(t, d, 2 * h * BN_LIMB_BYTES);
 
-   // Prevent overflow
-   if(_bn_add_ui(d, a, b))
-      _bn_sub(d, d, n);
+   t[2 * k] = _bn_add_limbs(t, t, &d[2 * h], 2 * k);
 
-   bn_reduce(d, n);
+   if(add)
+      t[2 * k] += _bn_add_limbs(t, t, m, 2 * k);
+   else
+      _bn_subx_limbs(t, t, 2 * k + 1, m, 2 * k);
 
-   return d;
+   // D = D + T * r**h, the full product always fits into 2 * (h + k) limbs
+   _bn_carry_limbs(&d[h + 2 * k + 1], _bn_add_limbs(&d[h], &d[h], t, 2 * k + 1), h - 1);
 }
 
-bn_t *bn_sub(bn_t *d, bn_t *a, bn_t *b, bn_t *n)
+// D = A * B (Karatsuba) for nl limb operands. D holds 2 * nl limbs and must
+// not overlap A or B, ws is scratch space of _BN_MUL_WS_LIMBS(nl) limbs.
+static void _bn_kara_limbs(ul_t *d, const ul_t *a, const ul_t *b, int nl, ul_t *ws)
 {
-   // D = A - B % N
+   if(nl < BN_KARATSUBA_THRESHOLD)
+   {
+      _bn_mul_limbs(d, a, nl, b, nl);
+      return;
+   }
 
-   // Prevent underflow
-   if(_bn_sub(d, a, b))
-      _bn_add(d, d, n);
+   // A = A1 * r**h + A0, where A0 has h limbs and A1 has k >= h limbs
+   int h = nl / 2, k = nl - h, neg;
+   ul_t *da = ws, *db = &ws[k], *m = &ws[2 * k], *t = &ws[4 * k], *rest = &ws[6 * k + 1];
 
-   bn_reduce(d, n);
+   // Z0 = A0 * B0 and Z2 = A1 * B1 go straight into D
+   _bn_kara_limbs(d, a, b, h, rest);
+   _bn_kara_limbs(&d[2 * h], &a[h], &b[h], k, rest);
 
-   return d;
+   // M = |A1 - A0| * |B1 - B0|
+   neg  = _bn_absdiff_limbs(da, &a[h], k, a, h);
+   neg ^= _bn_absdiff_limbs(db, &b[h], k, b, h);
+   _bn_kara_limbs(m, da, db, k, rest);
+
+   // A1 * B0 + A0 * B1 = Z0 + Z2 - (A1 - A0) * (B1 - B0)
+   _bn_kara_merge(d, t, m, h, k, neg);
 }
 
-bn_t *bn_sub_ui(bn_t *d, bn_t *a, unsigned int b, bn_t *n)
+// D = A * A (Karatsuba), with the same rules as _bn_kara_limbs.
+static void _bn_kara_sqr_limbs(ul_t *d, const ul_t *a, int nl, ul_t *ws)
 {
-   // D = A - B % N
+   if(nl < BN_KARATSUBA_THRESHOLD)
+   {
+      _bn_sqr_limbs(d, a, nl);
+      return;
+   }
 
-   // Prevent underflow
-   if(_bn_sub_ui(d, a, b))
-      _bn_add(d, d, n);
+   int h = nl / 2, k = nl - h;
+   ul_t *da = ws, *m = &ws[2 * k], *t = &ws[4 * k], *rest = &ws[6 * k + 1];
 
-   bn_reduce(d, n);
+   _bn_kara_sqr_limbs(d, a, h, rest);
+   _bn_kara_sqr_limbs(&d[2 * h], &a[h], k, rest);
 
-   return d;
+   // 2 * A1 * A0 = Z0 + Z2 - (A1 - A0)**2
+   _bn_absdiff_limbs(da, &a[h], k, a, h);
+   _bn_kara_sqr_limbs(m, da, k, rest);
+
+   _bn_kara_merge(d, t, m, h, k, 0);
 }
 
-int bn_cmp(bn_t *a, bn_t *b)
+// D = A << s on raw limbs, for 0 < s < BN_LIMB_BITS. Returns the bits
+// shifted out.
+static ul_t _bn_shl_limbs(ul_t *d, const ul_t *a, int nl, int s)
 {
-   //   assert(a->n_limbs == b->n_limbs);
+   ul_t c = 0;
 
-   // First check the high limbs, if any
-   if(a->n_limbs > b->n_limbs)
-   {
-      for(int i = b->n_limbs; i < a->n_limbs; i++)
-         if(a->l[i])
-            return BN_CMP_G;
-   }
-   else if(b->n_limbs > a->n_limbs)
+   for(int i = 0; i < nl; i++)
    {
-      for(int i = a->n_limbs; i < b->n_limbs; i++)
-         if(b->l[i])
-            return BN_CMP_G;
-   }
+      ul_t h = a[i] >> (BN_LIMB_BITS - s);
 
-   // ...then check the main limbs
-   for(int x = MIN(a->n_limbs, b->n_limbs); x >= 0; x--)
-   {
-      if(a->l[x] < b->l[x])
-         return BN_CMP_L;
-      else if(a->l[x] > b->l[x])
-         return BN_CMP_G;
+      d[i] = (a[i] << s) | c;
+      c = h;
    }
 
-   return BN_CMP_E;
+   return c;
 }
 
-int bn_cmp_ui(bn_t *a, ul_t b)
-{
-   int ret = 0;
+// The Toom-3 interpolation runs on signed values, which are kept as two's
+// complement numbers of a fixed number of limbs.
 
-   if(a->l[0] < b)
-      ret = BN_CMP_L;
-   else if(a->l[0] > b)
-      ret = BN_CMP_G;
-   else if(a->l[0] == b)
-      ret = BN_CMP_E;
+// A = -A
+static void _bn_neg_limbs(ul_t *a, int nl)
+{
+   ull_t C = 1;
 
-   // Let's walk over all other digits of a (if any)
-   for(int x = 1; x < a->n_limbs; x++)
+   for(int i = 0; i < nl; i++)
    {
-      if(a->l[x] != 0)
-      {
-         // So a has some non-zero digits. It's clearly bigger than b
-         ret = BN_CMP_G;
-         break;
-      }
-   }
+      C += (ul_t)~a[i];
+      a[i] = C;
 
-   return ret;
+      C >>= BN_LIMB_BITS;
+   }
 }
 
-int bn_is_zero(bn_t *a)
+// A = A / 2, for even A
+static void _bn_sar1_limbs(ul_t *a, int nl)
 {
-   for(int x = 0; x < a->n_limbs; x++)
-      if(a->l[x] != 0)
-         return 0;
+   for(int i = 0; i < nl - 1; i++)
+      a[i] = (a[i] >> 1) | (a[i + 1] << (BN_LIMB_BITS - 1));
 
-   return 1;
+   a[nl - 1] = (ul_t)((l_t)a[nl - 1] >> 1);
 }
 
-bn_t *bn_reduce(bn_t *a, bn_t *n)
+// A = A / 3, for A divisible by 3. Multiplies by 3**-1 mod r limb by limb and
+// carries the part of 3 * q which spills into the next limb.
+static void _bn_divexact3_limbs(ul_t *a, int nl)
 {
-   while(bn_cmp(a, n) >= 0)
-      _bn_sub(a, a, n);
+   const ul_t inv3 = BN_MAX_DIGIT / 3 * 2 + 1;
+   ul_t c = 0;
 
-   return a;
+   for(int i = 0; i < nl; i++)
+   {
+      ul_t l = a[i] - c;
+
+      c = l > a[i];
+      a[i] = l * inv3;
+      c += (ul_t)(((ull_t)a[i] * 3) >> BN_LIMB_BITS);
+   }
 }
 
-bn_t *bn_reduce_slow(bn_t *a, bn_t *n)
+// Evaluates A = A2 * x**2 + A1 * x + A0 at 1, -1 and -2, where A0 and A1 have
+// k limbs and A2 has l <= k. Each value gets k + 1 limbs, the magnitudes of
+// the negative points go into em1 and em2 and the function returns their
+// signs as bits 0 and 1.
+static int _bn_toom3_eval(ul_t *e1, ul_t *em1, ul_t *em2, const ul_t *a, int k, int l, ul_t *t)
 {
-   bn_t *q = bn_alloc_limbs(n->n_limbs);
-   bn_t *r = bn_alloc_limbs(n->n_limbs);
+   int sign;
 
-   bn_divrem(q, r, a, n);
-   bn_copy(a, r);
+   // t = A0 + A2
+   memcpy(t, a, k * BN_LIMB_BYTES);
+   t[k] = 0;
+   _bn_carry_limbs(&t[l], _bn_add_limbs(t, t, &a[2 * k], l), k + 1 - l);
 
-   bn_free(q);
-   bn_free(r);
+   // A(1) = A0 + A1 + A2, A(-1) = A0 - A1 + A2
+   e1[k] = t[k] + _bn_add_limbs(e1, t, &a[k], k);
+   sign = _bn_absdiff_limbs(em1, t, k + 1, &a[k], k);
 
-   return a;
+   // A(-2) = (A0 + 4 * A2) - 2 * A1
+   memset(em2, 0, (k + 1) * BN_LIMB_BYTES);
+   em2[l] = _bn_shl_limbs(em2, &a[2 * k], l, 2);
+   _bn_carry_limbs(&em2[k], _bn_add_limbs(em2, em2, a, k), 1);
+
+   t[k] = _bn_shl_limbs(t, &a[k], k, 1);
+   sign |= _bn_absdiff_limbs(em2, em2, k + 1, t, k + 1) << 1;
+
+   return sign;
 }
 
-bn_t *bn_lshift(bn_t *a, int b)
+// D = A * B (Toom-3) for nl limb operands, with the same rules as
+// _bn_kara_limbs. Passing the same operand twice computes a square.
+//
+// The operands are cut into three parts and evaluated at 0, 1, -1, -2 and
+// infinity, which leaves five products of a third of the size. The
+// coefficients of the result are interpolated back using Bodrato's sequence.
+static void _bn_toom3_limbs(ul_t *d, const ul_t *a, const ul_t *b, int nl, ul_t *ws)
 {
-   // Single largest shift we can do is one limb
-   while(b > BN_LIMB_BITS)
-   {
-      _bn_lshift_limbs(a, 1);
-      b -= BN_LIMB_BITS;
-   }
+   int k = (nl + 2) / 3, l = nl - 2 * k, w = 2 * k + 2, sign;
+
+   ul_t *ea1 = ws, *eam1 = &ea1[k + 1], *eam2 = &eam1[k + 1];
+   ul_t *eb1 = &eam2[k + 1], *ebm1 = &eb1[k + 1], *ebm2 = &ebm1[k + 1];
+   ul_t *t = &ebm2[k + 1], *v0 = &t[2 * k + 2], *v1 = &v0[w], *vm1 = &v1[w];
+   ul_t *vm2 = &vm1[w], *vinf = &vm2[w], *rest = &vinf[w];
+
+   sign = _bn_toom3_eval(ea1, eam1, eam2, a, k, l, t);
+
+   if(a == b)
+   {
+      _bn_sqr_n(v0, a, k, rest);
+      _bn_sqr_n(v1, ea1, k + 1, rest);
+      _bn_sqr_n(vm1, eam1, k + 1, rest);
+      _bn_sqr_n(vm2, eam2, k + 1, rest);
+      _bn_sqr_n(vinf, &a[2 * k], l, rest);
+
+      sign = 0;
+   }
+   else
+   {
+      sign ^= _bn_toom3_eval(eb1, ebm1, ebm2, b, k, l, t);
+
+      _bn_mul_n(v0, a, b, k, rest);
+      _bn_mul_n(v1, ea1, eb1, k + 1, rest);
+      _bn_mul_n(vm1, eam1, ebm1, k + 1, rest);
+      _bn_mul_n(vm2, eam2, ebm2, k + 1, rest);
+      _bn_mul_n(vinf, &a[2 * k], &b[2 * k], l, rest);
+   }
+
+   // Widen everything to w limb signed values
+   memset(&v0[2 * k], 0, 2 * BN_LIMB_BYTES);
+   memset(&vinf[2 * l], 0, (w - 2 * l) * BN_LIMB_BYTES);
+
+   if(sign & 1)
+      _bn_neg_limbs(vm1, w);
+
+   if(sign & 2)
+      _bn_neg_limbs(vm2, w);
+
+   // r3 = (v(-2) - v(1)) / 3
+   _bn_sub_limbs(vm2, vm2, v1, w);
+   _bn_divexact3_limbs(vm2, w);
+
+   // r1 = (v(1) - v(-1)) / 2
+   _bn_sub_limbs(v1, v1, vm1, w);
+   _bn_sar1_limbs(v1, w);
+
+   // r2 = v(-1) - v(0)
+   _bn_sub_limbs(vm1, vm1, v0, w);
+
+   // r3 = (r2 - r3) / 2 + 2 * v(inf)
+   _bn_sub_limbs(vm2, vm1, vm2, w);
+   _bn_sar1_limbs(vm2, w);
+   _bn_add_limbs(vm2, vm2, vinf, w);
+   _bn_add_limbs(vm2, vm2, vinf, w);
+
+   // r2 = r2 + r1 - v(inf)
+   _bn_add_limbs(vm1, vm1, v1, w);
+   _bn_sub_limbs(vm1, vm1, vinf, w);
+
+   // r1 = r1 - r3
+   _bn_sub_limbs(v1, v1, vm2, w);
+
+   // D = r4 * x**4 + r3 * x**3 + r2 * x**2 + r1 * x + r0. All coefficients
+   // are positive now and fit into what is left of D above their offset.
+   memcpy(d, v0, 2 * k * BN_LIMB_BYTES);
+   memset(&d[2 * k], 0, 2 * k * BN_LIMB_BYTES);
+   memcpy(&d[4 * k], vinf, 2 * l * BN_LIMB_BYTES);
+
+   ul_t *r[3] = { v1, vm1, vm2 };
+
+   for(int i = 1; i <= 3; i++)
+   {
+      int o = i * k, s = MIN(w, 2 * nl - o);
+
+      _bn_carry_limbs(&d[o + s], _bn_add_limbs(&d[o], &d[o], r[i - 1], s), 2 * nl - o - s);
+   }
+}
+
+// The NTT tier works on 16 bit digits (or whole limbs, if they are smaller)
+// and two NTT friendly primes p = c * 2**m + 1 below 2**30. A convolution
+// coefficient is below len * 2**32, so the primes combined (via CRT) recover
+// it exactly for up to 2**23 digits.
+#define _BN_NTT_DIGIT_BITS MIN(16, BN_LIMB_BITS)
+#define _BN_NTT_DIGITS_PER_LIMB (BN_LIMB_BITS / _BN_NTT_DIGIT_BITS)
+#define _BN_NTT_MAX_LEN (1 << 23)
+
+static const u32 _bn_ntt_primes[2] = { 998244353, 469762049 };
+
+// Arithmetic mod p runs on Montgomery form values (radix 2**32), so the
+// transforms never divide. pi = -p**-1 mod 2**32.
+static u32 _bn_ntt_redc(u64 t, u32 p, u32 pi)
+{
+   u32 u = (t + (u64)((u32)t * pi) * p) >> 32;
+
+   return (u >= p) ? u - p : u;
+}
+
+static u32 _bn_ntt_pow(u32 a, u32 e, u32 p)
+{
+   u64 r = 1, b = a;
+
+   for(; e; e >>= 1)
+   {
+      if(e & 1)
+         r = r * b % p;
+
+      b = b * b % p;
+   }
+
+   return r;
+}
+
+// In-place iterative NTT of len (a power of two) Montgomery form values mod
+// p. 3 is a generator for both primes. w is scratch space for len twiddle
+// factors.
+static void _bn_ntt(u32 *a, int len, u32 p, u32 pi, int inverse, u32 *w)
+{
+   u32 r = ((u64)1 << 32) % p;
+
+   for(int i = 1, j = 0; i < len; i++)
+   {
+      int bit = len >> 1;
+
+      for(; j & bit; bit >>= 1)
+         j ^= bit;
+
+      j ^= bit;
+
+      if(i < j)
+      {
+         u32 t = a[i]; a[i] = a[j]; a[j] = t;
+      }
+   }
+
+   // Twiddle factors, the stage working on blocks of m values uses the
+   // powers of a primitive m-th root of unity stored at w[m / 2], ...
+   u32 g = _bn_ntt_pow(3, (p - 1) / len, p);
+
+   if(inverse)
+      g = _bn_ntt_pow(g, p - 2, p);
+
+   g = (u64)g * r % p;
+   w[len / 2] = r;
+
+   for(int i = len / 2 + 1; i < len; i++)
+      w[i] = _bn_ntt_redc((u64)w[i - 1] * g, p, pi);
+
+   for(int i = len / 2 - 1; i > 0; i--)
+      w[i] = w[2 * i];
+
+   for(int h = 1; h < len; h <<= 1)
+   {
+      for(int i = 0; i < len; i += 2 * h)
+      {
+         for(int j = 0; j < h; j++)
+         {
+            u32 u = a[i + j], v = _bn_ntt_redc((u64)a[i + j + h] * w[h + j], p, pi);
+
+            a[i + j] = (u + v >= p) ? u + v - p : u + v;
+            a[i + j + h] = (u >= v) ? u - v : u + p - v;
+         }
+      }
+   }
+
+   if(inverse)
+   {
+      // Multiplying by len**-1 * R**2 also leaves Montgomery form
+      u32 li = (u64)_bn_ntt_pow(len, p - 2, p) * r % p * r % p;
+
+      for(int i = 0; i < len; i++)
+         a[i] = _bn_ntt_redc((u64)a[i] * li, p, pi);
+   }
+}
+
+static u32 _bn_ntt_digit(const ul_t *a, int i)
+{
+   ul_t l = a[i / _BN_NTT_DIGITS_PER_LIMB];
+
+   return (l >> ((i % _BN_NTT_DIGITS_PER_LIMB) * _BN_NTT_DIGIT_BITS)) & ((1 << _BN_NTT_DIGIT_BITS) - 1);
+}
+
+// D = A * B via NTT for nl limb operands, with the same rules as
+// _bn_kara_limbs. Passing the same operand twice computes a square.
+static void _bn_ntt_limbs(ul_t *d, const ul_t *a, const ul_t *b, int nl)
+{
+   int n = nl * _BN_NTT_DIGITS_PER_LIMB, len = 1;
+
+   while(len < 2 * n)
+      len <<= 1;
+
+   assert(len <= _BN_NTT_MAX_LEN);
+
+   u32 *f = (u32 *)mem_alloc(5 * len * sizeof(u32));
+   u32 *fa[2] = { f, &f[len] }, *fb[2] = { &f[2 * len], &f[3 * len] }, *w = &f[4 * len];
+
+   for(int x = 0; x < 2; x++)
+   {
+      u32 p = _bn_ntt_primes[x], pi = 1;
+
+      // Newton iteration for p**-1 mod 2**32
+      for(int i = 0; i < 5; i++)
+         pi *= 2 - p * pi;
+
+      pi = -pi;
+
+      // The digits are taken as Montgomery form values, which scales the
+      // product by R**-2. The inverse transform compensates for that.
+      memset(fa[x], 0, len * sizeof(u32));
+
+      for(int i = 0; i < n; i++)
+         fa[x][i] = _bn_ntt_digit(a, i);
+
+      _bn_ntt(fa[x], len, p, pi, 0, w);
+
+      if(a != b)
+      {
+         memset(fb[x], 0, len * sizeof(u32));
+
+         for(int i = 0; i < n; i++)
+            fb[x][i] = _bn_ntt_digit(b, i);
+
+         _bn_ntt(fb[x], len, p, pi, 0, w);
+      }
+      else
+         fb[x] = fa[x];
+
+      for(int i = 0; i < len; i++)
+         fa[x][i] = _bn_ntt_redc((u64)fa[x][i] * fb[x][i], p, pi);
+
+      _bn_ntt(fa[x], len, p, pi, 1, w);
+   }
+
+   // Recombine c = c0 + p0 * ((c1 - c0) * p0**-1 mod p1) and propagate
+   // the carries digit by digit
+   u64 p0 = _bn_ntt_primes[0], p1 = _bn_ntt_primes[1], c = 0;
+   u64 inv = _bn_ntt_pow(p0 % p1, p1 - 2, p1);
+
+   memset(d, 0, 2 * nl * BN_LIMB_BYTES);
+
+   for(int i = 0; i < 2 * n; i++)
+   {
+      u64 c0 = fa[0][i], c1 = fa[1][i];
+
+      c += c0 + p0 * ((c1 + p1 - c0 % p1) * inv % p1);
+
+      d[i / _BN_NTT_DIGITS_PER_LIMB] |= (ul_t)(c & ((1 << _BN_NTT_DIGIT_BITS) - 1)) << ((i % _BN_NTT_DIGITS_PER_LIMB) * _BN_NTT_DIGIT_BITS);
+      c >>= _BN_NTT_DIGIT_BITS;
+   }
+
+   mem_free(f);
+}
+
+// D = A * B for nl limb operands, picking the algorithm by size. D holds
+// 2 * nl limbs and must not overlap A or B, ws is scratch space of
+// _BN_MUL_WS_LIMBS(nl) limbs.
+static void _bn_mul_n(ul_t *d, const ul_t *a, const ul_t *b, int nl, ul_t *ws)
+{
+   if(nl >= BN_NTT_THRESHOLD && 2 * nl * _BN_NTT_DIGITS_PER_LIMB <= _BN_NTT_MAX_LEN)
+      _bn_ntt_limbs(d, a, b, nl);
+   else if(nl >= BN_TOOM3_THRESHOLD)
+      _bn_toom3_limbs(d, a, b, nl, ws);
+   else
+      _bn_kara_limbs(d, a, b, nl, ws);
+}
+
+// D = A * A, with the same rules as _bn_mul_n.
+static void _bn_sqr_n(ul_t *d, const ul_t *a, int nl, ul_t *ws)
+{
+   if(nl >= BN_NTT_THRESHOLD && 2 * nl * _BN_NTT_DIGITS_PER_LIMB <= _BN_NTT_MAX_LEN)
+      _bn_ntt_limbs(d, a, a, nl);
+   else if(nl >= BN_TOOM3_THRESHOLD)
+      _bn_toom3_limbs(d, a, a, nl, ws);
+   else
+      _bn_kara_sqr_limbs(d, a, nl, ws);
+}
+
+// Montgomery reduction on raw limbs: T = T / R mod N, for T < R * N of
+// 2 * nl limbs. T is scratch space of 2 * nl + 2 limbs, the result ends up in
+// its low nl limbs.
+static ul_t *_bn_mon_redc_limbs(ul_t *t, const ul_t *n, ul_t mp, int nl)
+{
+   ull_t S;
+   ul_t q, c = 0;
+
+   // T = T + q * N * r**x, where q makes limb x vanish. c keeps the carry
+   // out of the current top limb.
+   for(int x = 0; x < nl; x++)
+   {
+      q = (ul_t)(t[x] * (ull_t)mp);
+
+      S = (ull_t)t[x + nl] + c + _bn_addmul_1(&t[x], n, nl, q);
+      t[x + nl] = S;
+      c = S >> BN_LIMB_BITS;
+   }
+
+   memmove(t, &t[nl], nl * BN_LIMB_BYTES);
+   t[nl] = c;
+
+   // T < 2N, so a single subtraction is enough
+   if(t[nl] || _bn_cmp_limbs(t, n, nl) >= 0)
+      _bn_sub_limbs(t, t, n, nl);
+
+   return t;
+}
+
+// Number of leading zero bits of a non-zero limb.
+static int _bn_clz(ul_t x)
+{
+#if defined(__GNUC__)
+   return __builtin_clzll(x) - (64 - BN_LIMB_BITS);
+#else
+   int n = 0;
+
+   while(!(x >> (BN_LIMB_BITS - 1)))
+   {
+      x <<= 1;
+      n++;
+   }
+
+   return n;
+#endif
+}
+
+// D = D - A * b on raw limbs, for A of nl limbs. Returns the borrow limb.
+static ul_t _bn_submul_1(ul_t *d, const ul_t *a, int nl, ul_t b)
+{
+   ull_t S = 0;
+   ul_t t;
+
+   for(int x = 0; x < nl; x++)
+   {
+      S += (ull_t)a[x] * b;
+      t = d[x] - (ul_t)S;
+
+      S = (S >> BN_LIMB_BITS) + (t > d[x]);
+      d[x] = t;
+   }
+
+   return S;
+}
+
+// Q = A / B and R = A % B on raw limbs (Knuth, TAOCP 4.3.1, Algorithm D).
+// A has an >= bl limbs and B has bl limbs with a non-zero top one. Q gets
+// an - bl + 1 limbs and R gets bl. ws is scratch space of an + bl + 1 limbs.
+static void _bn_divrem_limbs(ul_t *q, ul_t *r, const ul_t *a, int an, const ul_t *b, int bl, ul_t *ws)
+{
+   ull_t rem = 0;
+
+   // Single limb divisors don't need any estimation
+   if(bl == 1)
+   {
+      for(int j = an - 1; j >= 0; j--)
+      {
+         rem = (rem << BN_LIMB_BITS) | a[j];
+         q[j] = rem / b[0];
+         rem %= b[0];
+      }
+
+      r[0] = rem;
+
+      return;
+   }
+
+   // Normalize, so that the top bit of the divisor is set. This keeps every
+   // quotient estimate at most 2 off.
+   int s = _bn_clz(b[bl - 1]);
+   ul_t *u = ws, *v = &ws[an + 1];
+
+   if(s)
+   {
+      _bn_shl_limbs(v, b, bl, s);
+      u[an] = _bn_shl_limbs(u, a, an, s);
+   }
+   else
+   {
+      memcpy(v, b, bl * BN_LIMB_BYTES);
+      memcpy(u, a, an * BN_LIMB_BYTES);
+      u[an] = 0;
+   }
+
+   for(int j = an - bl; j >= 0; j--)
+   {
+      // Estimate the quotient limb from the top two limbs of the remainder
+      ull_t num = ((ull_t)u[j + bl] << BN_LIMB_BITS) | u[j + bl - 1];
+      ull_t qh = num / v[bl - 1], rh = num % v[bl - 1];
+
+      while((qh >> BN_LIMB_BITS) || qh * v[bl - 2] > ((rh << BN_LIMB_BITS) | u[j + bl - 2]))
+      {
+         qh--;
+         rh += v[bl - 1];
+
+         if(rh >> BN_LIMB_BITS)
+            break;
+      }
+
+      // U = U - qh * V * r**j, which may go negative once in a while
+      ul_t c = _bn_submul_1(&u[j], v, bl, qh);
+      ul_t t = u[j + bl];
+
+      u[j + bl] = t - c;
+
+      if(c > t)
+      {
+         qh--;
+         u[j + bl] += _bn_add_limbs(&u[j], &u[j], v, bl);
+      }
+
+      q[j] = qh;
+   }
+
+   // Denormalize the remainder
+   for(int x = 0; x < bl; x++)
+      r[x] = s ? (u[x] >> s) | (u[x + 1] << (BN_LIMB_BITS - s)) : u[x];
+}
+
+int bn_maxbit(bn_t *a)
+{
+   // The top non-zero limb is known, so this is just its top bit
+   int x = a->used - 1;
+
+   return (x >= 0) ? x * BN_LIMB_BITS + BN_LIMB_BITS - 1 - _bn_clz(a->l[x]) : 0;
+}
+
+int bn_getbit(bn_t *a, int x)
+{
+   return (a->l[x / BN_LIMB_BITS] >> (x % BN_LIMB_BITS)) & 1;
+}
+
+void bn_setbit(bn_t *a, int x)
+{
+   a->l[x / BN_LIMB_BITS] |= (ul_t)1 << (x % BN_LIMB_BITS);
+   a->used = MAX(a->used, x / BN_LIMB_BITS + 1);
+}
+
+bn_t *bn_from_bin(bn_t *a, s8 *s, int len)
+{
+   int x, y, z, w;
+
+   ul_t limb;
+   u8 *p_limb = (u8 *)&limb;
+
+   for(x = len - 1, y = 0; x >= 0; y++)
+   {
+      limb = 0;
+
+      for(z = 0, w = 0; z < BN_LIMB_BYTES; z += 1, w += 1)
+      {
+         if(x < 0)
+            break;
+
+         p_limb[w] = s[x];
+
+         x -= 1;
+      }
+
+      if(_bn_big_endian())
+         limb = SWAP(limb);
+
+      a->l[y] = limb;
+   }
+
+   // The limbs above the input are left as they were
+   return _bn_norm(a, MAX(a->used, y));
+}
+
+u8 *bn_to_bin(u8 *s, bn_t *a)
+{
+   ul_t *p = (ul_t *)s;
+
+   int be = _bn_big_endian();
+
+   for(int x = a->n_limbs - 1, y = 0; x >= 0; x--, y++)
+   {
+      if(be)
+         p[y] = a->l[x];
+      else
+         p[y] = SWAP(a->l[x]);
+   }
+
+   return s;
+}
+
+bn_t *bn_from_str(bn_t *a, const s8 *s)
+{
+   int len = strlen(s);
+   int x, y, z, w;
+
+   ul_t limb;
+   u8 *p_limb = (u8 *)&limb;
+
+   // The x2 is for two ascii chars representing a single byte
+   int step = (BN_LIMB_BYTES * 2);
+
+   if(len % 2)
+      return NULL;
+
+   for(x = len - 2, y = 0; x >= 0; y++)
+   {
+      limb = 0;
+
+      for(z = 0, w = 0; z < step && x >= 0; z += 2, w += 1)
+      {
+         p_limb[w] = _bn_str_to_u8(&s[x]);
+
+         x -= 2;
+      }
+
+      if(_bn_big_endian())
+         limb = SWAP(limb);
+
+      a->l[y] = limb;
+   }
+
+   // The limbs above the input are left as they were
+   return _bn_norm(a, MAX(a->used, y));
+}
+
+bn_t *bn_zero(bn_t *a)
+{
+   // All the limbs from the used ones up are zero already
+   memset((char *)a->l, 0, a->used * BN_LIMB_BYTES);
+   a->used = 0;
+
+   return a;
+}
+
+// Bytes a bignum of nl limbs takes in a block, so that the next one stays aligned
+#define _BN_BLOCK_BYTES(nl) ((sizeof(bn_t) + (nl) * BN_LIMB_BYTES + BN_ALIGN - 1) & ~(size_t)(BN_ALIGN - 1))
+
+void *bn_alloc_block(size_t head, bn_t **d, int cnt, int size)
+{
+   int nl = BYTES_TO_LIMBS(size);
+   size_t bb = _BN_BLOCK_BYTES(nl);
+
+   // mem_alloc only aligns to 16 bytes, round up from there
+   head = (head + 15) & ~(size_t)15;
+
+   u8 *p = (u8 *)mem_alloc(head + BN_ALIGN - 16 + cnt * bb), *q;
+
+   if(p == NULL)
+      return NULL;
+
+   q = p + ((-(uintptr_t)(p + head)) & (BN_ALIGN - 1)) + head;
+
+   for(int i = 0; i < cnt; i++, q += bb)
+   {
+      bn_t *a = d[i] = (bn_t *)q;
+
+      a->n = size;
+      a->n_limbs = nl;
+      a->used = 0;
+      a->off = _BN_SHARED((int)(q - p));
+      a->mon = NULL;
+      a->barrett = NULL;
+      memset((char *)a->l, 0x00, nl * BN_LIMB_BYTES);
+   }
+
+   return p;
+}
+
+bn_t *bn_alloc(int size)
+{
+   bn_t *ret;
+
+   if(bn_alloc_block(0, &ret, 1, size) == NULL)
+      return NULL;
+
+   // The only bignum in its block, bn_free frees it
+   ret->off = _BN_SHARED(ret->off);
+
+   return ret;
+}
+
+bn_t **bn_alloc_n(bn_t **d, int cnt, int size)
+{
+   return bn_alloc_block(0, d, cnt, size) ? d : NULL;
+}
+
+void bn_free_n(bn_t **d, int cnt)
+{
+   u8 *p = (u8 *)d[0] - _BN_SHARED(d[0]->off);
+
+   for(int i = 0; i < cnt; i++)
+      bn_free(d[i]);
+
+   mem_free(p);
+}
+
+bn_t *bn_alloc_limbs(int limbs)
+{
+   return bn_alloc(LIMBS_TO_BYTES(limbs));
+}
+
+bn_t *bn_copy(bn_t *a, bn_t *b)
+{
+   int s = MIN(a->n_limbs, b->used);
+
+   memmove((s8 *)a->l, (s8 *)b->l, sizeof(ul_t) * s);
+   _bn_clear_top(a, s, a->n_limbs);
+
+   return a;
+}
+
+ul_t *bn_to_limbs(ul_t *l, bn_t *a, int nl)
+{
+   return _bn_load_limbs(l, a, nl);
+}
+
+bn_t *bn_from_limbs(bn_t *a, const ul_t *l, int nl)
+{
+   return _bn_store_limbs(a, l, nl);
+}
+
+void bn_ctxt_invalidate(bn_t *n)
+{
+   if(n->mon)
+      bn_mon_ctxt_free(n->mon);
+   if(n->barrett)
+      bn_barrett_ctxt_free(n->barrett);
+
+   n->mon = NULL;
+   n->barrett = NULL;
+}
+
+void bn_free(bn_t *a)
+{
+   bn_ctxt_invalidate(a);
+
+   // Zero it out, just for good measure
+   bn_zero(a);
+
+   if(a->off >= 0)
+      mem_free((u8 *)a - a->off);
+}
+
+inline bn_t *bn_set_ui(bn_t *a, u64 val)
+{
+   int x;
+
+   for(x = 0; x < sizeof(val) / sizeof(ul_t); x++)
+   {
+      a->l[x] = val & (ul_t)-1;
+      val >>= BN_LIMB_BITS;
+   }
+
+   // Clear the rest of the old value too, so that A really is val
+   _bn_clear_top(a, MIN(a->n_limbs, x), a->n_limbs);
+
+   return a;
+}
+
+bn_t *bn_add(bn_t *d, bn_t *a, bn_t *b, bn_t *n)
+{
+   // D = A + B % N
+
+   // Prevent overflow
+   if(_bn_add(d, a, b))
+      _bn_sub(d, d, n);
+
+   bn_reduce(d, n);
+
+   return d;
+}
+
+bn_t *bn_add_ui(bn_t *d, bn_t *a, unsigned int b, bn_t *n)
+{
+   // D = A + B % N
+
+   // Prevent overflow
+   if(_bn_add_ui(d, a, b))
+      _bn_sub(d, d, n);
+
+   bn_reduce(d, n);
+
+   return d;
+}
+
+bn_t *bn_sub(bn_t *d, bn_t *a, bn_t *b, bn_t *n)
+{
+   // D = A - B % N
+
+   // Prevent underflow
+   if(_bn_sub(d, a, b))
+      _bn_add(d, d, n);
+
+   bn_reduce(d, n);
+
+   return d;
+}
+
+bn_t *bn_sub_ui(bn_t *d, bn_t *a, unsigned int b, bn_t *n)
+{
+   // D = A - B % N
+
+   // Prevent underflow
+   if(_bn_sub_ui(d, a, b))
+      _bn_add(d, d, n);
+
+   bn_reduce(d, n);
+
+   return d;
+}
+
+int bn_cmp(bn_t *a, bn_t *b)
+{
+   // The one with more used limbs is the bigger one...
+   if(a->used != b->used)
+      return (a->used > b->used) ? BN_CMP_G : BN_CMP_L;
+
+   // ...otherwise check the used limbs
+   for(int x = a->used - 1; x >= 0; x--)
+   {
+      if(a->l[x] < b->l[x])
+         return BN_CMP_L;
+      else if(a->l[x] > b->l[x])
+         return BN_CMP_G;
+   }
+
+   return BN_CMP_E;
+}
+
+int bn_cmp_ui(bn_t *a, ul_t b)
+{
+   int ret = 0;
+
+   if(a->l[0] < b)
+      ret = BN_CMP_L;
+   else if(a->l[0] > b)
+      ret = BN_CMP_G;
+   else if(a->l[0] == b)
+      ret = BN_CMP_E;
+
+   // If a has any other non-zero digits, it's clearly bigger than b
+   if(a->used > 1)
+      ret = BN_CMP_G;
+
+   return ret;
+}
+
+int bn_is_zero(bn_t *a)
+{
+   return a->used == 0;
+}
+
+bn_t *bn_reduce(bn_t *a, bn_t *n)
+{
+   // Anything with more limbs than N is surely well above it
+   if(_bn_used_limbs(a) > _bn_used_limbs(n))
+      return bn_barrett_reduce(a, bn_barrett_ctxt(n));
+
+   // The common case is A < 2N, which needs at most one subtraction
+   if(bn_cmp(a, n) >= 0)
+   {
+      _bn_sub(a, a, n);
+
+      if(bn_cmp(a, n) >= 0)
+         return bn_barrett_reduce(a, bn_barrett_ctxt(n));
+   }
+
+   return a;
+}
+
+bn_t *bn_reduce_slow(bn_t *a, bn_t *n)
+{
+   bn_t *q = bn_alloc_limbs(n->n_limbs);
+   bn_t *r = bn_alloc_limbs(n->n_limbs);
+
+   bn_divrem(q, r, a, n);
+   bn_copy(a, r);
+
+   bn_free(q);
+   bn_free(r);
+
+   return a;
+}
+
+bn_t *bn_lshift(bn_t *a, int b)
+{
+   // Single largest shift we can do is one limb
+   while(b > BN_LIMB_BITS)
+   {
+      _bn_lshift_limbs(a, 1);
+      b -= BN_LIMB_BITS;
+   }
 
    return _bn_lshift(a, b);
 }
 
-bn_t *bn_rshift(bn_t *a, int b)
+bn_t *bn_rshift(bn_t *a, int b)
+{
+   // Single largest shift we can do is one limb
+   while(b > BN_LIMB_BITS)
+   {
+      _bn_rshift_limbs(a, 1);
+      b -= BN_LIMB_BITS;
+   }
+
+   return _bn_rshift(a, b);
+}
+
+int bn_lsb(bn_t *a)
+{
+   return a->l[0] & 1;
+}
+
+int bn_msb(bn_t *a)
+{
+   return a->l[a->n - 1] >> (BN_LIMB_BITS - 1);
+}
+
+#if defined(BN_PRINT_FUNCS)
+void bn_print(FILE *fp, const s8 *pre, bn_t *a, const s8 *post)
+{
+   int i, init = 1;
+
+   fputs((char *)pre, fp);
+
+   //Skip zero limbs.
+   i = a->used - 1;
+
+   for(; i >= 0; i--)
+   {
+      if(init)
+      {
+         init = 0;
+         fprintf(fp, BN_PRINT_FORMAT_I, a->l[i]);
+      }
+      else
+         fprintf(fp, BN_PRINT_FORMAT, a->l[i]);
+   }
+
+   fputs((char *)post, fp);
+}
+
+bn_t *bn_read(FILE *fp, bn_t *dst)
+{
+   s8 *data = mem_alloc(dst->n);
+
+   fread(data, sizeof(u8), dst->n, fp);
+   bn_from_bin(dst, data, dst->n);
+   mem_free(data);
+
+   return dst;
+}
+
+bn_t *bn_write(FILE *fp, bn_t *num)
+{
+   u8 *data = mem_alloc(num->n);
+
+   bn_to_bin(data, num);
+   fwrite(data, 1, num->n, fp);
+   mem_free(data);
+
+   return num;
+}
+#endif
+
+bn_t *bn_mul(bn_t *d, bn_t *a, bn_t *b)
+{
+   // D = A * B
+   int an = _bn_used_limbs(a), bl = _bn_used_limbs(b);
+
+   // Make A the longer one
+   if(an < bl)
+   {
+      bn_t *t = a; a = b; b = t;
+      int x = an; an = bl; bl = x;
+   }
+
+   // Can d hold the result?
+   assert(d->n_limbs >= an + bl);
+
+   if(bl == 0)
+      return bn_zero(d);
+
+   // The product goes into its own buffer, so d may alias a or b
+   if(bl < BN_KARATSUBA_THRESHOLD)
+   {
+      ul_t *p = (ul_t *)mem_alloc((an + bl) * BN_LIMB_BYTES);
+
+      _bn_mul_limbs(p, a->l, an, b->l, bl);
+      _bn_store_limbs(d, p, an + bl);
+
+      mem_free(p);
+
+      return d;
+   }
+
+   // Workspace layout: the product, the current partial product, a
+   // zero-padded chunk of A and the Karatsuba scratch space
+   ul_t *p = (ul_t *)mem_alloc((an + 4 * bl + _BN_MUL_WS_LIMBS(bl)) * BN_LIMB_BYTES);
+   ul_t *c = &p[an + bl], *ac = &c[2 * bl], *ws = &ac[bl];
+
+   memset(p, 0, (an + bl) * BN_LIMB_BYTES);
+
+   // Unbalanced operands are multiplied in chunks of bl limbs of A
+   for(int x = 0; x < an; x += bl)
+   {
+      int s = MIN(bl, an - x);
+
+      memcpy(ac, &a->l[x], s * BN_LIMB_BYTES);
+      memset(&ac[s], 0, (bl - s) * BN_LIMB_BYTES);
+      _bn_mul_n(c, ac, b->l, bl, ws);
+
+      // The partial product has s + bl significant limbs
+      _bn_carry_limbs(&p[x + s + bl], _bn_add_limbs(&p[x], &p[x], c, s + bl), an - x - s);
+   }
+
+   _bn_store_limbs(d, p, an + bl);
+
+   mem_free(p);
+
+   return d;
+}
+
+bn_t *bn_mul_ui(bn_t *d, bn_t *a, ul_t b)
+{
+   // D = A * b
+   ull_t S = 0;
+
+   // Can a hold the result?
+   assert(d->n >= (a->n + 1));
+
+   bn_zero(d);
+
+   for(int x = 0; x < a->used; x++)
+   {
+      S += (ull_t)a->l[x] * b;
+      d->l[x] = S;
+
+      S >>= BN_LIMB_BITS;
+   }
+
+   // The carry out of the top is lost when D has no room for it
+   if(a->used < d->n_limbs)
+      d->l[a->used] = S;
+
+   return _bn_norm(d, MIN(d->n_limbs, a->used + 1));
+}
+
+bn_t *bn_divrem(bn_t *q, bn_t *r, bn_t *a, bn_t *b)
+{
+   // Q = A / B, R = A % B
+   int an = _bn_used_limbs(a), bl = _bn_used_limbs(b);
+
+   assert(bl > 0);
+
+   // A < B
+   if(an < bl)
+   {
+      _bn_store_limbs(r, a->l, an);
+      return bn_zero(q);
+   }
+
+   // Everything is computed on the side, so q and r may alias a and b
+   ul_t *ws = (ul_t *)mem_alloc((2 * an + bl + 2) * BN_LIMB_BYTES);
+   ul_t *qt = ws, *rt = &ws[an - bl + 1];
+
+   _bn_divrem_limbs(qt, rt, a->l, an, b->l, bl, &rt[bl]);
+
+   _bn_store_limbs(r, rt, bl);
+   _bn_store_limbs(q, qt, an - bl + 1);
+
+   mem_free(ws);
+
+   return q;
+}
+
+bn_t *bn_rand(bn_t *a)
+{
+   int size = a->n;
+   u8 *tmp = (u8 *)mem_alloc(size);
+
+   #if defined(_WIN32) || defined(_MSC_VER)
+      HCRYPTPROV hProvider;
+
+      CryptAcquireContext(&hProvider, 0, 0, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT | CRYPT_SILENT);
+      CryptGenRandom(hProvider, size, tmp);
+   #else
+      int fd = open("/dev/urandom", O_RDONLY, 0);
+      read(fd, tmp, size);
+      close(fd);
+   #endif
+
+   bn_zero(a);
+   bn_from_bin(a, (s8 *)tmp, size);
+
+   mem_free(tmp);
+
+   return a;
+}
+
+// Generate random a \in [x, b - y].
+bn_t *bn_rand_range(bn_t *a, int x, bn_t *b, int y)
+{
+   bn_t *t = bn_alloc(b->n);
+   _bn_sub_ui(t, b, y);
+
+   while(1)
+   {
+      bn_rand(a);
+
+      if(bn_cmp_ui(a, x) <= 0)   // Check a < x
+         continue;
+
+      if(bn_cmp(a, t) > 0)       // Check a > b - y
+         continue;
+
+      break;
+   }
+
+   bn_free(t);
+
+   return a;
+}
+
+// Montgomery multiplication on raw limbs: T = A * B / R mod N, for A < R and
+// B < N. T is scratch space of 2 * nl + 2 limbs which must not overlap A or B,
+// the result ends up in its low nl limbs. Nothing is allocated below the NTT
+// threshold.
+//
+// The full product is computed first (by the Karatsuba or higher tier from
+// BN_MON_KARATSUBA_THRESHOLD limbs on, in the _BN_MON_MUL_WS_LIMBS(nl) limbs
+// of ws) and reduced afterwards, so both halves run on the same row kernel.
+// Below the threshold ws is not used and may be NULL.
+static ul_t *_bn_mon_mul_limbs(ul_t *t, const ul_t *a, const ul_t *b, const ul_t *n, ul_t mp, int nl, ul_t *ws)
+{
+   if(nl >= BN_MON_KARATSUBA_THRESHOLD)
+      _bn_mul_n(t, a, b, nl, ws);
+   else
+      _bn_mul_limbs(t, a, nl, b, nl);
+
+   return _bn_mon_redc_limbs(t, n, mp, nl);
+}
+
+// Montgomery squaring on raw limbs: T = A * A / R mod N, for A < N. T and ws
+// are as for _bn_mon_mul_limbs, T must not overlap A.
+static ul_t *_bn_mon_sqr_limbs(ul_t *t, const ul_t *a, const ul_t *n, ul_t mp, int nl, ul_t *ws)
+{
+   if(nl >= BN_MON_KARATSUBA_THRESHOLD)
+      _bn_sqr_n(t, a, nl, ws);
+   else
+      _bn_sqr_limbs(t, a, nl);
+
+   return _bn_mon_redc_limbs(t, n, mp, nl);
+}
+
+// The ws of _bn_mon_mul_limbs for callers without a workspace of their own,
+// NULL when nl is below the threshold (to go back with mem_free)
+static ul_t *_bn_mon_ws_alloc(int nl)
+{
+   if(_BN_MON_MUL_WS_LIMBS(nl) == 0)
+      return NULL;
+
+   return (ul_t *)mem_alloc(_BN_MON_MUL_WS_LIMBS(nl) * BN_LIMB_BYTES);
+}
+
+// Montgomery multiplication with a known mp. Always runs over the modulus
+// size, so the Montgomery radix is R = 2**(BN_LIMB_BITS * n->n_limbs). ws is
+// scratch space of 4 * nl + 2 limbs, mw the ws of _bn_mon_mul_limbs.
+static bn_t *_bn_mon_mul_ws(bn_t *d, bn_t *a, bn_t *b, bn_t *n, ul_t mp, ul_t *ws, ul_t *mw)
+{
+   int nl = n->n_limbs;
+   ul_t *t = ws, *al = a->l, *bl = b->l;
+
+   // Short operands get padded into the workspace
+   if(a->n_limbs < nl)
+      al = _bn_load_limbs(&ws[2 * nl + 2], a, nl);
+
+   if(b->n_limbs < nl)
+      bl = _bn_load_limbs(&ws[3 * nl + 2], b, nl);
+
+   _bn_mon_mul_limbs(t, al, bl, n->l, mp, nl, mw);
+
+   return _bn_store_limbs(d, t, nl);
+}
+
+// Without a workspace from the caller the products stay on the stack, and the
+// multiplication scratch of the bigger moduli comes from the heap
+static bn_t *_bn_mon_mul(bn_t *d, bn_t *a, bn_t *b, bn_t *n, ul_t mp)
+{
+   int nl = n->n_limbs;
+   ul_t ws[4 * nl + 2], *mw = _bn_mon_ws_alloc(nl);
+
+   _bn_mon_mul_ws(d, a, b, n, mp, ws, mw);
+   mem_free(mw);
+
+   return d;
+}
+
+static bn_t *_bn_mon_sqr_ws(bn_t *d, bn_t *a, bn_t *n, ul_t mp, ul_t *ws, ul_t *mw)
+{
+   int nl = n->n_limbs;
+   ul_t *t = ws, *al = a->l;
+
+   // Short operands get padded into the workspace
+   if(a->n_limbs < nl)
+      al = _bn_load_limbs(&ws[2 * nl + 2], a, nl);
+
+   _bn_mon_sqr_limbs(t, al, n->l, mp, nl, mw);
+
+   return _bn_store_limbs(d, t, nl);
+}
+
+static bn_t *_bn_mon_sqr(bn_t *d, bn_t *a, bn_t *n, ul_t mp)
+{
+   int nl = n->n_limbs;
+   ul_t ws[4 * nl + 2], *mw = _bn_mon_ws_alloc(nl);
+
+   _bn_mon_sqr_ws(d, a, n, mp, ws, mw);
+   mem_free(mw);
+
+   return d;
+}
+
+bn_mon_ctxt_t *bn_mon_ctxt_alloc(bn_t *n)
+{
+   bn_mon_ctxt_t *ctxt;
+   int k = BN_LIMB_BITS * n->n_limbs;
+
+   if((ctxt = (bn_mon_ctxt_t *)mem_alloc(sizeof(bn_mon_ctxt_t))) == NULL)
+      return NULL;
+
+   ctxt->mp = _bn_mon_init(n);
+   ctxt->rr = bn_alloc_limbs(n->n_limbs);
+   ctxt->one = bn_alloc_limbs(n->n_limbs);
+   ctxt->two = bn_alloc_limbs(n->n_limbs);
+   ctxt->unit = bn_set_ui(bn_alloc_limbs(n->n_limbs), 1);
+
+   // R mod N: start from the highest power of two below N and keep doubling.
+   // We can't use bn_add here since it only handles values below N.
+   bn_t *t = bn_alloc_limbs(n->n_limbs + 1);
+   bn_t *nt = bn_copy(bn_alloc_limbs(n->n_limbs + 1), n);
+
+   bn_setbit(t, bn_maxbit(n));
+   bn_reduce(t, nt);
+
+   for(int x = bn_maxbit(n); x < k; x++)
+   {
+      _bn_add(t, t, t);
+      bn_reduce(t, nt);
+   }
+
+   bn_copy(ctxt->one, t);
+
+   _bn_add(t, t, t);
+   bn_reduce(t, nt);
+   bn_copy(ctxt->two, t);
+
+   // R**2 mod N is 2**k in Montgomery form. Every Montgomery product adds the
+   // exponents of two such powers, so square and multiply starting from 2R.
+   int top = 0;
+
+   while(k >> (top + 1))
+      top++;
+
+   bn_copy(ctxt->rr, ctxt->two);
+
+   for(int i = top - 1; i >= 0; i--)
+   {
+      _bn_mon_sqr(ctxt->rr, ctxt->rr, n, ctxt->mp);
+
+      if((k >> i) & 1)
+         _bn_mon_mul(ctxt->rr, ctxt->rr, ctxt->two, n, ctxt->mp);
+   }
+
+   ctxt->rr52 = NULL;
+
+#if defined(BN_X86_64)
+   // R'**2 mod N for the IFMA radix R' = 2**(52 * m) is 2**(2 * 52 * m - k) in
+   // Montgomery form, i.e. R mod N doubled some more times and converted
+   if(_bn_ifma_usable(n))
+   {
+      bn_copy(t, ctxt->one);
+
+      for(int x = 2 * k; x < 2 * 52 * _bn_ifma_digits(n->n_limbs); x++)
+      {
+         _bn_add(t, t, t);
+         bn_reduce(t, nt);
+      }
+
+      ctxt->rr52 = bn_copy(bn_alloc_limbs(n->n_limbs), t);
+      _bn_mon_mul(ctxt->rr52, ctxt->rr52, ctxt->rr, n, ctxt->mp);
+   }
+#endif
+
+   bn_free(t);
+   bn_free(nt);
+
+   return ctxt;
+}
+
+void bn_mon_ctxt_free(bn_mon_ctxt_t *ctxt)
+{
+   bn_free(ctxt->rr);
+   bn_free(ctxt->one);
+   bn_free(ctxt->two);
+   bn_free(ctxt->unit);
+
+   if(ctxt->rr52)
+      bn_free(ctxt->rr52);
+
+   mem_free(ctxt);
+}
+
+bn_mon_ctxt_t *bn_mon_ctxt(bn_t *n)
+{
+   bn_mon_ctxt_t *ctxt = _bn_ctxt_load(&n->mon);
+   arena_scope_t s;
+
+   if(ctxt != NULL)
+      return ctxt;
+
+   // The context outlives any arena scope
+   arena_push(&s, NULL);
+   ctxt = bn_mon_ctxt_alloc(n);
+   arena_pop(&s);
+
+   // Threads racing on first use each build one, and all of them go on with the first published
+   if(!_bn_ctxt_cas(&n->mon, ctxt))
+   {
+      bn_mon_ctxt_free(ctxt);
+      ctxt = _bn_ctxt_load(&n->mon);
+   }
+
+   return ctxt;
+}
+
+bn_barrett_ctxt_t *bn_barrett_ctxt_alloc(bn_t *n)
+{
+   bn_barrett_ctxt_t *ctxt = (bn_barrett_ctxt_t *)mem_alloc(sizeof(bn_barrett_ctxt_t));
+   int k = _bn_used_limbs(n);
+
+   assert(k > 0);
+
+   ctxt->k = k;
+   ctxt->n = bn_copy(bn_alloc_limbs(k), n);
+
+   // mu = r**(2k) / N, which is just above r**k (at most r**(k + 1))
+   bn_t *t = bn_alloc_limbs(2 * k + 1);
+   bn_setbit(t, 2 * k * BN_LIMB_BITS);
+
+   ctxt->mu = bn_alloc_limbs(k + 2);
+   bn_divrem(ctxt->mu, t, t, ctxt->n);
+
+   bn_free(t);
+
+   return ctxt;
+}
+
+void bn_barrett_ctxt_free(bn_barrett_ctxt_t *ctxt)
+{
+   bn_free(ctxt->n);
+   bn_free(ctxt->mu);
+
+   mem_free(ctxt);
+}
+
+bn_barrett_ctxt_t *bn_barrett_ctxt(bn_t *n)
+{
+   bn_barrett_ctxt_t *ctxt = _bn_ctxt_load(&n->barrett);
+   arena_scope_t s;
+
+   if(ctxt != NULL)
+      return ctxt;
+
+   // Published just like the Montgomery context
+   arena_push(&s, NULL);
+   ctxt = bn_barrett_ctxt_alloc(n);
+   arena_pop(&s);
+
+   if(!_bn_ctxt_cas(&n->barrett, ctxt))
+   {
+      bn_barrett_ctxt_free(ctxt);
+      ctxt = _bn_ctxt_load(&n->barrett);
+   }
+
+   return ctxt;
+}
+
+bn_t *bn_barrett_reduce(bn_t *a, bn_barrett_ctxt_t *ctxt)
+{
+   // A = A % N (HAC 14.42)
+   int k = ctxt->k, an = _bn_used_limbs(a), ml = _bn_used_limbs(ctxt->mu);
+
+   // Below r**(k - 1) <= N there is nothing to do, above r**(2k) one step is not enough
+   if(an < k)
+      return a;
+   if(an > 2 * k)
+      return bn_reduce_slow(a, ctxt->n);
+
+   // Q = floor(floor(A / r**(k - 1)) * mu / r**(k + 1)), which is at most 2 below A / N
+   int qn = an - k + 1 + ml - (k + 1);
+   ul_t qt[an - k + 1 + ml], p[qn + k], r[k + 1], n[k + 1];
+
+   _bn_mul_limbs(qt, &a->l[k - 1], an - k + 1, ctxt->mu->l, ml);
+   _bn_mul_limbs(p, &qt[k + 1], qn, ctxt->n->l, k);
+
+   // R = A - Q * N, which fits in k + 1 limbs, so everything above them can be dropped
+   _bn_sub_limbs(r, _bn_load_limbs(r, a, k + 1), p, k + 1);
+   _bn_load_limbs(n, ctxt->n, k + 1);
+
+   while(_bn_cmp_limbs(r, n, k + 1) >= 0)
+      _bn_sub_limbs(r, r, n, k + 1);
+
+   return _bn_store_limbs(a, r, k);
+}
+
+bn_t *bn_to_mon(bn_t *a, bn_t *n)
+{
+   // A Montgomery product only takes inputs below R
+   if(a->used > n->n_limbs)
+      bn_reduce_slow(a, n);
+
+   // aR = a * R**2 / R
+   return _bn_mon_mul(a, a, bn_mon_ctxt(n)->rr, n, bn_mon_ctxt(n)->mp);
+}
+
+bn_t *bn_from_mon(bn_t *a, bn_t *n)
+{
+   // a = aR * 1 / R
+   return _bn_mon_mul(a, a, bn_mon_ctxt(n)->unit, n, bn_mon_ctxt(n)->mp);
+}
+
+bn_t *bn_mon_mul(bn_t *d, bn_t *a, bn_t *b, bn_t *n)
+{
+   return _bn_mon_mul(d, a, b, n, bn_mon_ctxt(n)->mp);
+}
+
+bn_t *bn_mon_mul_ws(bn_t *d, bn_t *a, bn_t *b, bn_t *n, ul_t *ws)
+{
+   return _bn_mon_mul_ws(d, a, b, n, bn_mon_ctxt(n)->mp, ws, &ws[4 * n->n_limbs + 2]);
+}
+
+bn_t *bn_mon_sqr(bn_t *d, bn_t *a, bn_t *n)
+{
+   return _bn_mon_sqr(d, a, n, bn_mon_ctxt(n)->mp);
+}
+
+bn_t *bn_mon_sqr_ws(bn_t *d, bn_t *a, bn_t *n, ul_t *ws)
+{
+   return _bn_mon_sqr_ws(d, a, n, bn_mon_ctxt(n)->mp, ws, &ws[4 * n->n_limbs + 2]);
+}
+
+// Montgomery reduction
+bn_t *bn_mon_reduce(bn_t *a, bn_t *n)
+{
+   ull_t r = (ull_t)1 << BN_LIMB_BITS;
+   ul_t mu, mp = bn_mon_ctxt(n)->mp;
+
+   bn_t *at = bn_copy(bn_alloc_limbs(a->n_limbs * 2 + 1), a);
+   bn_t *tmp = bn_alloc_limbs(a->n_limbs * 2 + 1);
+
+   for(int x = 0; x < a->n_limbs; x++)
+   {
+      mu = at->l[x] * mp % r;
+
+      bn_mul_ui(tmp, n, mu);
+      _bn_lshift_limbs(tmp, x);
+
+      _bn_add(at, at, tmp);
+   }
+
+   _bn_rshift_limbs(at, a->n_limbs);
+
+   bn_copy(a, at);
+
+   bn_free(at);
+   bn_free(tmp);
+
+   return a;
+}
+
+// Square and multiply exponentiation
+bn_t *bn_mon_pow_sm(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+{
+   // D = A**E % N
+   bn_t *s = bn_copy(bn_alloc(a->n), a);
+   bn_t *t = bn_copy(bn_alloc(d->n), d);
+
+   s16 dig[RECODE_DIGITS(e)];
+   int len = recode_binary(dig, e);
+
+   bn_copy(t, bn_mon_ctxt(n)->one);
+
+   for(int i = 0; i < len; i++)
+   {
+      if(dig[i])
+         bn_mon_mul(t, t, s, n);
+
+      bn_mon_sqr(s, s, n);
+   }
+
+   bn_copy(d, t);
+
+   bn_free(s);
+   bn_free(t);
+
+   return d;
+}
+
+// Square and multiply montgomery power ladder
+bn_t *bn_mon_pow_ml(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+{
+   // D = A**E % N
+   bn_t *r0 = bn_copy(bn_alloc(a->n), bn_mon_ctxt(n)->one);
+   bn_t *r1 = bn_copy(bn_alloc(a->n), a);
+
+   // The ladder always runs over every bit of E, whatever its value
+   s16 dig[e->n * 8 + 1];
+
+   memset(dig, 0, sizeof(dig));
+   recode_binary(dig, e);
+
+   for(int i = e->n * 8; i >= 0; i--)
+   {
+      if(dig[i])
+      {
+         bn_mon_mul(r0, r0, r1, n);
+         bn_mon_sqr(r1, r1, n);
+      }
+      else
+      {
+         bn_mon_mul(r1, r0, r1, n);
+         bn_mon_sqr(r0, r0, n);
+      }
+   }
+
+   bn_copy(d, r0);
+
+   bn_free(r0);
+   bn_free(r1);
+
+   return d;
+}
+
+// Sliding window size for the exponent E: the one that needs the fewest
+// products, counting the cache of odd powers (one squaring and 2**(w - 1) - 1
+// products, nothing for w = 1) and the windows of E, which are counted exactly.
+// Short or sparse exponents, like the usual RSA e = 65537, get w = 1, i.e.,
+// plain square-and-multiply. The cost only falls until the best w, so the
+// search stops at the first increase.
+static int _bn_pow_wsize(bn_t *e)
+{
+   int top = bn_maxbit(e), best = 1, cost = -1;
+
+   for(int w = 1; w <= 6; w++)
+   {
+      int c = (w > 1) ? 1 << (w - 1) : 0;
+
+      for(int i = top; i >= 0 && (cost < 0 || c < cost);)
+      {
+         if(bn_getbit(e, i))
+         {
+            c++;
+            i -= w;
+         }
+         else
+            i--;
+      }
+
+      if(cost >= 0 && c >= cost)
+         break;
+
+      best = w;
+      cost = c;
+   }
+
+   return best;
+}
+
+// Sliding-window exponentiation (HAC 14.83)
+bn_t *bn_mon_pow_sw(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+{
+   // D = A**E % N
+   ul_t *ws = (ul_t *)mem_alloc(BN_MON_POW_WS_LIMBS(n->n_limbs) * BN_LIMB_BYTES);
+
+   bn_mon_pow_ws(d, a, e, n, ws);
+
+   mem_free(ws);
+
+   return d;
+}
+
+bn_t *bn_mon_pow_ws(bn_t *d, bn_t *a, bn_t *e, bn_t *n, ul_t *ws)
+{
+   // D = A**E % N
+   bn_mon_ctxt_t *ctxt = bn_mon_ctxt(n);
+   int nl = n->n_limbs;
+
+   // Select which window size to use
+   int wsize = _bn_pow_wsize(e);
+
+   // Workspace layout: two accumulators (2 * nl + 2 limbs each), A**2, the
+   // cache of odd powers A, A**3, A**5, ... (nl limbs each, up to 32 of them)
+   // and the multiplication scratch
+   ul_t *t = ws, *u = &ws[2 * nl + 2], *a2 = &ws[4 * nl + 4], *cache = &ws[5 * nl + 4], *mw = &cache[32 * nl], *s;
+
+   //
+   // Initialize the cache
+   //
+   _bn_load_limbs(cache, a, nl);
+
+   if(wsize > 1)
+      memcpy(a2, _bn_mon_sqr_limbs(u, cache, n->l, ctxt->mp, nl, mw), nl * BN_LIMB_BYTES);
+
+   for(int i = 1; i < 1 << (wsize - 1); i++)
+   {
+      _bn_mon_mul_limbs(u, &cache[(i - 1) * nl], a2, n->l, ctxt->mp, nl, mw);
+      memcpy(&cache[i * nl], u, nl * BN_LIMB_BYTES);
+   }
+
+   // T only gets set by the first window, so 1 is never squared
+   s16 dig[RECODE_DIGITS(e)];
+   int set = 0;
+
+   // And iterate over the windows, from the top: square for every digit, and
+   // multiply with the cache where a window ends (digits are always odd)
+   for(int i = recode_sliding(dig, e, wsize) - 1; i >= 0; i--)
+   {
+      if(set)
+      {
+         _bn_mon_sqr_limbs(u, t, n->l, ctxt->mp, nl, mw);
+         s = t, t = u, u = s;
+      }
+
+      if(!dig[i])
+         continue;
+
+      if(set)
+      {
+         _bn_mon_mul_limbs(u, t, &cache[(dig[i] >> 1) * nl], n->l, ctxt->mp, nl, mw);
+         s = t, t = u, u = s;
+      }
+      else
+         memcpy(t, &cache[(dig[i] >> 1) * nl], nl * BN_LIMB_BYTES);
+
+      set = 1;
+   }
+
+   // E = 0
+   if(!set)
+      _bn_load_limbs(t, ctxt->one, nl);
+
+   return _bn_store_limbs(d, t, nl);
+}
+
+#if defined(BN_X86_64)
+// AVX-512 IFMA exponentiation, in the IFMA form described next to _bn_has_ifma.
+
+// Split nl limbs into m digits of 52 bits.
+static void _bn_ifma_load(u64 *x, const ul_t *l, int nl, int m)
+{
+   for(int i = 0; i < m; i++)
+   {
+      int w = 52 * i / 64, s = 52 * i % 64;
+      u64 v = 0;
+
+      if(w < nl)
+         v = l[w] >> s;
+
+      if(s > 12 && w + 1 < nl)
+         v |= l[w + 1] << (64 - s);
+
+      x[i] = v & _BN_IFMA_MASK;
+   }
+}
+
+// Join m digits of 52 bits back into nl limbs.
+static void _bn_ifma_store(ul_t *l, int nl, const u64 *x, int m)
+{
+   memset(l, 0, nl * BN_LIMB_BYTES);
+
+   for(int i = 0; i < m; i++)
+   {
+      int w = 52 * i / 64, s = 52 * i % 64;
+
+      if(w < nl)
+         l[w] |= x[i] << s;
+
+      if(s > 12 && w + 1 < nl)
+         l[w + 1] |= x[i] >> (64 - s);
+   }
+}
+
+// Almost Montgomery multiplication: R = A * B / R' mod N, for A, B < 2N and
+// R < 2N. R may alias A or B.
+//
+// Each round adds a_i * B and q * N into an accumulator of m lanes and shifts
+// it down by one digit. The lanes have 12 bits of headroom, enough to carry
+// lazily until the very end for up to 8 * _BN_IFMA_MAX_VECS digits.
+__attribute__((target("avx512f,avx512ifma")))
+static void _bn_ifma_amm(u64 *r, const u64 *a, const u64 *b, const u64 *n, u64 k0, int m)
+{
+   __m512i acc[_BN_IFMA_MAX_VECS], zero = _mm512_setzero_si512();
+   int nv = m / 8;
+   u64 c;
+
+   for(int v = 0; v < nv; v++)
+      acc[v] = zero;
+
+   for(int i = 0; i < m; i++)
+   {
+      __m512i bi = _mm512_set1_epi64(b[i]), qi;
+
+      for(int v = 0; v < nv; v++)
+         acc[v] = _mm512_madd52lo_epu64(acc[v], _mm512_loadu_si512(&a[8 * v]), bi);
+
+      // q makes the lowest digit vanish
+      c = _mm_cvtsi128_si64(_mm512_castsi512_si128(acc[0]));
+      qi = _mm512_set1_epi64((c * k0) & _BN_IFMA_MASK);
+      c = (c + ((n[0] * ((c * k0) & _BN_IFMA_MASK)) & _BN_IFMA_MASK)) >> 52;
+
+      for(int v = 0; v < nv; v++)
+         acc[v] = _mm512_madd52lo_epu64(acc[v], _mm512_loadu_si512(&n[8 * v]), qi);
+
+      // Shift down by one digit, keeping the carry out of the lowest one
+      for(int v = 0; v < nv; v++)
+         acc[v] = _mm512_alignr_epi64((v + 1 < nv) ? acc[v + 1] : zero, acc[v], 1);
+
+      acc[0] = _mm512_mask_add_epi64(acc[0], 1, acc[0], _mm512_set1_epi64(c));
+
+      // The high halves belong one digit up, which is where they are now
+      for(int v = 0; v < nv; v++)
+      {
+         acc[v] = _mm512_madd52hi_epu64(acc[v], _mm512_loadu_si512(&a[8 * v]), bi);
+         acc[v] = _mm512_madd52hi_epu64(acc[v], _mm512_loadu_si512(&n[8 * v]), qi);
+      }
+   }
+
+   for(int v = 0; v < nv; v++)
+      _mm512_storeu_si512(&r[8 * v], acc[v]);
+
+   // Normalize to 52 bit digits
+   c = 0;
+
+   for(int i = 0; i < m; i++)
+   {
+      c += r[i];
+      r[i] = c & _BN_IFMA_MASK;
+      c >>= 52;
+   }
+}
+
+// Loads N, R'**2 mod N and A (plain) as m digits each. A is clobbered.
+// Returns -N**-1 mod 2**52.
+static u64 _bn_ifma_init(u64 *n52, u64 *rr, u64 *x, bn_t *a, bn_t *n, int m)
+{
+   int nl = n->n_limbs;
+
+   // A only has to be below R' / 4
+   for(int i = nl; i < a->n_limbs; i++)
+   {
+      if(a->l[i])
+      {
+         bn_reduce_slow(a, n);
+         break;
+      }
+   }
+
+   bn_mon_ctxt_t *ctxt = bn_mon_ctxt(n);
+
+   _bn_ifma_load(rr, ctxt->rr52->l, nl, m);
+   _bn_ifma_load(n52, n->l, nl, m);
+   _bn_ifma_load(x, a->l, MIN(nl, a->n_limbs), m);
+
+   return ctxt->mp & _BN_IFMA_MASK;
+}
+
+// Stores T (at most N, as left by the conversion back from IFMA form) into D.
+static bn_t *_bn_ifma_finish(bn_t *d, const u64 *t, bn_t *n, int m)
+{
+   int nl = n->n_limbs;
+   ul_t r[nl];
+
+   _bn_ifma_store(r, nl, t, m);
+
+   if(_bn_cmp_limbs(r, n->l, nl) >= 0)
+      _bn_sub_limbs(r, r, n->l, nl);
+
+   return _bn_store_limbs(d, r, nl);
+}
+
+// D = A**E % N in IFMA form (sliding window, like bn_mon_pow_ws). A is
+// clobbered.
+static bn_t *_bn_pow_ifma(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+{
+   int nl = n->n_limbs, m = _bn_ifma_digits(nl);
+
+   // Select which window size to use
+   int wsize = _bn_pow_wsize(e);
+
+   u64 *ws = (u64 *)mem_alloc((5 + (1 << (wsize - 1))) * m * sizeof(u64));
+   u64 *n52 = ws, *x = &ws[m], *t = &ws[2 * m], *rr = &ws[3 * m], *a2 = &ws[4 * m], *cache = &ws[5 * m];
+   u64 k0 = _bn_ifma_init(n52, rr, x, a, n, m);
+
+   //
+   // Initialize the cache
+   //
+   _bn_ifma_amm(cache, x, rr, n52, k0, m);
+
+   if(wsize > 1)
+      _bn_ifma_amm(a2, cache, cache, n52, k0, m);
+
+   for(int i = 1; i < 1 << (wsize - 1); i++)
+      _bn_ifma_amm(&cache[i * m], &cache[(i - 1) * m], a2, n52, k0, m);
+
+   memset(x, 0, m * sizeof(u64));
+   x[0] = 1;
+
+   // T only gets set by the first window, so 1 is never squared
+   s16 *dig = (s16 *)mem_alloc(RECODE_DIGITS(e) * sizeof(s16));
+   int set = 0;
+
+   // And iterate over the windows, from the top
+   for(int i = recode_sliding(dig, e, wsize) - 1; i >= 0; i--)
+   {
+      if(set)
+         _bn_ifma_amm(t, t, t, n52, k0, m);
+
+      if(!dig[i])
+         continue;
+
+      if(set)
+         _bn_ifma_amm(t, t, &cache[(dig[i] >> 1) * m], n52, k0, m);
+      else
+         memcpy(t, &cache[(dig[i] >> 1) * m], m * sizeof(u64));
+
+      set = 1;
+   }
+
+   mem_free(dig);
+
+   // E = 0, and 1 in IFMA form is R' mod N
+   if(!set)
+      _bn_ifma_amm(t, rr, x, n52, k0, m);
+
+   // Back from IFMA form, which leaves a value of at most N
+   _bn_ifma_amm(t, t, x, n52, k0, m);
+   _bn_ifma_finish(d, t, n, m);
+
+   mem_free(ws);
+
+   return d;
+}
+
+// The same product for 8 independent operations, one in each lane. Digit j
+// of lane l lives at [8 * j + l], so every vector op works on the same digit
+// of all lanes and no lane has to talk to another one. acc is scratch space
+// of 8 * (2 * m + 1) digits.
+__attribute__((target("avx512f,avx512ifma")))
+static void _bn_ifma_amm_x8(u64 *r, const u64 *a, const u64 *b, const u64 *n, const u64 *k0, int m, u64 *acc)
+{
+   __m512i mask = _mm512_set1_epi64(_BN_IFMA_MASK), kv = _mm512_loadu_si512(k0), zero = _mm512_setzero_si512();
+   __m512i c, t;
+
+   memset(acc, 0, 8 * (2 * m + 1) * sizeof(u64));
+
+   // Round i works on the window acc[8 * i] ... acc[8 * (i + m)], which
+   // shifts the accumulator down by one digit per round for free
+   for(int i = 0; i < m; i++)
+   {
+      u64 *ac = &acc[8 * i];
+      __m512i bi = _mm512_loadu_si512(&b[8 * i]), q, aj, nj;
+
+      t = _mm512_madd52lo_epu64(_mm512_loadu_si512(ac), _mm512_loadu_si512(a), bi);
+      q = _mm512_madd52lo_epu64(zero, t, kv);
+
+      for(int j = 0; j < m; j++)
+      {
+         aj = _mm512_loadu_si512(&a[8 * j]);
+         nj = _mm512_loadu_si512(&n[8 * j]);
+
+         if(j)
+            t = _mm512_madd52lo_epu64(_mm512_loadu_si512(&ac[8 * j]), aj, bi);
+
+         _mm512_storeu_si512(&ac[8 * j], _mm512_madd52lo_epu64(t, nj, q));
+
+         t = _mm512_madd52hi_epu64(_mm512_loadu_si512(&ac[8 * j + 8]), aj, bi);
+         _mm512_storeu_si512(&ac[8 * j + 8], _mm512_madd52hi_epu64(t, nj, q));
+      }
+
+      // The lowest digit is zero modulo 2**52 now, pass its carry on
+      t = _mm512_add_epi64(_mm512_loadu_si512(&ac[8]), _mm512_srli_epi64(_mm512_loadu_si512(ac), 52));
+      _mm512_storeu_si512(&ac[8], t);
+   }
+
+   // Normalize to 52 bit digits
+   c = zero;
+
+   for(int j = 0; j < m; j++)
+   {
+      t = _mm512_add_epi64(_mm512_loadu_si512(&acc[8 * (m + j)]), c);
+      _mm512_storeu_si512(&r[8 * j], _mm512_and_si512(t, mask));
+      c = _mm512_srli_epi64(t, 52);
+   }
+}
+
+// D[i] = A[i]**E[i] % N[i] for the cnt <= 8 entries listed in idx, all with
+// moduli of the same number of limbs, run side by side in IFMA lanes.
+//
+// Lanes can't branch on their own exponent bits, so instead of the sliding
+// window this uses its fixed window variant: every lane squares w times and
+// then multiplies with its own table entry, gathered into one operand.
+static void _bn_pow_ifma_x8(bn_t **d, bn_t **a, bn_t **e, bn_t **n, const int *idx, int cnt)
+{
+   int nl = n[idx[0]]->n_limbs, m = _bn_ifma_digits(nl), w = 1, bits = 1;
+   u64 k0[8];
+
+   for(int l = 0; l < cnt; l++)
+      bits = MAX(bits, bn_maxbit(e[idx[l]]) + 1);
+
+   // Window size: the table costs 2**w - 2 products and the windows one each
+   for(int x = 2; x <= 5; x++)
+      if((1 << x) - 2 + (bits + x - 1) / x < (1 << w) - 2 + (bits + w - 1) / w)
+         w = x;
+
+   // Lane vectors of m digits: N, R'**2, 1, T, the gathered table entry, the
+   // product scratch space and the table of A**0 ... A**(2**w - 1)
+   u64 *ws = (u64 *)mem_alloc(8 * ((7 + (1 << w)) * m + 1) * sizeof(u64));
+   u64 *n8 = ws, *rr = &ws[8 * m], *one = &ws[16 * m], *t = &ws[24 * m], *g = &ws[32 * m];
+   u64 *acc = &ws[40 * m], *tab = &ws[8 * (7 * m + 1)];
+
+   // Set up each lane, unused lanes just repeat the first entry
+   u64 *s = (u64 *)mem_alloc(3 * m * sizeof(u64));
+
+   for(int l = 0; l < 8; l++)
+   {
+      int i = idx[(l < cnt) ? l : 0];
+      bn_t *ta = bn_copy(bn_alloc(a[i]->n), a[i]);
+
+      k0[l] = _bn_ifma_init(s, &s[m], &s[2 * m], ta, n[i], m);
+
+      for(int j = 0; j < m; j++)
+      {
+         n8[8 * j + l] = s[j];
+         rr[8 * j + l] = s[m + j];
+         t[8 * j + l] = s[2 * m + j];
+         one[8 * j + l] = (j == 0);
+      }
+
+      bn_free(ta);
+   }
+
+   mem_free(s);
+
+   // A**0 is R' mod N, A**1 is A * R'**2 / R'
+   _bn_ifma_amm_x8(tab, rr, one, n8, k0, m, acc);
+   _bn_ifma_amm_x8(&tab[8 * m], t, rr, n8, k0, m, acc);
+
+   for(int i = 2; i < 1 << w; i++)
+      _bn_ifma_amm_x8(&tab[8 * m * i], &tab[8 * m * (i - 1)], &tab[8 * m], n8, k0, m, acc);
+
+   memcpy(t, tab, 8 * m * sizeof(u64));
+
+   // Every lane gets as many windows as the longest exponent
+   int nw = (bits + w - 1) / w;
+   s16 *dig = (s16 *)mem_alloc(8 * nw * sizeof(s16));
+
+   memset(dig, 0, 8 * nw * sizeof(s16));
+
+   for(int l = 0; l < 8; l++)
+      recode_window(&dig[l * nw], e[idx[(l < cnt) ? l : 0]], w);
+
+   // And iterate over the windows, from the top
+   for(int i = nw - 1; i >= 0; i--)
+   {
+      for(int j = 0; j < w; j++)
+         _bn_ifma_amm_x8(t, t, t, n8, k0, m, acc);
+
+      for(int l = 0; l < 8; l++)
+      {
+         int win = dig[l * nw + i];
+
+         for(int j = 0; j < m; j++)
+            g[8 * j + l] = tab[8 * m * win + 8 * j + l];
+      }
+
+      _bn_ifma_amm_x8(t, t, g, n8, k0, m, acc);
+   }
+
+   mem_free(dig);
+
+   // Back from IFMA form
+   _bn_ifma_amm_x8(t, t, one, n8, k0, m, acc);
+
+   u64 *r = (u64 *)mem_alloc(m * sizeof(u64));
+
+   for(int l = 0; l < cnt; l++)
+   {
+      for(int j = 0; j < m; j++)
+         r[j] = t[8 * j + l];
+
+      _bn_ifma_finish(d[idx[l]], r, n[idx[l]], m);
+   }
+
+   mem_free(r);
+   mem_free(ws);
+}
+#endif
+
+bn_t *bn_mon_pow(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
 {
-   // Single largest shift we can do is one limb
-   while(b > BN_LIMB_BITS)
+#if defined(BN_X86_64)
+   // The IFMA code works on plain numbers
+   if(_bn_ifma_usable(n))
    {
-      _bn_rshift_limbs(a, 1);
-      b -= BN_LIMB_BITS;
+      bn_t *t = bn_from_mon(bn_copy(bn_alloc(a->n), a), n);
+
+      bn_to_mon(_bn_pow_ifma(d, t, e, n), n);
+      bn_free(t);
+
+      return d;
    }
+#endif
 
-   return _bn_rshift(a, b);
+   return bn_mon_pow_sw(d, a, e, n);
 }
 
-int bn_lsb(bn_t *a)
+// T = T * A, where an empty T (*set == 0) just takes A.
+static void _bn_mon_acc_limbs(ul_t *t, int *set, const ul_t *a, const ul_t *n, ul_t mp, int nl, ul_t *ws, ul_t *mw)
 {
-   return a->l[0] & 1;
+   if(*set)
+      memcpy(t, _bn_mon_mul_limbs(ws, t, a, n, mp, nl, mw), nl * BN_LIMB_BYTES);
+   else
+      memcpy(t, a, nl * BN_LIMB_BYTES);
+
+   *set = 1;
 }
 
-int bn_msb(bn_t *a)
+// Straus: every base gets a table of its odd powers up to 2**w - 1 and its own
+// sliding windows, and all of them share one chain of squarings.
+static void _bn_mon_pow_straus(ul_t *r, int *set, const ul_t *a, bn_t **e, int k, int bits, int w, bn_t *n, ul_t mp)
 {
-   return a->l[a->n - 1] >> (BN_LIMB_BITS - 1);
+   int nl = n->n_limbs, h = 1 << (w - 1);
+   ul_t *tbl = (ul_t *)mem_alloc(k * h * nl * BN_LIMB_BYTES), t[2 * nl + 2], *mw = _bn_mon_ws_alloc(nl);
+
+   // Sliding window digits of each exponent, padded to the longest one
+   s16 *win = (s16 *)mem_alloc(k * bits * sizeof(s16));
+
+   memset(win, 0, k * bits * sizeof(s16));
+
+   for(int i = 0; i < k; i++)
+   {
+      ul_t *row = &tbl[i * h * nl];
+
+      memcpy(row, &a[i * nl], nl * BN_LIMB_BYTES);
+
+      if(h > 1)
+      {
+         ul_t sq[nl];
+
+         memcpy(sq, _bn_mon_sqr_limbs(t, row, n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
+
+         for(int j = 1; j < h; j++)
+            memcpy(&row[j * nl], _bn_mon_mul_limbs(t, &row[(j - 1) * nl], sq, n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
+      }
+
+      recode_sliding(&win[i * bits], e[i], w);
+   }
+
+   for(int x = bits - 1; x >= 0; x--)
+   {
+      if(*set)
+         memcpy(r, _bn_mon_sqr_limbs(t, r, n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
+
+      for(int i = 0; i < k; i++)
+         if(win[i * bits + x])
+            _bn_mon_acc_limbs(r, set, &tbl[(i * h + (win[i * bits + x] >> 1)) * nl], n->l, mp, nl, t, mw);
+   }
+
+   mem_free(win);
+   mem_free(mw);
+   mem_free(tbl);
 }
 
-#if defined(BN_PRINT_FUNCS)
-void bn_print(FILE *fp, const s8 *pre, bn_t *a, const s8 *post)
+// Pippenger: for each c-bit digit position, every base goes into the bucket of its
+// digit, and the buckets are summed as B[m] * (B[m] * B[m - 1]) * ... for the powers.
+static void _bn_mon_pow_pippenger(ul_t *r, int *set, const ul_t *a, bn_t **e, int k, int bits, int c, bn_t *n, ul_t mp)
 {
-   int i, init = 1;
+   int nl = n->n_limbs, m = (1 << c) - 1, bset[m + 1], nd = (bits + c - 1) / c;
+   ul_t *bkt = (ul_t *)mem_alloc((m + 1) * nl * BN_LIMB_BYTES), run[nl], sum[nl], t[2 * nl + 2], *mw = _bn_mon_ws_alloc(nl);
 
-   fputs((char *)pre, fp);
+   // The c-bit digits of each exponent, padded to the longest one
+   s16 *dig = (s16 *)mem_alloc(k * nd * sizeof(s16));
 
-   //Skip zero limbs.
-   for(i = a->n_limbs - 1; i >= 0; i--)
-      if(a->l[i] != 0)
-         break;
+   memset(dig, 0, k * nd * sizeof(s16));
 
-   for(; i >= 0; i--)
+   for(int i = 0; i < k; i++)
+      recode_window(&dig[i * nd], e[i], c);
+
+   for(int x = nd - 1; x >= 0; x--)
    {
-      if(init)
+      int rs = 0, ss = 0;
+
+      for(int j = 0; j < c && *set; j++)
+         memcpy(r, _bn_mon_sqr_limbs(t, r, n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
+
+      memset(bset, 0, sizeof(bset));
+
+      for(int i = 0; i < k; i++)
       {
-         init = 0;
-         fprintf(fp, BN_PRINT_FORMAT_I, a->l[i]);
+         int v = dig[i * nd + x];
+
+         if(v)
+            _bn_mon_acc_limbs(&bkt[v * nl], &bset[v], &a[i * nl], n->l, mp, nl, t, mw);
+      }
+
+      for(int v = m; v > 0; v--)
+      {
+         if(bset[v])
+            _bn_mon_acc_limbs(run, &rs, &bkt[v * nl], n->l, mp, nl, t, mw);
+         if(rs)
+            _bn_mon_acc_limbs(sum, &ss, run, n->l, mp, nl, t, mw);
+      }
+
+      if(ss)
+         _bn_mon_acc_limbs(r, set, sum, n->l, mp, nl, t, mw);
+   }
+
+   mem_free(dig);
+   mem_free(mw);
+   mem_free(bkt);
+}
+
+bn_t *bn_mon_pow_multi(bn_t *d, bn_t **a, bn_t **e, int k, bn_t *n)
+{
+   // D = A[0]**E[0] * ... * A[k - 1]**E[k - 1] % N
+   bn_mon_ctxt_t *ctxt = bn_mon_ctxt(n);
+   int nl = n->n_limbs, bits = 1, set = 0, w = 1, c = 1;
+   long sc = -1, pc = -1;
+   ul_t r[nl];
+
+   for(int i = 0; i < k; i++)
+      bits = MAX(bits, bn_maxbit(e[i]) + 1);
+
+   // Products besides the shared squarings: tables plus one per window for Straus,
+   // one per base and two per bucket for each digit for Pippenger
+   for(int x = 1; x <= 6; x++)
+   {
+      long cost = (long)k * ((1 << (x - 1)) + bits / (x + 1));
+
+      if(sc < 0 || cost < sc)
+         sc = cost, w = x;
+   }
+
+   for(int x = 1; x <= 12; x++)
+   {
+      long cost = (long)((bits + x - 1) / x) * (k + (2L << x));
+
+      if(pc < 0 || cost < pc)
+         pc = cost, c = x;
+   }
+
+   // Bases go next to each other, padded to the size of N
+   ul_t *al = (ul_t *)mem_alloc(k * nl * BN_LIMB_BYTES);
+
+   for(int i = 0; i < k; i++)
+      _bn_load_limbs(&al[i * nl], a[i], nl);
+
+   if(pc < sc)
+      _bn_mon_pow_pippenger(r, &set, al, e, k, bits, c, n, ctxt->mp);
+   else
+      _bn_mon_pow_straus(r, &set, al, e, k, bits, w, n, ctxt->mp);
+
+   mem_free(al);
+
+   // Nothing multiplied in means every exponent is 0
+   if(!set)
+      return bn_copy(d, ctxt->one);
+
+   return _bn_store_limbs(d, r, nl);
+}
+
+// Bits s and up of A (nl limbs), assuming they fit in BN_LIMB_BITS - 2 bits.
+static l_t _bn_top_bits(const ul_t *a, int nl, int s)
+{
+   int i = s / BN_LIMB_BITS, o = s % BN_LIMB_BITS;
+   ul_t r = 0;
+
+   if(i < nl)
+      r = a[i] >> o;
+   if(o && i + 1 < nl)
+      r |= a[i + 1] << (BN_LIMB_BITS - o);
+
+   return (l_t)r;
+}
+
+// (X, Y) = (A * X + B * Y, C * X + D * Y) in place, for |A|, ..., |D| < 2**(BN_LIMB_BITS - 2)
+// and results known to be non-negative and to fit in nl limbs.
+static void _bn_lehmer_limbs(ul_t *x, ul_t *y, int nl, l_t A, l_t B, l_t C, l_t D)
+{
+   ll_t cx = 0, cy = 0;
+
+   for(int i = 0; i < nl; i++)
+   {
+      cx += (ll_t)A * x[i] + (ll_t)B * y[i];
+      cy += (ll_t)C * x[i] + (ll_t)D * y[i];
+
+      x[i] = (ul_t)cx;
+      y[i] = (ul_t)cy;
+
+      cx >>= BN_LIMB_BITS;
+      cy >>= BN_LIMB_BITS;
+   }
+}
+
+bn_t *bn_inv(bn_t *d, bn_t *a, bn_t *n)
+{
+   // D = A**-1 % N, for any N (Lehmer's extended Euclid, TAOCP 4.5.2 Algorithm L)
+   int nl = _bn_used_limbs(n), an = _bn_used_limbs(a), k = 0;
+   int wl = MAX(an, nl);
+
+   // Along the remainder sequence r[i] = t[i] * A mod N the cofactors t[i] alternate
+   // in sign, so only their magnitudes U and V (at most N) are kept, and k tracks
+   // the index of X = r[k]
+   ul_t ws[4 * nl + 2 + 3 * wl + 4 * nl + 4];
+   ul_t *x = ws, *y = &ws[nl], *u = &ws[2 * nl], *v = &ws[3 * nl + 1], *t;
+   ul_t *q = &ws[4 * nl + 2], *p = &q[wl + 1], *dws = &p[2 * nl + 2];
+
+   assert(nl > 0);
+
+   memcpy(x, n->l, nl * BN_LIMB_BYTES);
+   memset(u, 0, 2 * (nl + 1) * BN_LIMB_BYTES);
+   v[0] = 1;
+
+   // Y = A % N
+   if(an >= nl)
+      _bn_divrem_limbs(q, y, a->l, an, n->l, nl, dws);
+   else
+      _bn_load_limbs(y, a, nl);
+
+   int xn = nl, yn = nl;
+
+   while(yn > 0 && !y[yn - 1])
+      yn--;
+
+   while(yn > 0)
+   {
+      // Run Euclid on the leading bits for as long as the quotients are certain
+      int s = MAX(xn * BN_LIMB_BITS - _bn_clz(x[xn - 1]) - (BN_LIMB_BITS - 2), 0), j = 0;
+      l_t xh = _bn_top_bits(x, xn, s), yh = _bn_top_bits(y, yn, s);
+      l_t A = 1, B = 0, C = 0, D = 1, T, qh;
+
+      while(yh + C != 0 && yh + D != 0)
+      {
+         qh = (xh + A) / (yh + C);
+
+         if(qh != (xh + B) / (yh + D))
+            break;
+
+         T = A - qh * C; A = C; C = T;
+         T = B - qh * D; B = D; D = T;
+         T = xh - qh * yh; xh = yh; yh = T;
+         j++;
+      }
+
+      if(B == 0)
+      {
+         // No certain quotient, so take a full step: (X, Y) = (Y, X % Y) and (U, V) = (V, U + Q * V)
+         int vn = nl + 1;
+
+         while(vn > 0 && !v[vn - 1])
+            vn--;
+
+         _bn_divrem_limbs(q, p, x, xn, y, yn, dws);
+         memcpy(x, p, yn * BN_LIMB_BYTES);
+         memset(&x[yn], 0, (xn - yn) * BN_LIMB_BYTES);
+
+         memset(p, 0, (nl + 1) * BN_LIMB_BYTES);
+         _bn_mul_limbs(p, q, xn - yn + 1, v, vn);
+         _bn_add_limbs(u, u, p, nl + 1);
+
+         t = x; x = y; y = t;
+         t = u; u = v; v = t;
+         xn = yn;
+         k++;
       }
       else
-         fprintf(fp, BN_PRINT_FORMAT, a->l[i]);
+      {
+         // Apply all the certain steps at once, knowing that the cofactors never cancel
+         _bn_lehmer_limbs(x, y, xn, A, B, C, D);
+         _bn_lehmer_limbs(u, v, nl + 1, A < 0 ? -A : A, B < 0 ? -B : B, C < 0 ? -C : C, D < 0 ? -D : D);
+         k += j;
+      }
+
+      while(xn > 0 && !x[xn - 1])
+         xn--;
+
+      yn = xn;
+
+      while(yn > 0 && !y[yn - 1])
+         yn--;
    }
 
-   fputs((char *)post, fp);
+   // No inverse unless gcd(A, N) = 1
+   if(xn != 1 || x[0] != 1)
+      return bn_zero(d);
+
+   // t[k] is positive for odd k and negative for even k
+   if(!(k & 1))
+      _bn_sub_limbs(u, n->l, u, nl);
+
+   return _bn_store_limbs(d, u, nl);
 }
 
-bn_t *bn_read(FILE *fp, bn_t *dst)
+// Constant-time inversion (Bernstein and Yang, "Fast constant-time gcd computation and
+// modular inversion", 2019). Values are kept in signed limbs of _BN_SG_BITS bits, the
+// top one carrying the sign, and divsteps are done _BN_SG_BITS at a time on the low bits.
+#if BN_LIMB_BITS == 64
+   #define _BN_SG_BITS 62
+   typedef int64_t _bn_sg_t;
+   typedef uint64_t _bn_sgu_t;
+   typedef __int128 _bn_sgw_t;
+#else
+   #define _BN_SG_BITS 30
+   typedef int32_t _bn_sg_t;
+   typedef uint32_t _bn_sgu_t;
+   typedef int64_t _bn_sgw_t;
+#endif
+
+#define _BN_SG_MASK ((_bn_sg_t)(((_bn_sgu_t)1 << _BN_SG_BITS) - 1))
+#define _BN_SG_SIGN(x) ((x) >> (sizeof(_bn_sg_t) * 8 - 1))
+
+// Split A (nl limbs) into cnt signed limbs.
+static void _bn_sg_load(_bn_sg_t *d, const ul_t *a, int nl, int cnt)
 {
-   s8 *data = mem_alloc(dst->n);
+   for(int i = 0; i < cnt; i++)
+   {
+      _bn_sgu_t r = 0;
 
-   fread(data, sizeof(u8), dst->n, fp);
-   bn_from_bin(dst, data, dst->n);
-   mem_free(data);
+      for(int b = 0, s = i * _BN_SG_BITS; b < _BN_SG_BITS && (s + b) / BN_LIMB_BITS < nl; )
+      {
+         int o = (s + b) % BN_LIMB_BITS;
 
-   return dst;
+         r |= (_bn_sgu_t)(a[(s + b) / BN_LIMB_BITS] >> o) << b;
+         b += BN_LIMB_BITS - o;
+      }
+
+      d[i] = (_bn_sg_t)r & _BN_SG_MASK;
+   }
 }
 
-bn_t *bn_write(FILE *fp, bn_t *num)
+// Join cnt normalized, non-negative signed limbs back into nl limbs.
+static void _bn_sg_store(ul_t *d, int nl, const _bn_sg_t *a, int cnt)
 {
-   u8 *data = mem_alloc(num->n);
+   for(int j = 0; j < nl; j++)
+   {
+      ul_t r = 0;
 
-   bn_to_bin(data, num);
-   fwrite(data, 1, num->n, fp);
-   mem_free(data);
+      for(int b = 0, s = j * BN_LIMB_BITS; b < BN_LIMB_BITS && (s + b) / _BN_SG_BITS < cnt; )
+      {
+         int o = (s + b) % _BN_SG_BITS;
+
+         r |= (ul_t)((_bn_sgu_t)a[(s + b) / _BN_SG_BITS] >> o) << b;
+         b += _BN_SG_BITS - o;
+      }
+
+      d[j] = r;
+   }
+}
+
+// Propagate the carries so that all limbs but the top one are in [0, 2**_BN_SG_BITS).
+static void _bn_sg_carry(_bn_sg_t *a, int cnt)
+{
+   for(int i = 0; i < cnt - 1; i++)
+   {
+      a[i + 1] += a[i] >> _BN_SG_BITS;
+      a[i] &= _BN_SG_MASK;
+   }
+}
+
+// _BN_SG_BITS divsteps on the low bits of F and G. Returns delta and the transition
+// matrix T = (u, v, q, r), scaled by 2**_BN_SG_BITS, without any data-dependent branch.
+static int _bn_sg_divsteps(int delta, _bn_sgu_t f, _bn_sgu_t g, _bn_sg_t *t)
+{
+   _bn_sg_t u = 1, v = 0, q = 0, r = 1, c, x;
+
+   for(int i = 0; i < _BN_SG_BITS; i++)
+   {
+      // If delta > 0 and g is odd: (delta, f, g) = (-delta, g, -f)
+      c = -(_bn_sg_t)(g & 1);
+      x = -(_bn_sg_t)(delta > 0) & c;
+
+      _bn_sgu_t y = (f ^ g) & (_bn_sgu_t)x;
+      f ^= y;
+      g ^= y;
+      g = (g ^ (_bn_sgu_t)x) - (_bn_sgu_t)x;
+
+      _bn_sg_t z = (u ^ q) & x;
+      u ^= z;
+      q ^= z;
+      q = (q ^ x) - x;
+
+      z = (v ^ r) & x;
+      v ^= z;
+      r ^= z;
+      r = (r ^ x) - x;
+
+      delta = (delta ^ (int)x) - (int)x;
+
+      // If g is odd: g = g + f. Then g = g / 2
+      g += f & (_bn_sgu_t)c;
+      q += u & c;
+      r += v & c;
+
+      delta++;
+      g >>= 1;
+      u *= 2;
+      v *= 2;
+   }
+
+   t[0] = u;
+   t[1] = v;
+   t[2] = q;
+   t[3] = r;
+
+   return delta;
+}
+
+// (F, G) = T * (F, G) / 2**_BN_SG_BITS, which is exact.
+static void _bn_sg_update_fg(_bn_sg_t *f, _bn_sg_t *g, const _bn_sg_t *t, int cnt)
+{
+   _bn_sgw_t cf = (_bn_sgw_t)t[0] * f[0] + (_bn_sgw_t)t[1] * g[0];
+   _bn_sgw_t cg = (_bn_sgw_t)t[2] * f[0] + (_bn_sgw_t)t[3] * g[0];
+
+   cf >>= _BN_SG_BITS;
+   cg >>= _BN_SG_BITS;
+
+   for(int i = 1; i < cnt; i++)
+   {
+      cf += (_bn_sgw_t)t[0] * f[i] + (_bn_sgw_t)t[1] * g[i];
+      cg += (_bn_sgw_t)t[2] * f[i] + (_bn_sgw_t)t[3] * g[i];
+
+      f[i - 1] = (_bn_sg_t)cf & _BN_SG_MASK;
+      g[i - 1] = (_bn_sg_t)cg & _BN_SG_MASK;
+
+      cf >>= _BN_SG_BITS;
+      cg >>= _BN_SG_BITS;
+   }
+
+   f[cnt - 1] = (_bn_sg_t)cf;
+   g[cnt - 1] = (_bn_sg_t)cg;
+}
+
+// (D, E) = T * (D, E) / 2**_BN_SG_BITS mod M, keeping both in (-2M, M). mi is M**-1 mod 2**_BN_SG_BITS.
+static void _bn_sg_update_de(_bn_sg_t *d, _bn_sg_t *e, const _bn_sg_t *t, const _bn_sg_t *m, _bn_sgu_t mi, int cnt)
+{
+   _bn_sg_t sd = _BN_SG_SIGN(d[cnt - 1]), se = _BN_SG_SIGN(e[cnt - 1]);
+   _bn_sg_t md = (t[0] & sd) + (t[1] & se), me = (t[2] & sd) + (t[3] & se);
+   _bn_sgw_t cd = (_bn_sgw_t)t[0] * d[0] + (_bn_sgw_t)t[1] * e[0];
+   _bn_sgw_t ce = (_bn_sgw_t)t[2] * d[0] + (_bn_sgw_t)t[3] * e[0];
+
+   // Add multiples of M so that the low bits cancel out
+   md -= (_bn_sg_t)((mi * (_bn_sgu_t)cd + (_bn_sgu_t)md) & (_bn_sgu_t)_BN_SG_MASK);
+   me -= (_bn_sg_t)((mi * (_bn_sgu_t)ce + (_bn_sgu_t)me) & (_bn_sgu_t)_BN_SG_MASK);
+
+   cd += (_bn_sgw_t)m[0] * md;
+   ce += (_bn_sgw_t)m[0] * me;
+
+   cd >>= _BN_SG_BITS;
+   ce >>= _BN_SG_BITS;
+
+   for(int i = 1; i < cnt; i++)
+   {
+      cd += (_bn_sgw_t)t[0] * d[i] + (_bn_sgw_t)t[1] * e[i] + (_bn_sgw_t)m[i] * md;
+      ce += (_bn_sgw_t)t[2] * d[i] + (_bn_sgw_t)t[3] * e[i] + (_bn_sgw_t)m[i] * me;
+
+      d[i - 1] = (_bn_sg_t)cd & _BN_SG_MASK;
+      e[i - 1] = (_bn_sg_t)ce & _BN_SG_MASK;
+
+      cd >>= _BN_SG_BITS;
+      ce >>= _BN_SG_BITS;
+   }
+
+   d[cnt - 1] = (_bn_sg_t)cd;
+   e[cnt - 1] = (_bn_sg_t)ce;
+}
+
+bn_t *bn_mon_inv(bn_t *d, bn_t *a, bn_t *n)
+{
+   // D = A**-1 % N in Montgomery form, i.e. R**2 / A, for odd N and A < N
+   int nl = n->n_limbs, bits = bn_maxbit(n) + 1, cnt = bits / _BN_SG_BITS + 1;
+   _bn_sg_t f[cnt], g[cnt], dv[cnt], e[cnt], m[cnt], t[4];
+   _bn_sgu_t mi;
+   ul_t r[nl];
+
+   // Enough divsteps for G to reach 0 on any input of this size (Theorem 11.2)
+   int steps = (bits < 46) ? (49 * bits + 80) / 17 : (49 * bits + 57) / 17;
+
+   assert(n->l[0] & 1);
+
+   _bn_sg_load(m, n->l, nl, cnt);
+
+   // Newton's iteration, each step doubles the number of correct low bits
+   mi = (_bn_sgu_t)m[0];
+
+   for(int i = 0; i < 5; i++)
+      mi *= 2 - (_bn_sgu_t)m[0] * mi;
+   _bn_sg_load(f, n->l, nl, cnt);
+   _bn_sg_load(g, a->l, MIN(a->n_limbs, nl), cnt);
+
+   // Starting from (D, E) = (0, R**2) makes D = +-R**2 / A once F = +-1
+   _bn_sg_load(e, bn_mon_ctxt(n)->rr->l, nl, cnt);
+   memset(dv, 0, sizeof(dv));
+
+   for(int i = 0, delta = 1; i < steps; i += _BN_SG_BITS)
+   {
+      delta = _bn_sg_divsteps(delta, (_bn_sgu_t)f[0], (_bn_sgu_t)g[0], t);
+
+      _bn_sg_update_de(dv, e, t, m, mi, cnt);
+      _bn_sg_update_fg(f, g, t, cnt);
+   }
+
+   // Bring D from (-2M, M) to [0, M), flipping the sign along with F
+   _bn_sg_t c = _BN_SG_SIGN(dv[cnt - 1]), s = _BN_SG_SIGN(f[cnt - 1]);
+
+   for(int i = 0; i < cnt; i++)
+      dv[i] += m[i] & c;
+   _bn_sg_carry(dv, cnt);
+
+   for(int i = 0; i < cnt; i++)
+      dv[i] = (dv[i] ^ s) - s;
+   _bn_sg_carry(dv, cnt);
+
+   c = _BN_SG_SIGN(dv[cnt - 1]);
+
+   for(int i = 0; i < cnt; i++)
+      dv[i] += m[i] & c;
+   _bn_sg_carry(dv, cnt);
+
+   _bn_sg_store(r, nl, dv, cnt);
+
+   return _bn_store_limbs(d, r, nl);
+}
+
+void bn_mon_inv_batch(bn_t **out, bn_t **in, int cnt, bn_t *n)
+{
+   // OUT[i] = IN[i]**-1 % N in Montgomery form, with a single inversion (Montgomery's trick)
+   bn_mon_ctxt_t *ctxt = bn_mon_ctxt(n);
+   int nl = n->n_limbs, first = -1;
+   ul_t a[nl], t[2 * nl + 2];
+
+   // Running products of the non-zero inputs, one row per input
+   ul_t *pre = (ul_t *)mem_alloc(cnt * nl * BN_LIMB_BYTES), *mw = _bn_mon_ws_alloc(nl);
+   bn_t *inv = bn_alloc_limbs(nl);
+
+   for(int i = 0; i < cnt; i++)
+   {
+      if(bn_is_zero(in[i]))
+      {
+         if(first >= 0)
+            memcpy(&pre[i * nl], &pre[(i - 1) * nl], nl * BN_LIMB_BYTES);
+
+         continue;
+      }
+
+      _bn_load_limbs(a, in[i], nl);
+
+      if(first < 0)
+      {
+         memcpy(&pre[i * nl], a, nl * BN_LIMB_BYTES);
+         first = i;
+      }
+      else
+         memcpy(&pre[i * nl], _bn_mon_mul_limbs(t, &pre[(i - 1) * nl], a, n->l, ctxt->mp, nl, mw), nl * BN_LIMB_BYTES);
+   }
+
+   if(first >= 0)
+      bn_mon_inv(inv, _bn_store_limbs(inv, &pre[(cnt - 1) * nl], nl), n);
+
+   // Walk back, peeling one input off the inverted product at a time. Zero has no
+   // inverse, so it is just passed through
+   for(int i = cnt - 1; i >= 0; i--)
+   {
+      if(i < first || bn_is_zero(in[i]))
+      {
+         bn_zero(out[i]);
+         continue;
+      }
+
+      // IN[i] is read before OUT[i] is written, so the two may be the same
+      _bn_load_limbs(a, in[i], nl);
+
+      if(i == first)
+      {
+         bn_copy(out[i], inv);
+         continue;
+      }
+
+      _bn_store_limbs(out[i], _bn_mon_mul_limbs(t, inv->l, &pre[(i - 1) * nl], n->l, ctxt->mp, nl, mw), nl);
+      _bn_store_limbs(inv, _bn_mon_mul_limbs(t, inv->l, a, n->l, ctxt->mp, nl, mw), nl);
+   }
 
-   return num;
+   bn_free(inv);
+   mem_free(mw);
+   mem_free(pre);
 }
-#endif
 
-bn_t *bn_mul(bn_t *d, bn_t *a, bn_t *b)
+void bn_pow_mod_batch(bn_t **d, bn_t **a, bn_t **e, bn_t **n, int cnt)
 {
-   // D = A * b
-
-   // Can a hold the result?
-   assert(d->n >= (a->n * 2 + 1));
+   // D[i] = A[i]**E[i] mod N[i]
+   u8 done[cnt];
 
-   bn_zero(d);
+   memset(done, 0, cnt);
 
-   for(int i = 0; i < a->n_limbs; i++)
+#if defined(BN_X86_64)
+   // Moduli of the same size go through the IFMA lanes 8 at a time
+   for(int i = 0; i < cnt; i++)
    {
-      ull_t S = 0;
+      int idx[8], k = 0;
 
-      for(int j = 0; j < a->n_limbs; j++)
-      {
-         S += (ull_t)a->l[i] * b->l[j];
-         d->l[i+j] += S;
+      if(done[i] || !_bn_ifma_usable(n[i]))
+         continue;
 
-         S >>= BN_LIMB_BITS;
+      for(int j = i; j < cnt && k < 8; j++)
+      {
+         if(!done[j] && n[j]->n_limbs == n[i]->n_limbs)
+         {
+            idx[k++] = j;
+            done[j] = 1;
+         }
       }
 
-      d->l[i + a->n_limbs] = S;
+      _bn_pow_ifma_x8(d, a, e, n, idx, k);
    }
+#endif
 
-   return d;
+   // Everything else, one at a time
+   for(int i = 0; i < cnt; i++)
+   {
+      if(!done[i])
+         bn_pow_mod(d[i], a[i], e[i], n[i]);
+   }
 }
 
-bn_t *bn_mul_ui(bn_t *d, bn_t *a, ul_t b)
+bn_t *bn_pow_mod(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
 {
-   // D = A * b
-   ull_t S = 0;
-
-   // Can a hold the result?
-   assert(d->n >= (a->n + 1));
-
-   bn_zero(d);
+   // D = A**E mod N
+   bn_t *t = bn_copy(bn_alloc(a->n), a);
 
-   for(int x = 0; x < a->n_limbs; x++)
+#if defined(BN_X86_64)
+   // Big moduli run the whole exponentiation in IFMA form
+   if(_bn_ifma_usable(n))
    {
-      S += (ull_t)a->l[x] * b;
-      d->l[x] = S;
+      _bn_pow_ifma(d, t, e, n);
+      bn_free(t);
 
-      S >>= BN_LIMB_BITS;
+      return d;
    }
+#endif
+
+   bn_to_mon(t, n);
+
+   bn_from_mon(bn_mon_pow_sw(d, t, e, n), n);
+//   bn_from_mon(bn_mon_pow_ml(d, t, e, n), n);
 
-   d->l[a->n_limbs] = S;
+   bn_free(t);
 
    return d;
 }
 
-bn_t *bn_divrem(bn_t *q, bn_t *r, bn_t *a, bn_t *b)
+bn_comb_ctxt_t *bn_comb_ctxt_alloc(bn_t *g, bn_t *n, int bits)
 {
-   bn_zero(q);
-   bn_zero(r);
+   bn_comb_ctxt_t *ctxt = (bn_comb_ctxt_t *)mem_alloc(sizeof(bn_comb_ctxt_t));
+   int nl = n->n_limbs, cost = -1;
 
-   for(int i = bn_maxbit(a); i >= 0 ;i--)
+   // Pick the number of teeth h and tables v with the fewest products that fit in
+   // the table budget. v columns of b bits each cover the a = ceil(bits / h) bits
+   // between two teeth, and b - 1 is the number of squarings left per exponentiation
+   for(int h = 1; h <= 8; h++)
    {
-      bn_lshift(r, 1);
-      bn_lshift(q, 1);
+      int a = (bits + h - 1) / h, v = BN_COMB_TABLE_BYTES / (BN_LIMB_BYTES * nl * ((1 << h) - 1));
 
-      if(bn_getbit(a, i))
-         bn_setbit(r, 0);
+      if(v < 1)
+         break;
+
+      int b = (a + MIN(v, a) - 1) / MIN(v, a);
+      v = (a + b - 1) / b;
 
-      if(bn_cmp(r, b) >= 0)
+      // Squarings plus multiplications, weighed by how often a column is all zero
+      int c = 256 * (b - 1) + v * b * (256 - (256 >> h));
+
+      if(cost < 0 || c < cost)
       {
-         _bn_sub(r, r, b);
-         bn_setbit(q, 0);
+         cost = c;
+         ctxt->h = h;
+         ctxt->v = v;
+         ctxt->b = b;
       }
    }
 
-   return q;
-}
+   assert(cost >= 0);
 
-bn_t *bn_rand(bn_t *a)
-{
-   int size = a->n;
-   u8 *tmp = (u8 *)mem_alloc(size);
+   // The comb works modulo its own copy of N, whose Montgomery context is built right here so
+   // that exponentiations only read the comb
+   ctxt->n = bn_copy(bn_alloc_limbs(nl), n);
+   n = ctxt->n;
 
-   #if defined(_WIN32) || defined(_MSC_VER)
-      HCRYPTPROV hProvider;
+   bn_mon_ctxt_t *mon = bn_mon_ctxt(n);
 
-      CryptAcquireContext(&hProvider, 0, 0, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT | CRYPT_SILENT);
-      CryptGenRandom(hProvider, size, tmp);
-   #else
-      int fd = open("/dev/urandom", O_RDONLY, 0);
-      read(fd, tmp, size);
-      close(fd);
-   #endif
+   ctxt->a = ctxt->v * ctxt->b;
+   ctxt->bits = ctxt->h * ctxt->a;
+   ctxt->g = bn_copy(bn_alloc(g->n), g);
 
-   bn_zero(a);
-   bn_from_bin(a, (s8 *)tmp, size);
+   int h = ctxt->h, v = ctxt->v, b = ctxt->b, w = (1 << h) - 1;
+   ul_t x[nl], t[2 * nl + 2], *mw = _bn_mon_ws_alloc(nl);
+   ul_t *tbl = ctxt->tbl = (ul_t *)mem_alloc(v * w * nl * BN_LIMB_BYTES);
 
-   mem_free(tmp);
+   // Entry u - 1 of table j is the product of G**(2**(i * a + j * b)) over the bits i set in u.
+   // The single-bit entries are the powers of G every b squarings, in order
+   bn_t *gm = bn_to_mon(bn_copy(bn_alloc_limbs(nl), g), n);
+   _bn_load_limbs(x, gm, nl);
+   bn_free(gm);
 
-   return a;
-}
+   for(int i = 0; i < h; i++)
+   {
+      for(int j = 0; j < v; j++)
+      {
+         memcpy(&tbl[(j * w + (1 << i) - 1) * nl], x, nl * BN_LIMB_BYTES);
 
-// Generate random a \in [x, b - y].
-bn_t *bn_rand_range(bn_t *a, int x, bn_t *b, int y)
-{
-   bn_t *t = bn_alloc(b->n);
-   _bn_sub_ui(t, b, y);
+         for(int k = 0; k < b && (i < h - 1 || j < v - 1); k++)
+            memcpy(x, _bn_mon_sqr_limbs(t, x, n->l, mon->mp, nl, mw), nl * BN_LIMB_BYTES);
+      }
+   }
 
-   while(1)
+   for(int j = 0; j < v; j++)
    {
-      bn_rand(a);
+      ul_t *row = &tbl[j * w * nl];
 
-      if(bn_cmp_ui(a, x) <= 0)   // Check a < x
-         continue;
+      for(int u = 3; u <= w; u++)
+      {
+         int top = u;
 
-      if(bn_cmp(a, t) > 0)       // Check a > b - y
-         continue;
+         while(top & (top - 1))
+            top &= top - 1;
 
-      break;
+         if(u != top)
+            memcpy(&row[(u - 1) * nl], _bn_mon_mul_limbs(t, &row[(u - top - 1) * nl], &row[(top - 1) * nl], n->l, mon->mp, nl, mw), nl * BN_LIMB_BYTES);
+      }
    }
 
-   bn_free(t);
+   mem_free(mw);
 
-   return a;
+   return ctxt;
 }
 
-bn_t *bn_to_mon(bn_t *a, bn_t *n)
+void bn_comb_ctxt_free(bn_comb_ctxt_t *ctxt)
 {
-   bn_t *at = bn_copy(bn_alloc_limbs(a->n_limbs + 1), a);
-   bn_t *nt = bn_copy(bn_alloc_limbs(n->n_limbs + 1), n);
+   bn_free(ctxt->n);
+   bn_free(ctxt->g);
+   mem_free(ctxt->tbl);
+   mem_free(ctxt);
+}
+
+bn_t *bn_comb_pow_mod(bn_t *d, bn_t *e, bn_comb_ctxt_t *ctxt)
+{
+   // D = G**E mod N (Lim and Lee, "More flexible exponentiation with precomputation", 1994)
+   bn_t *n = ctxt->n;
+   ul_t mp = bn_mon_ctxt(n)->mp;
+   int nl = n->n_limbs, h = ctxt->h, v = ctxt->v, b = ctxt->b, w = (1 << h) - 1, first = 1;
+   ul_t r[nl], t[2 * nl + 2], *mw;
 
-   // We can't loop bn_add here since bn_add calls bn_reduce which in turn calls bn_to_mon.
-   // POOF, infinite recursion.
-   for(int x = 0; x < BN_LIMB_BITS * a->n_limbs; x++)
+   if(bn_maxbit(e) >= ctxt->bits)
+      return bn_pow_mod(d, ctxt->g, e, n);
+
+   s16 dig[ctxt->a];
+
+   mw = _bn_mon_ws_alloc(nl);
+
+   recode_comb(dig, e, h, v, b);
+
+   for(int k = b - 1; k >= 0; k--)
    {
-      _bn_add(at, at, at);
-      bn_reduce(at, nt);
+      if(!first)
+         memcpy(r, _bn_mon_sqr_limbs(t, r, n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
+
+      // Column k of every table: one bit from each of the h teeth
+      for(int j = 0; j < v; j++)
+      {
+         int u = dig[k * v + j];
+
+         if(!u)
+            continue;
+
+         if(first)
+            memcpy(r, &ctxt->tbl[(j * w + u - 1) * nl], nl * BN_LIMB_BYTES);
+         else
+            memcpy(r, _bn_mon_mul_limbs(t, r, &ctxt->tbl[(j * w + u - 1) * nl], n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
+
+         first = 0;
+      }
    }
 
-   bn_copy(a, at);
+   mem_free(mw);
 
-   bn_free(at);
-   bn_free(nt);
+   if(first)
+      return bn_set_ui(d, 1);
 
-   return a;
+   return bn_from_mon(_bn_store_limbs(d, r, nl), n);
 }
 
-bn_t *bn_from_mon(bn_t *a, bn_t *n)
+bn_vec_t *bn_vec_alloc(int cnt, int size, int layout)
 {
-   bn_t *t = bn_alloc(a->n);
-   bn_set_ui(t, 1);
+   int nl = BYTES_TO_LIMBS(size);
+   size_t head = (sizeof(bn_vec_t) + 15) & ~(size_t)15;
 
-   bn_mon_mul(a, a, t, n);
+   // The limbs follow the header, aligned like a bignum's (mem_alloc aligns to 16 bytes)
+   u8 *p = (u8 *)mem_alloc(head + BN_ALIGN - 16 + (size_t)cnt * nl * BN_LIMB_BYTES);
+   bn_vec_t *v = (bn_vec_t *)p;
 
-   bn_free(t);
+   if(p == NULL)
+      return NULL;
 
-   return a;
+   v->cnt = cnt;
+   v->nl = nl;
+   v->layout = layout;
+   v->l = (ul_t *)(p + head + ((-(uintptr_t)(p + head)) & (BN_ALIGN - 1)));
+
+   memset((char *)v->l, 0x00, (size_t)cnt * nl * BN_LIMB_BYTES);
+
+   return v;
 }
 
-bn_t *bn_mon_mul(bn_t *d, bn_t *a, bn_t *b, bn_t *n)
+void bn_vec_free(bn_vec_t *v)
 {
-   ul_t q;
-   ull_t r = (ull_t)1 << BN_LIMB_BITS;
+   // Zero it out, just for good measure
+   memset((char *)v->l, 0x00, (size_t)v->cnt * v->nl * BN_LIMB_BYTES);
 
-   // The calculation of the mp value needs to be done only once.
-   if(n->mp == 0)
-      _bn_mon_init(n);
+   mem_free(v);
+}
 
-   // This num needs to be 4 digits bigger so we prevent overflows.
-   // The mul_ui increases digit count by 1, and add's possibly increase
-   // the count by one (each).
-   bn_t *t = bn_alloc_limbs(n->n_limbs + 4);
+// Limb j of element i.
+#define _BN_VEC_AT(v, i, j) ((v)->layout == BN_VEC_AOS ? &(v)->l[(i) * (v)->nl + (j)] : &(v)->l[(j) * (v)->cnt + (i)])
 
-   for(int x = 0; x < a->n_limbs; x++)
-   {
-      q = (t->l[0] + a->l[x] * b->l[0]) * n->mp;
-      // q % r == q & (r-1), for r power of two
-      q = q & (r - 1);
+bn_vec_t *bn_vec_set(bn_vec_t *v, int i, bn_t *a)
+{
+   int s = MIN(a->used, v->nl);
 
-      _bn_mad_ui(t, n, q);
-      _bn_mad_ui(t, b, a->l[x]);
+   for(int j = 0; j < v->nl; j++)
+      *_BN_VEC_AT(v, i, j) = j < s ? a->l[j] : 0;
 
-      // Shift right by one limb
-      _bn_rshift_limbs(t, 1);
-   }
+   return v;
+}
 
-   if(bn_cmp(t, n) >= 0)
-      _bn_sub(t, t, n);
+bn_t *bn_vec_get(bn_t *d, bn_vec_t *v, int i)
+{
+   ul_t t[v->nl];
 
-   bn_copy(d, t);
-   bn_free(t);
+   for(int j = 0; j < v->nl; j++)
+      t[j] = *_BN_VEC_AT(v, i, j);
 
-   return d;
+   return _bn_store_limbs(d, t, v->nl);
 }
 
-// Montgomery reduction
-bn_t *bn_mon_reduce(bn_t *a, bn_t *n)
-{
-   ull_t r = (ull_t)1 << BN_LIMB_BITS;
-   ul_t mu;
+// The SoA kernels below run limb by limb over all k elements at once: the inner
+// loops go across elements, with the carries of each one kept in a row of its
+// own, so they have no dependency from one iteration to the next and compile to
+// SIMD where the limb products fit a vector lane.
 
-   // The calculation of the mp value needs to be done only once.
-   if(n->mp == 0)
-      _bn_mon_init(n);
+// D = T - N for the elements where T (with the carry row c) is at least N, else
+// T, for T < 2N. D may be T. m and b are scratch rows.
+static void _bn_vec_csub_soa(ul_t *d, const ul_t *t, const ul_t *c, const ul_t *n, int nl, int k, ul_t *m, ul_t *b)
+{
+   ull_t B;
 
-   bn_t *at = bn_copy(bn_alloc_limbs(a->n_limbs * 2 + 1), a);
-   bn_t *tmp = bn_alloc_limbs(a->n_limbs * 2 + 1);
+   for(int i = 0; i < k; i++)
+      b[i] = 0;
 
-   for(int x = 0; x < a->n_limbs; x++)
+   for(int j = 0; j < nl; j++)
    {
-      mu = at->l[x] * n->mp % r;
+      for(int i = 0; i < k; i++)
+      {
+         B = (ull_t)t[j * k + i] - n[j] - b[i];
+         b[i] = (B >> BN_LIMB_BITS) & 1;
+      }
+   }
 
-      bn_mul_ui(tmp, n, mu);
-      _bn_lshift_limbs(tmp, x);
+   // Subtract unless T - N borrowed past the carry
+   for(int i = 0; i < k; i++)
+   {
+      m[i] = (ul_t)0 - (ul_t)((b[i] ^ 1) | c[i]);
+      b[i] = 0;
+   }
 
-      _bn_add(at, at, tmp);
+   for(int j = 0; j < nl; j++)
+   {
+      for(int i = 0; i < k; i++)
+      {
+         B = (ull_t)t[j * k + i] - (n[j] & m[i]) - b[i];
+         d[j * k + i] = B;
+         b[i] = (B >> BN_LIMB_BITS) & 1;
+      }
    }
+}
 
-   _bn_rshift_limbs(at, a->n_limbs);
+// D = A * B / R mod N (CIOS), where limb x of element i of B is b[x * bs + i * bi],
+// so that B can be a vector (bs = k, bi = 1) or a single value (bs = 1, bi = 0).
+// ws is scratch space of _BN_VEC_MON_WS_BYTES(nl, k) bytes.
+#define _BN_VEC_MON_WS_BYTES(nl, k) ((k) * sizeof(ull_t) + ((nl) + 3) * (k) * BN_LIMB_BYTES)
 
-   bn_copy(a, at);
+static void _bn_vec_mon_mul_soa(ul_t *d, const ul_t *a, const ul_t *b, int bs, int bi, const ul_t *n, ul_t mp, int nl, int k, void *ws)
+{
+   ull_t *C = (ull_t *)ws;
+   ul_t *t = (ul_t *)&C[k], *u = &t[(nl + 2) * k];
 
-   bn_free(at);
-   bn_free(tmp);
+   memset(t, 0, (nl + 2) * k * BN_LIMB_BYTES);
 
-   return a;
-}
+   for(int x = 0; x < nl; x++)
+   {
+      const ul_t *bx = &b[x * bs];
 
-// Square and multiply exponentiation
-bn_t *bn_mon_pow_sm(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
-{
-   // D = A**E % N
-   bn_t *s = bn_copy(bn_alloc(a->n), a);
-   bn_t *t = bn_copy(bn_alloc(d->n), d);
+      for(int i = 0; i < k; i++)
+         C[i] = 0;
 
-   bn_set_ui(t, 1);
-   bn_to_mon(t, n);
+      for(int j = 0; j < nl; j++)
+      {
+         for(int i = 0; i < k; i++)
+         {
+            C[i] += (ull_t)a[j * k + i] * bx[i * bi] + t[j * k + i];
+            t[j * k + i] = C[i];
+            C[i] >>= BN_LIMB_BITS;
+         }
+      }
 
-   for(int i = 0; i <= bn_maxbit(e); i++)
-   {
-      if(bn_getbit(e, i))
-         bn_mon_mul(t, t, s, n);
+      for(int i = 0; i < k; i++)
+      {
+         C[i] += t[nl * k + i];
+         t[nl * k + i] = C[i];
+         t[(nl + 1) * k + i] = C[i] >> BN_LIMB_BITS;
+      }
 
-      bn_mon_mul(s, s, s, n);
-   }
+      // Add u * N, which clears the low limb, and shift down by one limb
+      for(int i = 0; i < k; i++)
+      {
+         u[i] = (ul_t)(t[i] * (ull_t)mp);
+         C[i] = ((ull_t)u[i] * n[0] + t[i]) >> BN_LIMB_BITS;
+      }
 
-   bn_copy(d, t);
+      for(int j = 1; j < nl; j++)
+      {
+         for(int i = 0; i < k; i++)
+         {
+            C[i] += (ull_t)u[i] * n[j] + t[j * k + i];
+            t[(j - 1) * k + i] = C[i];
+            C[i] >>= BN_LIMB_BITS;
+         }
+      }
 
-   bn_free(s);
-   bn_free(t);
+      for(int i = 0; i < k; i++)
+      {
+         C[i] += t[nl * k + i];
+         t[(nl - 1) * k + i] = C[i];
+         t[nl * k + i] = t[(nl + 1) * k + i] + (ul_t)(C[i] >> BN_LIMB_BITS);
+      }
+   }
 
-   return d;
+   _bn_vec_csub_soa(d, t, &t[nl * k], n, nl, k, u, &t[(nl + 1) * k]);
 }
 
-// Square and multiply montgomery power ladder
-bn_t *bn_mon_pow_ml(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+bn_vec_t *bn_vec_add(bn_vec_t *d, bn_vec_t *a, bn_vec_t *b, bn_t *n)
 {
-   // D = A**E % N
-   bn_t *r0 = bn_set_ui(bn_alloc(a->n), 1);
-   bn_t *r1 = bn_copy(bn_alloc(a->n), a);
+   int nl = n->n_limbs, k = a->cnt;
 
-   bn_to_mon(r0, n);
+   assert(a->nl == nl && b->nl == nl && d->nl == nl);
+   assert(a->layout == b->layout && a->layout == d->layout);
 
-   for(int i = e->n * 8; i >= 0; i--)
+   if(a->layout == BN_VEC_AOS)
    {
-      if(bn_getbit(e, i))
+      for(int i = 0; i < k; i++)
       {
-         bn_mon_mul(r0, r0, r1, n);
-         bn_mon_mul(r1, r1, r1, n);
+         ul_t *di = &d->l[i * nl];
+
+         if(_bn_add_limbs(di, &a->l[i * nl], &b->l[i * nl], nl) || _bn_cmp_limbs(di, n->l, nl) >= 0)
+            _bn_sub_limbs(di, di, n->l, nl);
       }
-      else
+
+      return d;
+   }
+
+   ul_t *c = (ul_t *)mem_alloc(3 * k * BN_LIMB_BYTES);
+   ull_t C;
+
+   for(int i = 0; i < k; i++)
+      c[i] = 0;
+
+   for(int j = 0; j < nl; j++)
+   {
+      for(int i = 0; i < k; i++)
       {
-         bn_mon_mul(r1, r0, r1, n);
-         bn_mon_mul(r0, r0, r0, n);
+         C = (ull_t)a->l[j * k + i] + b->l[j * k + i] + c[i];
+         d->l[j * k + i] = C;
+         c[i] = C >> BN_LIMB_BITS;
       }
    }
 
-   bn_copy(d, r0);
+   _bn_vec_csub_soa(d->l, d->l, c, n->l, nl, k, &c[k], &c[2 * k]);
 
-   bn_free(r0);
-   bn_free(r1);
+   mem_free(c);
 
    return d;
 }
 
-// Sliding-window exponentiation (HAC 14.83)
-bn_t *bn_mon_pow_sw(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+bn_vec_t *bn_vec_sub(bn_vec_t *d, bn_vec_t *a, bn_vec_t *b, bn_t *n)
 {
-   // D = A**E % N
-   bn_t *s = bn_copy(bn_alloc(a->n), a);
-   bn_t *t = bn_copy(bn_alloc(d->n), d);
-
-   // Select which window size to use
-   int blen = BN_LIMB_BITS * n->n_limbs;
-   int wsize = (blen > 671) ? 6 : (blen > 239) ? 5 : (blen >  79) ? 4 : (blen > 23) ? 3 : 1;
-
-   //
-   // Initialize the cache
-   //
-   bn_t *cache[1 << wsize];
-   bn_set_ui(t, 1);
-   bn_to_mon(t, n);
+   int nl = n->n_limbs, k = a->cnt;
 
-   // Initialize the cache first
-   for(int i = 0; i < (1 << wsize); i++)
-      cache[i] = bn_zero(bn_alloc(a->n));
+   assert(a->nl == nl && b->nl == nl && d->nl == nl);
+   assert(a->layout == b->layout && a->layout == d->layout);
 
-   // 1st and 2nd elements are always the same
-   bn_copy(cache[1], a);
-   bn_mon_mul(cache[2], a, a, n);
-
-   for(int i = 1; i < 1 << (wsize - 1); i++)
-      bn_mon_mul(cache[2*i+1], cache[2*i-1], cache[2], n);
-
-   // And iterate...
-   for(int i = bn_maxbit(e); i >= 0;)
+   if(a->layout == BN_VEC_AOS)
    {
-      // In the 0-bit case, just square
-      if(!bn_getbit(e, i))
-      {
-         bn_mon_mul(t, t, t, n);
-         i--;
-      }
-      else
+      for(int i = 0; i < k; i++)
       {
-         int num = 0;
-         int sub = 0;
-         int idx = 0;
-
-         for(int j = 0; j < wsize; j++)
-         {
-            if(i - j < 0)
-               break;
+         ul_t *di = &d->l[i * nl];
 
-            int bit = bn_getbit(e, i - j);
-            idx = (idx << 1) | bit;
+         if(_bn_subx_limbs(di, &a->l[i * nl], nl, &b->l[i * nl], nl))
+            _bn_add_limbs(di, di, n->l, nl);
+      }
 
-            if(bit)
-            {
-               num = idx;
-               sub = j + 1;
-            }
-         }
+      return d;
+   }
 
-         // Square first
-         for(int j = 0; j < sub; j++)
-            bn_mon_mul(t, t, t, n);
+   ul_t *c = (ul_t *)mem_alloc(2 * k * BN_LIMB_BYTES), *m = &c[k];
+   ull_t C;
 
-         // ...then multiply with cache
-         bn_mon_mul(t, t, cache[num], n);
+   for(int i = 0; i < k; i++)
+      c[i] = 0;
 
-         i -= sub;
+   for(int j = 0; j < nl; j++)
+   {
+      for(int i = 0; i < k; i++)
+      {
+         C = (ull_t)a->l[j * k + i] - b->l[j * k + i] - c[i];
+         d->l[j * k + i] = C;
+         c[i] = (C >> BN_LIMB_BITS) & 1;
       }
    }
 
-   bn_copy(d, t);
+   // Add N back where there was a borrow
+   for(int i = 0; i < k; i++)
+   {
+      m[i] = (ul_t)0 - c[i];
+      c[i] = 0;
+   }
 
-   bn_free(s);
-   bn_free(t);
+   for(int j = 0; j < nl; j++)
+   {
+      for(int i = 0; i < k; i++)
+      {
+         C = (ull_t)d->l[j * k + i] + (n->l[j] & m[i]) + c[i];
+         d->l[j * k + i] = C;
+         c[i] = C >> BN_LIMB_BITS;
+      }
+   }
 
-   for(int i = 0; i < (1 << wsize); i++)
-      bn_free(cache[i]);
+   mem_free(c);
 
    return d;
 }
 
-bn_t *bn_inv(bn_t *d, bn_t *a, bn_t *n)
+// D = A * B / R mod N, with B as in _bn_vec_mon_mul_soa: the limbs of a vector
+// (bi = 1) or of one value for all elements (bi = 0)
+static bn_vec_t *_bn_vec_mon_mul(bn_vec_t *d, bn_vec_t *a, const ul_t *b, int bi, bn_t *n)
 {
-   // D = A**-1 % N
-   bn_t *q = bn_alloc_limbs(n->n_limbs);
-   bn_t *r = bn_alloc_limbs(n->n_limbs);
-   bn_t *m = bn_alloc_limbs(n->n_limbs);
-   bn_t *t = bn_alloc_limbs(2*n->n_limbs);
-   bn_t *b = bn_copy(bn_alloc_limbs(n->n_limbs), n);
-   bn_t *nn = bn_copy(bn_alloc_limbs(2*n->n_limbs), n);
-
-   bn_t *x = bn_alloc_limbs(n->n_limbs);
-   bn_t *u = bn_alloc_limbs(n->n_limbs);
+   int nl = n->n_limbs, k = a->cnt;
+   ul_t mp = bn_mon_ctxt(n)->mp;
 
-   bn_set_ui(x, 0);
-   bn_set_ui(u, 1);
+   assert(a->nl == nl && d->nl == nl && a->layout == d->layout);
 
-   while(bn_cmp_ui(a, 0) != 0)
+   if(a->layout == BN_VEC_AOS)
    {
-      bn_divrem(q, r, b, a);
+      ul_t t[2 * nl + 2], *mw = _bn_mon_ws_alloc(nl);
 
-      bn_mul(t, u, q);
-      bn_reduce_slow(t, nn);
-      bn_sub(m, x, t, n);
+      for(int i = 0; i < k; i++)
+         memcpy(&d->l[i * nl], _bn_mon_mul_limbs(t, &a->l[i * nl], &b[i * bi * nl], n->l, mp, nl, mw), nl * BN_LIMB_BYTES);
 
-      bn_copy(b, a);
-      bn_copy(a, r);
-      bn_copy(x, u);
-      bn_copy(u, m);
+      mem_free(mw);
+
+      return d;
    }
 
-   bn_copy(d, x);
+   void *ws = mem_alloc(_BN_VEC_MON_WS_BYTES(nl, k));
 
-   bn_free(q);
-   bn_free(r);
-   bn_free(m);
-   bn_free(t);
-   bn_free(b);
-   bn_free(nn);
-   bn_free(x);
-   bn_free(u);
+   _bn_vec_mon_mul_soa(d->l, a->l, b, bi ? k : 1, bi, n->l, mp, nl, k, ws);
+
+   mem_free(ws);
 
    return d;
 }
 
-bn_t *bn_mon_inv(bn_t *d, bn_t *a, bn_t *n)
+bn_vec_t *bn_vec_mon_mul(bn_vec_t *d, bn_vec_t *a, bn_vec_t *b, bn_t *n)
 {
-   // D = A**-1 % N
+   assert(b->nl == a->nl && b->layout == a->layout);
 
-   // Note: Only for prime modulus
-   bn_t *t = bn_copy(bn_alloc(n->n), n);
-   bn_t *s = bn_alloc(n->n);
-
-   bn_set_ui(s, 2);
+   return _bn_vec_mon_mul(d, a, b->l, 1, n);
+}
 
-   _bn_sub(t, t, s);
-   bn_mon_pow_sw(d, a, t, n);
+bn_vec_t *bn_vec_to_mon(bn_vec_t *d, bn_vec_t *a, bn_t *n)
+{
+   ul_t r[n->n_limbs];
 
-   bn_free(t);
-   bn_free(s);
+   _bn_load_limbs(r, bn_mon_ctxt(n)->rr, n->n_limbs);
 
-   return d;
+   return _bn_vec_mon_mul(d, a, r, 0, n);
 }
 
-bn_t *bn_pow_mod(bn_t *d, bn_t *a, bn_t *e, bn_t *n)
+bn_vec_t *bn_vec_from_mon(bn_vec_t *d, bn_vec_t *a, bn_t *n)
 {
-   // D = A**E mod N
-   bn_t *t = bn_copy(bn_alloc(a->n), a);
-   bn_to_mon(t, n);
+   ul_t r[n->n_limbs];
 
-   bn_from_mon(bn_mon_pow_sw(d, t, e, n), n);
-//   bn_from_mon(bn_mon_pow_ml(d, t, e, n), n);
+   _bn_load_limbs(r, bn_mon_ctxt(n)->unit, n->n_limbs);
 
-   bn_free(t);
+   return _bn_vec_mon_mul(d, a, r, 0, n);
+}
 
-   return d;
+bn_vec_t *bn_vec_reduce(bn_vec_t *d, bn_vec_t *a, bn_t *n)
+{
+   // A * R^2 / R < R * N for any A < R, so the round trip reduces it fully
+   return bn_vec_from_mon(d, bn_vec_to_mon(d, a, n), n);
 }
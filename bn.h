@@ -18,6 +18,8 @@
 #endif
 
 #include "config.h"
+#include "arena.h"
+#include "pool.h"
 
 #if BN_LIMB_SIZE == 8
    #define l_t       int8_t
@@ -101,6 +103,9 @@ typedef uint64_t  u64;
 #define BYTES_TO_LIMBS(x) ((x * 8) / BN_LIMB_BITS + ((x * 8) % BN_LIMB_BITS ? 1 : 0))
 #define LIMBS_TO_BYTES(x) (x * BN_LIMB_BYTES)
 
+struct _bn_mon_ctxt_t;
+struct _bn_barrett_ctxt_t;
+
 /*! Bignum struct. */
 typedef struct _bn_t
 {
@@ -108,12 +113,84 @@ typedef struct _bn_t
    int n;
    /*! Length in limbs. */
    int n_limbs;
-   /*! A temporary value needed by Montgomery multiplication. */
-   ull_t mp;
-   /*! The limbs. */
-   ul_t *l;
+   /*! Used limbs: l[used - 1] is the top non-zero limb, all the ones above it are zero.
+       Kept up to date by every bn_* function that writes the limbs. */
+   int used;
+   /*! Offset (in bytes) of the bignum from the start of its allocation, or _BN_SHARED of it
+       when it shares the allocation with others and bn_free must not free it. */
+   int off;
+   /*! Montgomery context, built the first time the bignum is used as a modulus. */
+   struct _bn_mon_ctxt_t *mon;
+   /*! Barrett context, built the first time the bignum is used to reduce a wide value. */
+   struct _bn_barrett_ctxt_t *barrett;
+   /*! The limbs, in the same BN_ALIGN-aligned block as the header. */
+   ul_t l[];
 } bn_t;
 
+/*! Encodes (and decodes) the offset of a bignum that does not own its allocation. */
+#define _BN_SHARED(off) (-1 - (off))
+
+/*! Montgomery context, precomputed once per modulus N (R = 2**(BN_LIMB_BITS * n_limbs)). */
+typedef struct _bn_mon_ctxt_t
+{
+   /*! -N**-1 mod 2**BN_LIMB_BITS. */
+   ul_t mp;
+   /*! R**2 mod N, used to convert into Montgomery form. */
+   bn_t *rr;
+   /*! R mod N, i.e. 1 in Montgomery form. */
+   bn_t *one;
+   /*! 2R mod N, i.e. 2 in Montgomery form. */
+   bn_t *two;
+   /*! Plain 1, used to convert from Montgomery form. */
+   bn_t *unit;
+   /*! R'**2 mod N for the radix R' of the AVX-512 IFMA exponentiation, NULL if that isn't used for N. */
+   bn_t *rr52;
+} bn_mon_ctxt_t;
+
+/*! Barrett context, precomputed once per modulus N of k significant limbs (r = 2**BN_LIMB_BITS). */
+typedef struct _bn_barrett_ctxt_t
+{
+   /*! Copy of the k significant limbs of N. */
+   bn_t *n;
+   /*! k, the number of significant limbs of N. */
+   int k;
+   /*! floor(r**(2 * k) / N). */
+   bn_t *mu;
+} bn_barrett_ctxt_t;
+
+/*! Fixed-base exponentiation context (Lim-Lee comb) for a base G modulo N. */
+typedef struct _bn_comb_ctxt_t
+{
+   /*! Copy of the modulus. */
+   bn_t *n;
+   /*! Copy of G, for exponents past bits. */
+   bn_t *g;
+   /*! Largest exponent size in bits, h * a. */
+   int bits;
+   /*! Teeth h, tables v, squarings per exponentiation b, and tooth spacing a = v * b. */
+   int h, v, b, a;
+   /*! v tables of 2**h - 1 Montgomery form entries of n_limbs limbs each. */
+   ul_t *tbl;
+} bn_comb_ctxt_t;
+
+/*! Array of structures: the limbs of each element side by side. */
+#define BN_VEC_AOS 0
+/*! Structure of arrays: limb j of every element side by side, for SIMD across elements. */
+#define BN_VEC_SOA 1
+
+/*! Vector of same-size residues, all limbs in one block. */
+typedef struct _bn_vec_t
+{
+   /*! Number of elements. */
+   int cnt;
+   /*! Limbs per element. */
+   int nl;
+   /*! BN_VEC_AOS or BN_VEC_SOA. */
+   int layout;
+   /*! Limb j of element i is l[i * nl + j] (AoS) or l[j * cnt + i] (SoA), BN_ALIGN-aligned. */
+   ul_t *l;
+} bn_vec_t;
+
 /*!
 * \brief Returns the position of the highest-placed non-zero bit.
 */
@@ -159,10 +236,38 @@ bn_t *bn_alloc(int size);
 */
 bn_t *bn_alloc_limbs(int size);
 
+/*!
+* \brief Allocate head bytes followed by cnt bignums of chosen size (in bytes), all in
+*        one block, and put pointers to the bignums in D. The bignums are BN_ALIGN-aligned
+*        and contiguous. bn_free only releases their contexts: the block is freed as a
+*        whole, with mem_free on the returned pointer.
+*/
+void *bn_alloc_block(size_t head, bn_t **d, int cnt, int size);
+
+/*!
+* \brief Allocate cnt bignums of chosen size (in bytes) in one block, pointers in D.
+*/
+bn_t **bn_alloc_n(bn_t **d, int cnt, int size);
+
+/*!
+* \brief Free bignums from bn_alloc_n.
+*/
+void bn_free_n(bn_t **d, int cnt);
+
 /*!
 * \brief Copy the bignum.
 */bn_t *bn_copy(bn_t *a, bn_t *b);
 
+/*!
+* \brief Copy the low nl limbs of the bignum into L, zero-padded.
+*/
+ul_t *bn_to_limbs(ul_t *l, bn_t *a, int nl);
+
+/*!
+* \brief Set the bignum from nl limbs (truncated like bn_copy).
+*/
+bn_t *bn_from_limbs(bn_t *a, const ul_t *l, int nl);
+
 /*!
 * \brief Free the bignum.
 */
@@ -210,6 +315,8 @@ int bn_is_zero(bn_t *a);
 
 /*!
 * \brief a = a % n
+*        Values below 2n take at most one subtraction, anything wider goes through
+*        the Barrett context cached in n.
 */
 bn_t *bn_reduce(bn_t *a, bn_t *n);
 
@@ -256,7 +363,9 @@ bn_t *bn_write(FILE *fp, bn_t *num);
 #endif
 
 /*!
-* \brief Textbook multiplication of two bignums.
+* \brief Multiplication of two bignums. Depending on the operand size it uses
+*        textbook, Karatsuba, Toom-3 or NTT multiplication (the thresholds
+*        are set in config.h).
 */
 bn_t *bn_mul(bn_t *d, bn_t *a, bn_t *b);
 
@@ -281,6 +390,52 @@ bn_t *bn_rand(bn_t *a);
 */
 bn_t *bn_rand_range(bn_t *a, int x, bn_t *b, int y);
 
+/*!
+* \brief Allocate a Montgomery context for modulus n.
+*/
+bn_mon_ctxt_t *bn_mon_ctxt_alloc(bn_t *n);
+
+/*!
+* \brief Free a Montgomery context.
+*/
+void bn_mon_ctxt_free(bn_mon_ctxt_t *ctxt);
+
+/*!
+* \brief Return the Montgomery context cached in n, building it on first use.
+*        Any number of threads may call this on the same n: the first context is
+*        published once and kept, so n must not change value while it has one
+*        (see bn_ctxt_invalidate).
+*/
+bn_mon_ctxt_t *bn_mon_ctxt(bn_t *n);
+
+/*!
+* \brief Free the contexts cached in n, before it gets another value. No other
+*        thread may use n meanwhile.
+*/
+void bn_ctxt_invalidate(bn_t *n);
+
+/*!
+* \brief Allocate a Barrett context for modulus n.
+*/
+bn_barrett_ctxt_t *bn_barrett_ctxt_alloc(bn_t *n);
+
+/*!
+* \brief Free a Barrett context.
+*/
+void bn_barrett_ctxt_free(bn_barrett_ctxt_t *ctxt);
+
+/*!
+* \brief Return the Barrett context cached in n, building it on first use.
+*        Published like the Montgomery context, see bn_mon_ctxt.
+*/
+bn_barrett_ctxt_t *bn_barrett_ctxt(bn_t *n);
+
+/*!
+* \brief a = a % n, using two multiplications for any a below r**(2 * k).
+*        Wider values fall back to bn_reduce_slow.
+*/
+bn_t *bn_barrett_reduce(bn_t *a, bn_barrett_ctxt_t *ctxt);
+
 /*!
 * \brief Convert to Montgomery form.
 */
@@ -292,10 +447,40 @@ bn_t *bn_to_mon(bn_t *a, bn_t *n);
 bn_t *bn_from_mon(bn_t *a, bn_t *n);
 
 /*!
-* \brief D = A * B % N
+* \brief D = A * B % N. From BN_MON_KARATSUBA_THRESHOLD limbs on, every call
+*        allocates the multiplication scratch; bn_mon_mul_ws does not.
 */
 bn_t *bn_mon_mul(bn_t *d, bn_t *a, bn_t *b, bn_t *n);
 
+/*! Scratch space (in limbs) the multiplication tiers need for nl limb operands. A Karatsuba
+    level takes 6 * ceil(nl / 2) + 1 limbs, a Toom-3 level about 6 * nl + 34, and both hand the
+    rest down to the next level. */
+#define _BN_MUL_WS_LIMBS(nl) (9 * (nl) + 2048)
+
+/*! Of which a Montgomery product needs none below BN_MON_KARATSUBA_THRESHOLD limbs. */
+#define _BN_MON_MUL_WS_LIMBS(nl) ((nl) >= BN_MON_KARATSUBA_THRESHOLD ? _BN_MUL_WS_LIMBS(nl) : 0)
+
+/*! Workspace size (in limbs) bn_mon_mul_ws and bn_mon_sqr_ws need for a modulus of nl limbs. */
+#define BN_MON_WS_LIMBS(nl) (4 * (nl) + 2 + _BN_MON_MUL_WS_LIMBS(nl))
+
+/*!
+* \brief D = A * B % N, using the caller-provided workspace ws of
+*        BN_MON_WS_LIMBS(n->n_limbs) limbs instead of the stack.
+*/
+bn_t *bn_mon_mul_ws(bn_t *d, bn_t *a, bn_t *b, bn_t *n, ul_t *ws);
+
+/*!
+* \brief D = A * A % N, computing each cross product only once. Allocates like
+*        bn_mon_mul.
+*/
+bn_t *bn_mon_sqr(bn_t *d, bn_t *a, bn_t *n);
+
+/*!
+* \brief D = A * A % N, using the caller-provided workspace ws of
+*        BN_MON_WS_LIMBS(n->n_limbs) limbs instead of the stack.
+*/
+bn_t *bn_mon_sqr_ws(bn_t *d, bn_t *a, bn_t *n, ul_t *ws);
+
 /*!
 * \brief A = A % N
 */
@@ -307,21 +492,129 @@ bn_t *bn_mon_reduce(bn_t *a, bn_t *n);
 bn_t *bn_mon_pow(bn_t *d, bn_t *a, bn_t *e, bn_t *n);
 
 /*!
-* \brief D = A**-1 % N
+* \brief D = A[0]**E[0] * ... * A[k - 1]**E[k - 1] % N, in Montgomery form.
+*        All the powers share one chain of squarings, with interleaved sliding
+*        windows (Straus) for few bases and buckets (Pippenger) for many.
+*/
+bn_t *bn_mon_pow_multi(bn_t *d, bn_t **a, bn_t **e, int k, bn_t *n);
+
+/*! Workspace size (in limbs) bn_mon_pow_ws needs for a modulus of nl limbs. */
+#define BN_MON_POW_WS_LIMBS(nl) (2 * (2 * (nl) + 2) + 33 * (nl) + _BN_MON_MUL_WS_LIMBS(nl))
+
+/*!
+* \brief D = A**E % N, running entirely in the caller-provided workspace ws
+*        of BN_MON_POW_WS_LIMBS(n->n_limbs) limbs (no allocations).
+*/
+bn_t *bn_mon_pow_ws(bn_t *d, bn_t *a, bn_t *e, bn_t *n, ul_t *ws);
+
+/*!
+* \brief D = A**-1 % N, with A and D in Montgomery form.
+*        Constant time for a given N, which must be odd (but need not be prime).
 */
 bn_t *bn_mon_inv(bn_t *d, bn_t *a, bn_t *n);
 
 /*!
-* \brief D = A**-1 % N
+* \brief OUT[i] = IN[i]**-1 % N for i < cnt, in Montgomery form, using one inversion and
+*        3 * (cnt - 1) multiplications. Zero inputs give zero outputs without disturbing the
+*        rest. OUT[i] may be IN[i].
+*/
+void bn_mon_inv_batch(bn_t **out, bn_t **in, int cnt, bn_t *n);
+
+/*!
+* \brief D = A**-1 % N, for any modulus N (prime or not).
+*        D is set to 0 when gcd(A, N) != 1. A is left untouched.
 */
 bn_t *bn_inv(bn_t *d, bn_t *a, bn_t *n);
 
 /*!
 * \brief This is a helper function which does *NOT* take Montgomery form
-*        numbers. It will make conversions internally.
+*        numbers. It will make conversions internally. The window size
+*        follows B, so short exponents (e.g., RSA's 65537) skip the table.
 *
 *        D = A**B % N
 */
 bn_t *bn_pow_mod(bn_t *d, bn_t *a, bn_t *b, bn_t *n);
 
+/*!
+* \brief D[i] = A[i]**E[i] % N[i], for cnt independent exponentiations (plain
+*        numbers, like bn_pow_mod). On CPUs with AVX-512 IFMA, moduli of the
+*        same size run 8 at a time, one in each vector lane. Everything else
+*        falls back to bn_pow_mod.
+*/
+void bn_pow_mod_batch(bn_t **d, bn_t **a, bn_t **e, bn_t **n, int cnt);
+
+/*!
+* \brief Allocate a fixed-base comb for G modulo N and exponents of up to bits bits.
+*        The shape of the comb is chosen for the fewest products within
+*        BN_COMB_TABLE_BYTES of tables; with enough room no squarings are left.
+*/
+bn_comb_ctxt_t *bn_comb_ctxt_alloc(bn_t *g, bn_t *n, int bits);
+
+/*!
+* \brief Free a fixed-base comb.
+*/
+void bn_comb_ctxt_free(bn_comb_ctxt_t *ctxt);
+
+/*!
+* \brief D = G**E % N for the G and N of the comb (plain numbers, like bn_pow_mod).
+*        Only reads the comb, so any number of threads may share one.
+*/
+bn_t *bn_comb_pow_mod(bn_t *d, bn_t *e, bn_comb_ctxt_t *ctxt);
+
+/*!
+* \brief Allocate a vector of cnt zero elements of chosen size (in bytes), in the given
+*        layout (BN_VEC_AOS or BN_VEC_SOA).
+*/
+bn_vec_t *bn_vec_alloc(int cnt, int size, int layout);
+
+/*!
+* \brief Free the vector.
+*/
+void bn_vec_free(bn_vec_t *v);
+
+/*!
+* \brief Set element i of V to A (truncated like bn_copy).
+*/
+bn_vec_t *bn_vec_set(bn_vec_t *v, int i, bn_t *a);
+
+/*!
+* \brief D = element i of V.
+*/
+bn_t *bn_vec_get(bn_t *d, bn_vec_t *v, int i);
+
+/*!
+* \brief The element-wise operations below take vectors of the same length and layout,
+*        with elements of n->n_limbs limbs, and D may be A or B. Except for bn_vec_reduce,
+*        elements must be below N. The Montgomery ones use the radix of bn_mon_*, and N
+*        must be odd.
+*
+*        D = A + B % N
+*/
+bn_vec_t *bn_vec_add(bn_vec_t *d, bn_vec_t *a, bn_vec_t *b, bn_t *n);
+
+/*!
+* \brief D = A - B % N
+*/
+bn_vec_t *bn_vec_sub(bn_vec_t *d, bn_vec_t *a, bn_vec_t *b, bn_t *n);
+
+/*!
+* \brief D = A * B / R % N
+*/
+bn_vec_t *bn_vec_mon_mul(bn_vec_t *d, bn_vec_t *a, bn_vec_t *b, bn_t *n);
+
+/*!
+* \brief D = A * R % N
+*/
+bn_vec_t *bn_vec_to_mon(bn_vec_t *d, bn_vec_t *a, bn_t *n);
+
+/*!
+* \brief D = A / R % N
+*/
+bn_vec_t *bn_vec_from_mon(bn_vec_t *d, bn_vec_t *a, bn_t *n);
+
+/*!
+* \brief D = A % N, for elements of any value.
+*/
+bn_vec_t *bn_vec_reduce(bn_vec_t *d, bn_vec_t *a, bn_t *n);
+
 #endif // _BN_H_
@@ -10,8 +10,80 @@
 /*! Include debug checks */
 //#define BN_ASSERT
 
+/*! Use hand-written assembly kernels where the CPU supports them (checked at load time) */
+#define BN_ASM
+
+/*! Modulus size (in limbs) from which exponentiation uses AVX-512 IFMA, if available */
+#if !defined(BN_IFMA_THRESHOLD)
+   #define BN_IFMA_THRESHOLD 32
+#endif
+
+/*! Operand size (in limbs) from which bn_mul switches to Karatsuba */
+#if !defined(BN_KARATSUBA_THRESHOLD)
+   #define BN_KARATSUBA_THRESHOLD 32
+#endif
+
+/*! Operand size (in limbs) from which multiplication switches to Toom-3 (at least 8) */
+#if !defined(BN_TOOM3_THRESHOLD)
+   #define BN_TOOM3_THRESHOLD 160
+#endif
+
+/*! Operand size (in limbs) from which multiplication switches to NTT */
+#if !defined(BN_NTT_THRESHOLD)
+   #define BN_NTT_THRESHOLD 16384
+#endif
+
+/*! Modulus size (in limbs) from which Montgomery products use Karatsuba */
+#if !defined(BN_MON_KARATSUBA_THRESHOLD)
+   #define BN_MON_KARATSUBA_THRESHOLD 48
+#endif
+
+/*! Table budget (in bytes) of a fixed-base comb */
+#if !defined(BN_COMB_TABLE_BYTES)
+   #define BN_COMB_TABLE_BYTES (1 << 20)
+#endif
+
+/*! Alignment (in bytes, a power of two from 16) of each bignum: a cache line */
+#if !defined(BN_ALIGN)
+   #define BN_ALIGN 64
+#endif
+
+/*! Route mem_alloc through the calling thread's arena scope (see arena.h) */
+#define BN_ARENA
+
+/*! Size (in bytes) of the first chunk of an arena */
+#if !defined(BN_ARENA_CHUNK_BYTES)
+   #define BN_ARENA_CHUNK_BYTES (64 << 10)
+#endif
+
+/*! Back heap allocations with thread-caching size-class pools (see pool.h) */
+#define BN_POOL
+
+/*! Largest block (in bytes) taken from the pools, bigger ones come from malloc */
+#if !defined(BN_POOL_MAX_BYTES)
+   #define BN_POOL_MAX_BYTES 2048
+#endif
+
+/*! Free blocks of a size class a thread keeps before handing half of them to the depot */
+#if !defined(BN_POOL_CACHE_BLOCKS)
+   #define BN_POOL_CACHE_BLOCKS 64
+#endif
+
 /*! Custom memory functions, e.g., for embedded code. */
-#define mem_alloc(x) malloc(x)
-#define mem_free(x) free(x)
+#if defined(BN_ARENA)
+   #define mem_alloc(x) arena_mem_alloc(x)
+   #define mem_realloc(x, y) arena_mem_realloc(x, y)
+   #define mem_free(x) arena_mem_free(x)
+#elif defined(BN_POOL)
+   #define mem_alloc(x) pool_alloc(x)
+   #define mem_realloc(x, y) pool_realloc(x, y)
+   #define mem_free(x) pool_free(x)
+#else
+   #include <stdlib.h>
+
+   #define mem_alloc(x) malloc(x)
+   #define mem_realloc(x, y) realloc(x, y)
+   #define mem_free(x) free(x)
+#endif
 
 #endif // _CONFIG_H_
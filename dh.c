@@ -11,9 +11,9 @@
 
 #include "dh.h"
 
-dh_ctxt_t *dh_init(bn_t *p, bn_t *g)
+dh_params_t *dh_params_init(bn_t *p, bn_t *g)
 {
-	dh_ctxt_t *res;
+	dh_params_t *res;
 	bn_t *t;
 
 	if (p == NULL || g == NULL)
@@ -21,7 +21,7 @@ dh_ctxt_t *dh_init(bn_t *p, bn_t *g)
 
 	assert(p->n == g->n);
 
-	if ((res = (dh_ctxt_t *)mem_alloc(sizeof(dh_ctxt_t))) == NULL)
+	if ((res = (dh_params_t *)mem_alloc(sizeof(dh_params_t))) == NULL)
 		return NULL;
 
 	res->g = g;
@@ -34,13 +34,8 @@ dh_ctxt_t *dh_init(bn_t *p, bn_t *g)
 	if (bn_cmp_ui(g, 2) < 0 || bn_cmp(g, t) > 0)
 		goto outerr;
 
-	// Generate c \in [1, p - 2].
-	res->c = bn_alloc(p->n);
-	bn_rand_range(res->c, 1, p, 2);
-
-	// C = g^c mod p
-	res->C = bn_alloc(p->n);
-	bn_pow_mod(res->C, res->g, res->c, p);
+	// The comb for C = g^c mod p, built once for every key exchange.
+	res->comb = bn_comb_ctxt_alloc(g, p, bn_maxbit(p) + 1);
 	goto outok;
 
 outerr:;
@@ -53,6 +48,39 @@ outok:;
 	return res;
 }
 
+void dh_params_free(dh_params_t *params)
+{
+	if (params == NULL)
+		return;
+
+	bn_comb_ctxt_free(params->comb);
+	mem_free(params);
+}
+
+dh_ctxt_t *dh_init(dh_params_t *params)
+{
+	dh_ctxt_t *res;
+
+	if (params == NULL)
+		return NULL;
+
+	if ((res = (dh_ctxt_t *)mem_alloc(sizeof(dh_ctxt_t))) == NULL)
+		return NULL;
+
+	res->g = params->g;
+	res->p = params->p;
+
+	// Generate c \in [1, p - 2].
+	res->c = bn_alloc(res->p->n);
+	bn_rand_range(res->c, 1, res->p, 2);
+
+	// C = g^c mod p, through the comb of the parameters.
+	res->C = bn_alloc(res->p->n);
+	bn_comb_pow_mod(res->C, res->c, params->comb);
+
+	return res;
+}
+
 void dh_free(dh_ctxt_t *ctxt)
 {
 	if (ctxt == NULL)
@@ -446,6 +446,16 @@ PKCS#3 DH Parameters: (16384 bit)
                  "\xb7\xc8\x30\x12\x57\x0b\xda\x01\x9b\x2e\x1c\x71\xb0\xfc\xbb\x7b\x5c\xe0\x31\xd8\xb0\x66\x92\xa1\xe6\xb7\x18\xb7\x2c\xaf\x45\xab"
 
 /*! Diffie-Hellman key exchange context. */
+typedef struct _dh_params
+{
+	/*! Prime p. */
+	bn_t *p;
+	/*! Primitive root modulo p \in [2, p - 2]. */
+	bn_t *g;
+	/*! Fixed-base comb for g modulo p, shared by every key exchange. */
+	bn_comb_ctxt_t *comb;
+} dh_params_t;
+
 typedef struct _dh_ctxt
 {
 	/*! Prime p. */
@@ -459,12 +469,25 @@ typedef struct _dh_ctxt
 } dh_ctxt_t;
 
 /*!
-* \brief Initialize Diffie-Hellman key exchange context.
+* \brief Initialize Diffie-Hellman parameters, building the comb for g.
 * \param p Prime p.
-* \param g Primitive root modulo p \in [2, p - 2] (not readonly).
+* \param g Primitive root modulo p \in [2, p - 2].
+* \return NULL on error.
+*/
+dh_params_t *dh_params_init(bn_t *p, bn_t *g);
+
+/*!
+* \brief Free parameters, after every context using them.
+*/
+void dh_params_free(dh_params_t *params);
+
+/*!
+* \brief Initialize Diffie-Hellman key exchange context. Any number of threads
+*        may do so with the same parameters.
+* \param params Parameters.
 * \return NULL on error.
 */
-dh_ctxt_t *dh_init(bn_t *p, bn_t *g);
+dh_ctxt_t *dh_init(dh_params_t *params);
 
 /*!
 * \brief Free context.
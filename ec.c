@@ -5,7 +5,11 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 #include "ec.h"
+#include "fe.h"
+#include "recode.h"
 
 static void _ec_add(bn_t *d, bn_t *a, bn_t *b, ec_group_t *ecg)
 {
@@ -24,7 +28,7 @@ static void _ec_mul(bn_t *d, bn_t *a, bn_t *b, ec_group_t *ecg)
 
 static void _ec_square(bn_t *d, bn_t *a, ec_group_t *ecg)
 {
-	_ec_mul(d, a, a, ecg);
+	bn_mon_sqr(d, a, ecg->p);
 }
 
 static void _ec_inv(bn_t *d, bn_t *a, ec_group_t *ecg)
@@ -35,12 +39,14 @@ static void _ec_inv(bn_t *d, bn_t *a, ec_group_t *ecg)
 ec_point_t *ec_point_alloc(uint32_t n)
 {
 	ec_point_t *res;
+	bn_t *c[2];
 
-	if ((res = (ec_point_t *)mem_alloc(sizeof(ec_point_t))) == NULL)
+	// The coordinates live in the same block, right after the point.
+	if ((res = (ec_point_t *)bn_alloc_block(sizeof(ec_point_t), c, 2, n)) == NULL)
 		return NULL;
 
-	res->x = bn_alloc(n);
-	res->y = bn_alloc(n);
+	res->x = c[0];
+	res->y = c[1];
 
 	return res;
 }
@@ -85,6 +91,15 @@ void ec_point_from_mon(ec_point_t *p, ec_group_t *ecg)
 	bn_from_mon(p->y, ecg->p);
 }
 
+ec_point_t *ec_point_neg(ec_point_t *r, ec_point_t *p, ec_group_t *ecg)
+{
+	// -(x, y) = (x, p - y), and the reduction keeps y = 0 (and zero) as is.
+	bn_copy(r->x, p->x);
+	bn_sub(r->y, ecg->p, p->y, ecg->p);
+
+	return r;
+}
+
 ec_point_t *ec_point_double(ec_point_t *r, ec_point_t *p, ec_group_t *ecg)
 {
 	// Handle trivial case.
@@ -173,21 +188,387 @@ ec_point_t *ec_point_add(ec_point_t *r, ec_point_t *p, ec_point_t *q, ec_group_t
 	return r;
 }
 
-ec_point_t *ec_point_mul(ec_point_t *d, bn_t *a, ec_point_t *b, ec_group_t *ecg)
+// Odd multiples b, 3b, ..., (2h - 1)b and their negatives, in affine coordinates.
+static void _ec_point_mul_table(ec_point_t **pos, ec_point_t **neg, ec_point_t *b, int h, ec_group_t *ecg)
+{
+	int j;
+
+	pos[0] = ec_point_copy(ec_point_alloc(b->x->n), b);
+	if (h > 1)
+	{
+		ec_point_t *b2 = ec_point_double(ec_point_alloc(b->x->n), b, ecg);
+		for (j = 1; j < h; j++)
+			pos[j] = ec_point_add(ec_point_alloc(b->x->n), pos[j - 1], b2, ecg);
+		ec_point_free(b2);
+	}
+	for (j = 0; j < h; j++)
+		neg[j] = ec_point_neg(ec_point_alloc(b->x->n), pos[j], ecg);
+}
+
+static void _ec_point_mul_table_free(ec_point_t **pos, ec_point_t **neg, int h)
+{
+	int j;
+
+	for (j = 0; j < h; j++)
+	{
+		ec_point_free(pos[j]);
+		ec_point_free(neg[j]);
+	}
+}
+
+#define EC_FE_TYPES(bits) \
+\
+typedef struct \
+{ \
+	fe##bits##_t x, y, z; \
+} _ec##bits##_jac_t; \
+\
+typedef struct \
+{ \
+	fe##bits##_t x, y; \
+	int inf; \
+} _ec##bits##_aff_t;
+
+EC_FE_TYPES(256)
+EC_FE_TYPES(384)
+EC_FE_TYPES(521)
+
+// Point multiplication on fe<bits>_t, for curves whose p has FE_LIMBS(bits) limbs.
+// d = a[0]b[0] + ... + a[k - 1]b[k - 1] runs over the same wNAF digits and tables as
+// ec_point_mul, but in Jacobian coordinates (x = X/Z^2, y = Y/Z^3, Z = 0 at infinity)
+// with one chain of doublings shared by all the products. Only the result is inverted.
+// The field multiplications are fe<bits>_<red>_mul and _sqr; for a plain back end
+// (one of the special-form reductions) the chain runs on plain residues, converted
+// from and to the Montgomery form of the bn_t at both ends.
+#define EC_FE_DEFINE(bits, red, plain) \
+\
+/* S = 4XY^2, M = 3X^2 + aZ^4, X' = M^2 - 2S, Y' = M(S - X') - 8Y^4, Z' = 2YZ. r may be p. */ \
+static void _ec##bits##_##red##_double(_ec##bits##_jac_t *r, const _ec##bits##_jac_t *p, const fe##bits##_t *a, const fe##bits##_mod_t *m) \
+{ \
+	fe##bits##_t xx, yy, s, t, u; \
+\
+	fe##bits##_##red##_sqr(&xx, &p->x, m); \
+	fe##bits##_##red##_sqr(&yy, &p->y, m); \
+	fe##bits##_##red##_sqr(&u, &p->z, m); \
+	fe##bits##_##red##_sqr(&u, &u, m); \
+	fe##bits##_##red##_mul(&u, &u, a, m); \
+	fe##bits##_##red##_mul(&s, &p->x, &yy, m); \
+	fe##bits##_add(&s, &s, &s, m); \
+	fe##bits##_add(&s, &s, &s, m); \
+	fe##bits##_add(&t, &xx, &xx, m); \
+	fe##bits##_add(&t, &t, &xx, m); \
+	fe##bits##_add(&t, &t, &u, m); \
+\
+	fe##bits##_##red##_mul(&r->z, &p->y, &p->z, m); \
+	fe##bits##_add(&r->z, &r->z, &r->z, m); \
+\
+	fe##bits##_##red##_sqr(&u, &t, m); \
+	fe##bits##_sub(&u, &u, &s, m); \
+	fe##bits##_sub(&r->x, &u, &s, m); \
+\
+	fe##bits##_##red##_sqr(&yy, &yy, m); \
+	fe##bits##_add(&yy, &yy, &yy, m); \
+	fe##bits##_add(&yy, &yy, &yy, m); \
+	fe##bits##_add(&yy, &yy, &yy, m); \
+	fe##bits##_sub(&u, &s, &r->x, m); \
+	fe##bits##_##red##_mul(&u, &t, &u, m); \
+	fe##bits##_sub(&r->y, &u, &yy, m); \
+} \
+\
+/* p + q for an affine q: H = qxZ^2 - X, S = qyZ^3 - Y, X' = S^2 - H^3 - 2XH^2, */ \
+/* Y' = S(XH^2 - X') - YH^3, Z' = ZH. r may be p. */ \
+static void _ec##bits##_##red##_add(_ec##bits##_jac_t *r, const _ec##bits##_jac_t *p, const _ec##bits##_aff_t *q, const fe##bits##_t *a, const fe##bits##_mod_t *m) \
+{ \
+	fe##bits##_t zz, h, s, hh, hhh, v; \
+\
+	if (fe##bits##_is_zero(&p->z)) \
+	{ \
+		r->x = q->x; \
+		r->y = q->y; \
+		r->z = m->one; \
+		return; \
+	} \
+\
+	fe##bits##_##red##_sqr(&zz, &p->z, m); \
+	fe##bits##_##red##_mul(&h, &q->x, &zz, m); \
+	fe##bits##_sub(&h, &h, &p->x, m); \
+	fe##bits##_##red##_mul(&zz, &zz, &p->z, m); \
+	fe##bits##_##red##_mul(&s, &q->y, &zz, m); \
+	fe##bits##_sub(&s, &s, &p->y, m); \
+\
+	/* Same x: either the same point or its negative. */ \
+	if (fe##bits##_is_zero(&h)) \
+	{ \
+		if (fe##bits##_is_zero(&s)) \
+			_ec##bits##_##red##_double(r, p, a, m); \
+		else \
+			memset(r, 0, sizeof(*r)); \
+		return; \
+	} \
+\
+	fe##bits##_##red##_sqr(&hh, &h, m); \
+	fe##bits##_##red##_mul(&hhh, &h, &hh, m); \
+	fe##bits##_##red##_mul(&v, &p->x, &hh, m); \
+	fe##bits##_##red##_mul(&zz, &p->y, &hhh, m); \
+	fe##bits##_##red##_mul(&r->z, &p->z, &h, m); \
+\
+	fe##bits##_##red##_sqr(&r->x, &s, m); \
+	fe##bits##_sub(&r->x, &r->x, &hhh, m); \
+	fe##bits##_sub(&r->x, &r->x, &v, m); \
+	fe##bits##_sub(&r->x, &r->x, &v, m); \
+\
+	fe##bits##_sub(&v, &v, &r->x, m); \
+	fe##bits##_##red##_mul(&v, &s, &v, m); \
+	fe##bits##_sub(&r->y, &v, &zz, m); \
+} \
+\
+static ec_point_t *_ec##bits##_##red##_mul(ec_point_t *d, bn_t **a, ec_point_t **b, int k, ec_group_t *ecg) \
+{ \
+	int i, j, x, w, h, top = 0, len = 0, set = 0; \
+\
+	for (x = 0; x < k; x++) \
+		top = MAX(top, bn_maxbit(a[x]) + 1); \
+	w = recode_wnaf_width(top); \
+	h = 1 << (w - 2); \
+\
+	fe##bits##_mod_t m; \
+	fe##bits##_t ca, zi, zz; \
+	_ec##bits##_jac_t r; \
+	_ec##bits##_aff_t tab[k][2 * h]; \
+	ec_point_t *pos[h], *neg[h]; \
+	s16 dig[k][top + 1]; \
+\
+	fe##bits##_mod_init(&m, ecg->p); \
+	fe##bits##_load(&ca, ecg->a); \
+	if (plain) \
+	{ \
+		memset(&m.one, 0, sizeof(m.one)); \
+		m.one.l[0] = 1; \
+		fe##bits##_from_mon(&ca, &ca, &m); \
+	} \
+\
+	/* Tables and digits first, d may be one of the b. */ \
+	memset(dig, 0, sizeof(dig)); \
+	for (x = 0; x < k; x++) \
+	{ \
+		_ec_point_mul_table(pos, neg, b[x], h, ecg); \
+		for (j = 0; j < h; j++) \
+		{ \
+			fe##bits##_load(&tab[x][j].x, pos[j]->x); \
+			fe##bits##_load(&tab[x][j].y, pos[j]->y); \
+			fe##bits##_load(&tab[x][h + j].x, neg[j]->x); \
+			fe##bits##_load(&tab[x][h + j].y, neg[j]->y); \
+			tab[x][j].inf = tab[x][h + j].inf = ec_point_is_zero(pos[j]); \
+		} \
+		_ec_point_mul_table_free(pos, neg, h); \
+		for (j = 0; plain && j < 2 * h; j++) \
+		{ \
+			fe##bits##_from_mon(&tab[x][j].x, &tab[x][j].x, &m); \
+			fe##bits##_from_mon(&tab[x][j].y, &tab[x][j].y, &m); \
+		} \
+		len = MAX(len, recode_wnaf(dig[x], a[x], w)); \
+	} \
+\
+	memset(&r, 0, sizeof(r)); \
+\
+	for (i = len - 1; i >= 0; i--) \
+	{ \
+		if (set) \
+			_ec##bits##_##red##_double(&r, &r, &ca, &m); \
+		for (x = 0; x < k; x++) \
+		{ \
+			_ec##bits##_aff_t *t = (dig[x][i] > 0) ? &tab[x][dig[x][i] >> 1] : &tab[x][h + (-dig[x][i] >> 1)]; \
+			if (!dig[x][i] || t->inf) \
+				continue; \
+			_ec##bits##_##red##_add(&r, &r, t, &ca, &m); \
+			set = 1; \
+		} \
+	} \
+\
+	if (fe##bits##_is_zero(&r.z)) \
+		return ec_point_zero(d); \
+\
+	/* Back to affine: x = X/Z^2, y = Y/Z^3. */ \
+	if (plain) \
+		fe##bits##_to_mon(&r.z, &r.z, &m); \
+	bn_t *z = fe##bits##_store(bn_alloc(ecg->p->n), &r.z), *t = bn_alloc(ecg->p->n); \
+	fe##bits##_load(&zi, bn_mon_inv(t, z, ecg->p)); \
+	bn_free(t); \
+	bn_free(z); \
+	if (plain) \
+		fe##bits##_from_mon(&zi, &zi, &m); \
+\
+	fe##bits##_##red##_sqr(&zz, &zi, &m); \
+	fe##bits##_##red##_mul(&r.x, &r.x, &zz, &m); \
+	fe##bits##_##red##_mul(&zz, &zz, &zi, &m); \
+	fe##bits##_##red##_mul(&r.y, &r.y, &zz, &m); \
+	if (plain) \
+	{ \
+		fe##bits##_to_mon(&r.x, &r.x, &m); \
+		fe##bits##_to_mon(&r.y, &r.y, &m); \
+	} \
+	fe##bits##_store(d->x, &r.x); \
+	fe##bits##_store(d->y, &r.y); \
+\
+	return d; \
+}
+
+EC_FE_DEFINE(256, mon, 0)
+EC_FE_DEFINE(384, mon, 0)
+EC_FE_DEFINE(521, mon, 0)
+EC_FE_DEFINE(256, p256, 1)
+EC_FE_DEFINE(256, k256, 1)
+EC_FE_DEFINE(256, 25519, 1)
+EC_FE_DEFINE(384, p384, 1)
+EC_FE_DEFINE(521, p521, 1)
+
+// The special primes, in 32-bit words from the least significant one, and whether detection
+// picks their back end. With 64-bit limbs the P-384 word sums win the product (161 vs 203 ns)
+// but lose the square (184 vs 175 ns), and a point multiplication takes 1.37 ms against 1.18 ms
+// with Montgomery; P-256 loses both. So these two are only picked for smaller limbs, where
+// they win (P-384 point multiplication 1.65 vs 2.08 ms with 32-bit limbs).
+static const struct
+{
+	int red, bits, detect;
+	u32 p[17];
+} _ec_red_primes[] =
+{
+	{ EC_RED_P256, 256, BN_LIMB_BITS <= 32, { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0, 1, 0xFFFFFFFF } },
+	{ EC_RED_P384, 384, BN_LIMB_BITS <= 32, { 0xFFFFFFFF, 0, 0, 0xFFFFFFFF, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+	                                          0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF } },
+	{ EC_RED_K256, 256, 1, { 0xFFFFFC2F, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF } },
+	{ EC_RED_25519, 256, 1, { 0xFFFFFFED, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x7FFFFFFF } },
+	{ EC_RED_P521, 521, 1, { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+	                         0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x1FF } },
+};
+
+#define EC_RED_PRIMES (int)(sizeof(_ec_red_primes) / sizeof(_ec_red_primes[0]))
+
+// Is p the prime of the special back end red, in exactly the limbs of its fixed width?
+static int _ec_red_match(int red, bn_t *p)
+{
+	ul_t l[FE_LIMBS(521)];
+	int i, nl;
+
+	for (i = 0; i < EC_RED_PRIMES; i++)
+	{
+		if (_ec_red_primes[i].red != red)
+			continue;
+		if (p->n_limbs != (nl = FE_LIMBS(_ec_red_primes[i].bits)))
+			return 0;
+		_fe_set_words(l, nl, _ec_red_primes[i].p, 17);
+		return !memcmp(l, p->l, nl * sizeof(ul_t));
+	}
+
+	return 0;
+}
+
+int ec_group_red(bn_t *p)
 {
 	int i;
-	ec_point_t *bt = ec_point_copy(ec_point_alloc(b->x->n), b);
+
+	for (i = 0; i < EC_RED_PRIMES; i++)
+	{
+		if (_ec_red_primes[i].detect && _ec_red_match(_ec_red_primes[i].red, p))
+			return _ec_red_primes[i].red;
+	}
+
+	return EC_RED_MON;
+}
+
+void ec_group_setup(ec_group_t *ecg)
+{
+	// EC_RED_AUTO, an unknown value, or a special back end that is not for p: detect it
+	// from p. Only Montgomery works for any p.
+	if (ecg->red != EC_RED_MON && !_ec_red_match(ecg->red, ecg->p))
+		ecg->red = ec_group_red(ecg->p);
+
+	// Build the Montgomery context of p now too, rather than in the first multiplication
+	bn_mon_ctxt(ecg->p);
+}
+
+// Sum of k products on the fixed-width elements matching the size of p, with the
+// group's field reduction. NULL if there are none.
+static ec_point_t *_ec_point_mul_fe(ec_point_t *d, bn_t **a, ec_point_t **b, int k, ec_group_t *ecg)
+{
+	// Settled by ec_group_setup, a group without it multiplies with Montgomery
+	assert(ecg->red == EC_RED_MON || ecg->red == EC_RED_AUTO || _ec_red_match(ecg->red, ecg->p));
+
+	switch (ecg->red)
+	{
+	case EC_RED_P256:
+		return _ec256_p256_mul(d, a, b, k, ecg);
+	case EC_RED_K256:
+		return _ec256_k256_mul(d, a, b, k, ecg);
+	case EC_RED_25519:
+		return _ec256_25519_mul(d, a, b, k, ecg);
+	case EC_RED_P384:
+		return _ec384_p384_mul(d, a, b, k, ecg);
+	case EC_RED_P521:
+		return _ec521_p521_mul(d, a, b, k, ecg);
+	}
+
+	switch (ecg->p->n_limbs)
+	{
+	case FE_LIMBS(256):
+		return _ec256_mon_mul(d, a, b, k, ecg);
+	case FE_LIMBS(384):
+		return _ec384_mon_mul(d, a, b, k, ecg);
+	case FE_LIMBS(521):
+		return _ec521_mon_mul(d, a, b, k, ecg);
+	}
+
+	return NULL;
+}
+
+ec_point_t *ec_point_mul(ec_point_t *d, bn_t *a, ec_point_t *b, ec_group_t *ecg)
+{
+	if (_ec_point_mul_fe(d, &a, &b, 1, ecg))
+		return d;
+
+	int i, w = recode_wnaf_width(bn_maxbit(a) + 1), h = 1 << (w - 2), set = 0;
+	ec_point_t *pos[h], *neg[h];
+	s16 dig[RECODE_DIGITS(a)];
+
+	// Odd multiples of b before d is touched, it may be b.
+	_ec_point_mul_table(pos, neg, b, h, ecg);
 
 	ec_point_zero(d);
 
-	for (i = 0; i <= bn_maxbit(a); i++)
+	// Left to right over the wNAF digits of a, one addition per non-zero digit.
+	for (i = recode_wnaf(dig, a, w) - 1; i >= 0; i--)
 	{
-		if (bn_getbit(a, i))
-			ec_point_add(d, d, bt, ecg);
-		ec_point_double(bt, bt, ecg);
+		if (set)
+			ec_point_double(d, d, ecg);
+		if (dig[i])
+		{
+			ec_point_t *t = (dig[i] > 0) ? pos[dig[i] >> 1] : neg[-dig[i] >> 1];
+			if (set)
+				ec_point_add(d, d, t, ecg);
+			else
+				ec_point_copy(d, t);
+			set = 1;
+		}
 	}
 
-	ec_point_free(bt);
+	_ec_point_mul_table_free(pos, neg, h);
+
+	return d;
+}
+
+ec_point_t *ec_point_mul2(ec_point_t *d, bn_t *a, ec_point_t *p, bn_t *b, ec_point_t *q, ec_group_t *ecg)
+{
+	bn_t *s[2] = { a, b };
+	ec_point_t *t[2] = { p, q }, *u;
+
+	if (_ec_point_mul_fe(d, s, t, 2, ecg))
+		return d;
+
+	// b * q first, d may be q.
+	u = ec_point_mul(ec_point_alloc(q->x->n), b, q, ecg);
+	ec_point_mul(d, a, p, ecg);
+	ec_point_add(d, d, u, ecg);
+	ec_point_free(u);
 
 	return d;
 }
@@ -18,6 +18,15 @@ typedef struct _ec_point
 	bn_t *y;
 } ec_point_t;
 
+/*! Field reduction back ends: detected from p, Montgomery (any p), and the special primes. */
+#define EC_RED_AUTO 0
+#define EC_RED_MON 1
+#define EC_RED_P256 2
+#define EC_RED_P384 3
+#define EC_RED_P521 4
+#define EC_RED_K256 5
+#define EC_RED_25519 6
+
 /*! Elliptic curve group parameters (defining equation: y^2 = x^3 + ax + b). */
 typedef struct _ec_group
 {
@@ -27,8 +36,23 @@ typedef struct _ec_group
 	bn_t *a;
 	/*! Parameter b. (mon!) */
 	bn_t *b;
+	/*! Field reduction (EC_RED_*), settled by ec_group_setup. */
+	int red;
 } ec_group_t;
 
+/*!
+* \brief Find the fastest field reduction for a modulus (EC_RED_MON if it has no special form).
+*/
+int ec_group_red(bn_t *p);
+
+/*!
+* \brief Settle the group for point multiplication, once p, a, b and red are set and
+*        before it is shared: red is kept if it works for p and replaced by
+*        ec_group_red(p) if not (EC_RED_AUTO, or a back end for another prime).
+*        Point multiplication only reads the group afterwards.
+*/
+void ec_group_setup(ec_group_t *ecg);
+
 /*!
 * \brief Allocate point.
 */
@@ -64,6 +88,11 @@ void ec_point_to_mon(ec_point_t *p, ec_group_t *ecg);
 */
 void ec_point_from_mon(ec_point_t *p, ec_group_t *ecg);
 
+/*!
+* \brief Negate point.
+*/
+ec_point_t *ec_point_neg(ec_point_t *r, ec_point_t *p, ec_group_t *ecg);
+
 /*!
 * \brief Double point.
 */
@@ -75,9 +104,14 @@ ec_point_t *ec_point_double(ec_point_t *r, ec_point_t *p, ec_group_t *ecg);
 ec_point_t *ec_point_add(ec_point_t *r, ec_point_t *p, ec_point_t *q, ec_group_t *ecg);
 
 /*!
-* \brief Multiply point with bignum (d = a * b).
+* \brief Multiply point with bignum (d = a * b), using the wNAF of a.
 */
 ec_point_t *ec_point_mul(ec_point_t *d, bn_t *a, ec_point_t *b, ec_group_t *ecg);
 
+/*!
+* \brief Multiply two points with bignums and add them (d = a * p + b * q).
+*/
+ec_point_t *ec_point_mul2(ec_point_t *d, bn_t *a, ec_point_t *p, bn_t *b, ec_point_t *q, ec_group_t *ecg);
+
 #endif // _EC_H_
 
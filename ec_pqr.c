@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include "ec_pqr.h"
+#include "recode.h"
 
 static void _ec_pqr_add(poly_t *d, poly_t *a, poly_t *b, ec_pqr_group_t *ecg)
 {
@@ -196,19 +197,45 @@ ec_pqr_point_t *ec_pqr_point_add(ec_pqr_point_t *r, ec_pqr_point_t *p, ec_pqr_po
 
 ec_pqr_point_t *ec_pqr_point_mul(ec_pqr_point_t *d, bn_t *a, ec_pqr_point_t *b, ec_pqr_group_t *ecg)
 {
-	int i;
-	ec_pqr_point_t *bt = ec_pqr_point_copy(ec_pqr_point_alloc(ecg), b);
+	int i, j, w = recode_wnaf_width(bn_maxbit(a) + 1), h = 1 << (w - 2), set = 0;
+	ec_pqr_point_t *pos[h], *neg[h];
+	s16 dig[RECODE_DIGITS(a)];
+
+	// Odd multiples b, 3b, ..., (2h - 1)b and their negatives (before d is touched, it may be b).
+	pos[0] = ec_pqr_point_copy(ec_pqr_point_alloc(ecg), b);
+	if (h > 1)
+	{
+		ec_pqr_point_t *b2 = ec_pqr_point_double(ec_pqr_point_alloc(ecg), b, ecg);
+		for (j = 1; j < h; j++)
+			pos[j] = ec_pqr_point_add(ec_pqr_point_alloc(ecg), pos[j - 1], b2, ecg);
+		ec_pqr_point_free(b2);
+	}
+	for (j = 0; j < h; j++)
+		neg[j] = ec_pqr_point_neg(ec_pqr_point_alloc(ecg), pos[j], ecg);
 
 	ec_pqr_point_zero(d);
 
-	for (i = 0; i <= bn_maxbit(a); i++)
+	// Left to right over the wNAF digits of a, one addition per non-zero digit.
+	for (i = recode_wnaf(dig, a, w) - 1; i >= 0; i--)
 	{
-		if (bn_getbit(a, i))
-			ec_pqr_point_add(d, d, bt, ecg);
-		ec_pqr_point_double(bt, bt, ecg);
+		if (set)
+			ec_pqr_point_double(d, d, ecg);
+		if (dig[i])
+		{
+			ec_pqr_point_t *t = (dig[i] > 0) ? pos[dig[i] >> 1] : neg[-dig[i] >> 1];
+			if (set)
+				ec_pqr_point_add(d, d, t, ecg);
+			else
+				ec_pqr_point_copy(d, t);
+			set = 1;
+		}
 	}
 
-	ec_pqr_point_free(bt);
+	for (j = 0; j < h; j++)
+	{
+		ec_pqr_point_free(pos[j]);
+		ec_pqr_point_free(neg[j]);
+	}
 
 	return d;
 }
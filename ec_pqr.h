@@ -88,7 +88,7 @@ ec_pqr_point_t *ec_pqr_point_double(ec_pqr_point_t *r, ec_pqr_point_t *p, ec_pqr
 ec_pqr_point_t *ec_pqr_point_add(ec_pqr_point_t *r, ec_pqr_point_t *p, ec_pqr_point_t *q, ec_pqr_group_t *ecg);
 
 /*!
-* \brief Multiply point with bignum (d = a * b).
+* \brief Multiply point with bignum (d = a * b), using the wNAF of a.
 */
 ec_pqr_point_t *ec_pqr_point_mul(ec_pqr_point_t *d, bn_t *a, ec_pqr_point_t *b, ec_pqr_group_t *ecg);
 
@@ -10,6 +10,10 @@
 
 void ecdsa_sign(ecdsa_ctxt_t *ctxt, ecdsa_sig_t *sig, bn_t *H)
 {
+	// All temporaries come from the scratch arena, SIG is the only output.
+	arena_scope_t s;
+	arena_push(&s, arena_scratch());
+
 	bn_t *e = bn_alloc(ctxt->N->n),
 		*kk = bn_alloc(ctxt->N->n),
 		*m = bn_alloc(ctxt->N->n),
@@ -46,18 +50,22 @@ void ecdsa_sign(ecdsa_ctxt_t *ctxt, ecdsa_sig_t *sig, bn_t *H)
 	bn_free(m);
 	bn_free(kk);
 	bn_free(e);
+
+	arena_pop(&s);
 }
 
 int ecdsa_verify(ecdsa_ctxt_t *ctxt, ecdsa_sig_t *sig, bn_t *H)
 {
+	arena_scope_t s;
+	arena_push(&s, arena_scratch());
+
 	int res = 0;
 	bn_t *Sinv = bn_alloc(ctxt->N->n),
 		*e = bn_alloc(ctxt->N->n),
 		*w1 = bn_alloc(ctxt->N->n),
 		*w2 = bn_alloc(ctxt->N->n),
 		*rr = bn_alloc(ctxt->N->n);
-	ec_point_t *r1 = ec_point_alloc(ctxt->ecg->p->n),
-		*r2 = ec_point_alloc(ctxt->ecg->p->n);
+	ec_point_t *r1 = ec_point_alloc(ctxt->ecg->p->n);
 
 	bn_reduce(bn_copy(e, H), ctxt->N);
 	bn_to_mon(sig->R, ctxt->N);
@@ -72,10 +80,8 @@ int ecdsa_verify(ecdsa_ctxt_t *ctxt, ecdsa_sig_t *sig, bn_t *H)
 	bn_from_mon(w1, ctxt->N);
 	bn_from_mon(w2, ctxt->N);
 
-	ec_point_mul(r1, w1, ctxt->G, ctxt->ecg);
-	ec_point_mul(r2, w2, ctxt->Q, ctxt->ecg);
-
-	ec_point_add(r1, r1, r2, ctxt->ecg);
+	// r1 = w1*G + w2*Q, sharing the doublings.
+	ec_point_mul2(r1, w1, ctxt->G, w2, ctxt->Q, ctxt->ecg);
 
 	ec_point_from_mon(r1, ctxt->ecg);
 
@@ -88,7 +94,6 @@ int ecdsa_verify(ecdsa_ctxt_t *ctxt, ecdsa_sig_t *sig, bn_t *H)
 	res = (bn_cmp(rr, sig->R) == BN_CMP_E);
 
 	//Free temporaries.
-	ec_point_free(r2);
 	ec_point_free(r1);
 	bn_free(rr);
 	bn_free(w2);
@@ -96,6 +101,8 @@ int ecdsa_verify(ecdsa_ctxt_t *ctxt, ecdsa_sig_t *sig, bn_t *H)
 	bn_free(e);
 	bn_free(Sinv);
 
+	arena_pop(&s);
+
 	return res;
 }
 
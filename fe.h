@@ -0,0 +1,639 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#ifndef _FE_H_
+#define _FE_H_
+
+#include "bn.h"
+
+/*!
+* Fixed-width field elements. FE_DEFINE(bits) generates fe<bits>_t, FE_LIMBS(bits)
+* limbs held inline, and Montgomery arithmetic on it with the limb count known at
+* compile time: no allocation, no pointer to the limbs, and every loop unrolled.
+* Results are fully reduced and in the same Montgomery form as bn_mon_* for a
+* modulus of FE_LIMBS(bits) limbs, so values move to and from bn_t unchanged.
+*/
+
+/*! Limbs of a fixed-width element of the given bits. */
+#define FE_LIMBS(bits) (((bits) + BN_LIMB_BITS - 1) / BN_LIMB_BITS)
+
+#if defined(__GNUC__)
+   #define FE_UNROLL _Pragma("GCC unroll 32")
+#else
+   #define FE_UNROLL
+#endif
+
+#define FE_DEFINE(bits)                                                                      \
+                                                                                             \
+/*! Element, FE_LIMBS(bits) limbs, least significant first. */                               \
+typedef struct                                                                               \
+{                                                                                            \
+   ul_t l[FE_LIMBS(bits)];                                                                   \
+} fe##bits##_t;                                                                              \
+                                                                                             \
+/*! Modulus P, with -P**-1 mod 2**BN_LIMB_BITS, R mod P (1 in Montgomery form) and R**2. */  \
+typedef struct                                                                               \
+{                                                                                            \
+   fe##bits##_t p, one, rr;                                                                  \
+   ul_t mp;                                                                                  \
+} fe##bits##_mod_t;                                                                          \
+                                                                                             \
+static inline void fe##bits##_load(fe##bits##_t *d, bn_t *a)                                 \
+{                                                                                            \
+   bn_to_limbs(d->l, a, FE_LIMBS(bits));                                                     \
+}                                                                                            \
+                                                                                             \
+static inline bn_t *fe##bits##_store(bn_t *d, const fe##bits##_t *a)                         \
+{                                                                                            \
+   return bn_from_limbs(d, a->l, FE_LIMBS(bits));                                            \
+}                                                                                            \
+                                                                                             \
+/* P must have exactly FE_LIMBS(bits) limbs, for R to be the one bn_mon_* use. */            \
+static inline void fe##bits##_mod_init(fe##bits##_mod_t *m, bn_t *p)                         \
+{                                                                                            \
+   bn_mon_ctxt_t *ctxt = bn_mon_ctxt(p);                                                     \
+                                                                                             \
+   fe##bits##_load(&m->p, p);                                                                \
+   fe##bits##_load(&m->one, ctxt->one);                                                      \
+   fe##bits##_load(&m->rr, ctxt->rr);                                                        \
+   m->mp = ctxt->mp;                                                                         \
+}                                                                                            \
+                                                                                             \
+static inline int fe##bits##_is_zero(const fe##bits##_t *a)                                  \
+{                                                                                            \
+   ul_t x = 0;                                                                               \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+      x |= a->l[i];                                                                          \
+                                                                                             \
+   return x == 0;                                                                            \
+}                                                                                            \
+                                                                                             \
+/* D = T - P if T (with carry limb c) is at least P, else T. T < 2P. */                      \
+static inline void _fe##bits##_reduce(fe##bits##_t *d, const ul_t *t, ul_t c,                \
+                                      const fe##bits##_mod_t *m)                             \
+{                                                                                            \
+   ul_t r[FE_LIMBS(bits)], k;                                                                \
+   ull_t B = 0;                                                                              \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      B = (ull_t)t[i] - m->p.l[i] - B;                                                       \
+      r[i] = B;                                                                              \
+      B = (B >> BN_LIMB_BITS) & 1;                                                           \
+   }                                                                                         \
+                                                                                             \
+   /* Keep T only if the subtraction borrowed past the carry limb */                         \
+   k = (ul_t)0 - (ul_t)(B & ~c & 1);                                                         \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+      d->l[i] = (t[i] & k) | (r[i] & ~k);                                                    \
+}                                                                                            \
+                                                                                             \
+/* D = A + B mod P */                                                                        \
+static inline void fe##bits##_add(fe##bits##_t *d, const fe##bits##_t *a,                    \
+                                  const fe##bits##_t *b, const fe##bits##_mod_t *m)          \
+{                                                                                            \
+   ul_t t[FE_LIMBS(bits)];                                                                   \
+   ull_t C = 0;                                                                              \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      C += (ull_t)a->l[i] + b->l[i];                                                         \
+      t[i] = C;                                                                              \
+      C >>= BN_LIMB_BITS;                                                                    \
+   }                                                                                         \
+                                                                                             \
+   _fe##bits##_reduce(d, t, C, m);                                                           \
+}                                                                                            \
+                                                                                             \
+/* D = A - B mod P */                                                                        \
+static inline void fe##bits##_sub(fe##bits##_t *d, const fe##bits##_t *a,                    \
+                                  const fe##bits##_t *b, const fe##bits##_mod_t *m)          \
+{                                                                                            \
+   ul_t t[FE_LIMBS(bits)], k;                                                                \
+   ull_t B = 0, C = 0;                                                                       \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      B = (ull_t)a->l[i] - b->l[i] - B;                                                      \
+      t[i] = B;                                                                              \
+      B = (B >> BN_LIMB_BITS) & 1;                                                           \
+   }                                                                                         \
+                                                                                             \
+   /* Add P back on a borrow */                                                              \
+   k = (ul_t)0 - (ul_t)B;                                                                    \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      C += (ull_t)t[i] + (m->p.l[i] & k);                                                    \
+      d->l[i] = C;                                                                           \
+      C >>= BN_LIMB_BITS;                                                                    \
+   }                                                                                         \
+}                                                                                            \
+                                                                                             \
+/* D = A * B / R mod P, interleaved (CIOS). D may alias A or B. */                           \
+static inline void fe##bits##_mon_mul(fe##bits##_t *d, const fe##bits##_t *a,                \
+                                      const fe##bits##_t *b, const fe##bits##_mod_t *m)      \
+{                                                                                            \
+   ul_t t[FE_LIMBS(bits) + 2] = { 0 };                                                       \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      ull_t C = 0;                                                                           \
+                                                                                             \
+      FE_UNROLL                                                                              \
+      for(int j = 0; j < FE_LIMBS(bits); j++)                                                \
+      {                                                                                      \
+         C += (ull_t)a->l[j] * b->l[i] + t[j];                                               \
+         t[j] = C;                                                                           \
+         C >>= BN_LIMB_BITS;                                                                 \
+      }                                                                                      \
+                                                                                             \
+      C += t[FE_LIMBS(bits)];                                                                \
+      t[FE_LIMBS(bits)] = C;                                                                 \
+      t[FE_LIMBS(bits) + 1] = C >> BN_LIMB_BITS;                                             \
+                                                                                             \
+      /* Add u * P, which clears the low limb, and shift down by one limb */                 \
+      ul_t u = t[0] * m->mp;                                                                 \
+                                                                                             \
+      C = ((ull_t)u * m->p.l[0] + t[0]) >> BN_LIMB_BITS;                                     \
+                                                                                             \
+      FE_UNROLL                                                                              \
+      for(int j = 1; j < FE_LIMBS(bits); j++)                                                \
+      {                                                                                      \
+         C += (ull_t)u * m->p.l[j] + t[j];                                                   \
+         t[j - 1] = C;                                                                       \
+         C >>= BN_LIMB_BITS;                                                                 \
+      }                                                                                      \
+                                                                                             \
+      C += t[FE_LIMBS(bits)];                                                                \
+      t[FE_LIMBS(bits) - 1] = C;                                                             \
+      t[FE_LIMBS(bits)] = t[FE_LIMBS(bits) + 1] + (ul_t)(C >> BN_LIMB_BITS);                 \
+   }                                                                                         \
+                                                                                             \
+   _fe##bits##_reduce(d, t, t[FE_LIMBS(bits)], m);                                           \
+}                                                                                            \
+                                                                                             \
+/* D = A / R mod P, out of Montgomery form. */                                               \
+static inline void fe##bits##_from_mon(fe##bits##_t *d, const fe##bits##_t *a,               \
+                                       const fe##bits##_mod_t *m)                            \
+{                                                                                            \
+   fe##bits##_t u = { { 1 } };                                                               \
+                                                                                             \
+   fe##bits##_mon_mul(d, a, &u, m);                                                          \
+}                                                                                            \
+                                                                                             \
+/* D = A * R mod P, into Montgomery form. */                                                 \
+static inline void fe##bits##_to_mon(fe##bits##_t *d, const fe##bits##_t *a,                 \
+                                     const fe##bits##_mod_t *m)                              \
+{                                                                                            \
+   fe##bits##_mon_mul(d, a, &m->rr, m);                                                      \
+}                                                                                            \
+                                                                                             \
+/* T = A * B, 2 * FE_LIMBS(bits) limbs. */                                                   \
+static inline void _fe##bits##_mul_wide(ul_t *t, const fe##bits##_t *a,                      \
+                                       const fe##bits##_t *b)                                \
+{                                                                                            \
+   ull_t C;                                                                                  \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+      t[i] = 0;                                                                              \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      C = 0;                                                                                 \
+                                                                                             \
+      FE_UNROLL                                                                              \
+      for(int j = 0; j < FE_LIMBS(bits); j++)                                                \
+      {                                                                                      \
+         C += (ull_t)a->l[j] * b->l[i] + t[i + j];                                           \
+         t[i + j] = C;                                                                       \
+         C >>= BN_LIMB_BITS;                                                                 \
+      }                                                                                      \
+                                                                                             \
+      t[i + FE_LIMBS(bits)] = C;                                                             \
+   }                                                                                         \
+}                                                                                            \
+                                                                                             \
+/* T = A * A, 2 * FE_LIMBS(bits) limbs: the cross products once and doubled. */              \
+static inline void _fe##bits##_sqr_wide(ul_t *t, const fe##bits##_t *a)                      \
+{                                                                                            \
+   ul_t c = 0;                                                                               \
+   ull_t C;                                                                                  \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < 2 * FE_LIMBS(bits); i++)                                               \
+      t[i] = 0;                                                                              \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits) - 1; i++)                                               \
+   {                                                                                         \
+      C = 0;                                                                                 \
+                                                                                             \
+      FE_UNROLL                                                                              \
+      for(int j = i + 1; j < FE_LIMBS(bits); j++)                                            \
+      {                                                                                      \
+         C += (ull_t)a->l[i] * a->l[j] + t[i + j];                                           \
+         t[i + j] = C;                                                                       \
+         C >>= BN_LIMB_BITS;                                                                 \
+      }                                                                                      \
+                                                                                             \
+      t[i + FE_LIMBS(bits)] = C;                                                             \
+   }                                                                                         \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < 2 * FE_LIMBS(bits); i++)                                               \
+   {                                                                                         \
+      ul_t x = t[i];                                                                         \
+                                                                                             \
+      t[i] = (x << 1) | c;                                                                   \
+      c = x >> (BN_LIMB_BITS - 1);                                                           \
+   }                                                                                         \
+                                                                                             \
+   C = 0;                                                                                    \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      C += (ull_t)a->l[i] * a->l[i] + t[2 * i];                                              \
+      t[2 * i] = C;                                                                          \
+      C >>= BN_LIMB_BITS;                                                                    \
+      C += t[2 * i + 1];                                                                     \
+      t[2 * i + 1] = C;                                                                      \
+      C >>= BN_LIMB_BITS;                                                                    \
+   }                                                                                         \
+}                                                                                            \
+                                                                                             \
+/* D = A * A / R mod P: the square, then REDC. */                                            \
+static inline void fe##bits##_mon_sqr(fe##bits##_t *d, const fe##bits##_t *a,                \
+                                      const fe##bits##_mod_t *m)                             \
+{                                                                                            \
+   ul_t t[2 * FE_LIMBS(bits)], c;                                                            \
+   ull_t C;                                                                                  \
+                                                                                             \
+   _fe##bits##_sqr_wide(t, a);                                                               \
+                                                                                             \
+   /* Clear a limb at a time from the bottom, c collects the carries off the top */          \
+   c = 0;                                                                                    \
+                                                                                             \
+   FE_UNROLL                                                                                 \
+   for(int i = 0; i < FE_LIMBS(bits); i++)                                                   \
+   {                                                                                         \
+      ul_t u = t[i] * m->mp;                                                                 \
+                                                                                             \
+      C = 0;                                                                                 \
+                                                                                             \
+      FE_UNROLL                                                                              \
+      for(int j = 0; j < FE_LIMBS(bits); j++)                                                \
+      {                                                                                      \
+         C += (ull_t)u * m->p.l[j] + t[i + j];                                               \
+         t[i + j] = C;                                                                       \
+         C >>= BN_LIMB_BITS;                                                                 \
+      }                                                                                      \
+                                                                                             \
+      C += (ull_t)t[i + FE_LIMBS(bits)] + c;                                                 \
+      t[i + FE_LIMBS(bits)] = C;                                                             \
+      c = C >> BN_LIMB_BITS;                                                                 \
+   }                                                                                         \
+                                                                                             \
+   _fe##bits##_reduce(d, &t[FE_LIMBS(bits)], c, m);                                          \
+}
+
+
+/*! The widths of the standard prime curves. */
+FE_DEFINE(256)
+FE_DEFINE(384)
+FE_DEFINE(521)
+
+/*!
+* Reduction back ends for the special primes of the standard curves, which take
+* a product apart into 32-bit words and fold the upper half back in with a few
+* additions and subtractions instead of multiplications. They work on plain
+* residues, not on Montgomery ones: fe<bits>_from_mon and fe<bits>_to_mon convert
+* at both ends, and the 1 of the modulus (m->one) has to be set to plain 1. Each
+* _fe<bits>_<red>_reduce takes the 2 * FE_LIMBS(bits) limbs of a product of two
+* reduced elements; FE_REDUCE_DEFINE(bits, red) builds fe<bits>_<red>_mul and
+* fe<bits>_<red>_sqr on it.
+*/
+
+/*! 32-bit words covering the limbs of a fixed-width element of the given bits. */
+#define FE_WORDS(bits) ((FE_LIMBS(bits) * BN_LIMB_BITS + 31) / 32)
+
+/* W = the NW least significant 32-bit words of T. */
+static inline void _fe_get_words(u32 *w, const ul_t *t, int nw)
+{
+#if BN_LIMB_BITS > 32
+   for(int i = 0; i < nw; i++)
+      w[i] = (u32)(t[i / 2] >> (32 * (i % 2)));
+#else
+   for(int i = 0; i < nw; i++)
+   {
+      w[i] = 0;
+
+      for(int k = 0; k < 32 / BN_LIMB_BITS; k++)
+         w[i] |= (u32)t[i * (32 / BN_LIMB_BITS) + k] << (BN_LIMB_BITS * k);
+   }
+#endif
+}
+
+/* D = NL limbs from the NW words of W, zero above them. */
+static inline void _fe_set_words(ul_t *d, int nl, const u32 *w, int nw)
+{
+#if BN_LIMB_BITS > 32
+   for(int i = 0; i < nl; i++)
+      d[i] = (2 * i < nw ? w[2 * i] : 0) | (ul_t)(2 * i + 1 < nw ? w[2 * i + 1] : 0) << 32;
+#else
+   for(int i = 0; i < nl; i++)
+      d[i] = (ul_t)(w[i / (32 / BN_LIMB_BITS)] >> (BN_LIMB_BITS * (i % (32 / BN_LIMB_BITS))));
+#endif
+}
+
+/* R = the signed word sums A (NW of them) with the carries propagated, into NL limbs. */
+/* What comes out of the top is folded back in by 2**(32 * nw) = F[0] + F[1] * 2**32 + ... */
+/* mod P until nothing is left over; each round adds or subtracts a multiple of P, so it */
+/* ends up below 2**(32 * nw). With 64-bit limbs the carries run two words at a time. */
+static inline void _fe_fold_words(ul_t *r, int nl, const s64 *a, int nw, const s32 *f)
+{
+#if BN_LIMB_BITS > 32
+   ull_t c = 0;
+   s64 t;
+
+   FE_UNROLL
+   for(int i = 0; i < nw / 2; i++)
+   {
+      c += (ull_t)a[2 * i] + ((ull_t)a[2 * i + 1] << 32);
+      r[i] = (ul_t)c;
+      c = (ull_t)(s64)(c >> 64);
+   }
+
+   while((t = (s64)c) != 0)
+   {
+      c = 0;
+
+      FE_UNROLL
+      for(int i = 0; i < nw / 2; i++)
+      {
+         c += (ull_t)r[i] + (ull_t)(t * f[2 * i]) + ((ull_t)(t * f[2 * i + 1]) << 32);
+         r[i] = (ul_t)c;
+         c = (ull_t)(s64)(c >> 64);
+      }
+   }
+
+   for(int i = nw / 2; i < nl; i++)
+      r[i] = 0;
+#else
+   u32 w[nw];
+   s64 c = 0, t;
+
+   FE_UNROLL
+   for(int i = 0; i < nw; i++)
+   {
+      c += a[i];
+      w[i] = (u32)c;
+      c >>= 32;
+   }
+
+   while((t = c) != 0)
+   {
+      c = 0;
+
+      FE_UNROLL
+      for(int i = 0; i < nw; i++)
+      {
+         c += (s64)w[i] + t * f[i];
+         w[i] = (u32)c;
+         c >>= 32;
+      }
+   }
+
+   _fe_set_words(r, nl, w, nw);
+#endif
+}
+
+/* D = T mod P for the 2 * FE_LIMBS(256) limbs of T, where 2**256 = C mod P for a C of cl */
+/* (at most FE_LIMBS(34)) limbs: the top is folded back in times C, then again for the */
+/* cl limbs (at most C) that come out of that, and a last time for the carry bit of the */
+/* second round. Below 2**256 after this. */
+static inline void _fe256_fold(ul_t *d, const ul_t *t, const ul_t *c, int cl)
+{
+   enum { N = FE_LIMBS(256), CL = FE_LIMBS(34) };
+   ul_t x[N + CL], y[2 * CL], k;
+   ull_t C;
+
+   FE_UNROLL
+   for(int i = 0; i < N; i++)
+      x[i] = t[i];
+
+   for(int i = 0; i < cl; i++)
+   {
+      C = 0;
+
+      FE_UNROLL
+      for(int j = 0; j < N; j++)
+      {
+         C += (ull_t)t[N + j] * c[i] + x[i + j];
+         x[i + j] = C;
+         C >>= BN_LIMB_BITS;
+      }
+
+      x[i + N] = C;
+   }
+
+   for(int i = 0; i < 2 * cl; i++)
+      y[i] = 0;
+
+   for(int i = 0; i < cl; i++)
+   {
+      C = 0;
+
+      for(int j = 0; j < cl; j++)
+      {
+         C += (ull_t)x[N + i] * c[j] + y[i + j];
+         y[i + j] = C;
+         C >>= BN_LIMB_BITS;
+      }
+
+      y[i + cl] = C;
+   }
+
+   C = 0;
+
+   FE_UNROLL
+   for(int i = 0; i < N; i++)
+   {
+      C += (ull_t)x[i] + (i < 2 * cl ? y[i] : 0);
+      d[i] = C;
+      C >>= BN_LIMB_BITS;
+   }
+
+   // A carry leaves the low limbs far below 2**256 - C
+   k = (ul_t)0 - (ul_t)C;
+   C = 0;
+
+   FE_UNROLL
+   for(int i = 0; i < N; i++)
+   {
+      C += (ull_t)d[i] + (i < cl ? c[i] & k : 0);
+      d[i] = C;
+      C >>= BN_LIMB_BITS;
+   }
+}
+
+#define FE_REDUCE_DEFINE(bits, red)                                                          \
+                                                                                             \
+/* D = A * B mod P, on plain residues. D may alias A or B. */                                \
+static inline void fe##bits##_##red##_mul(fe##bits##_t *d, const fe##bits##_t *a,            \
+                                          const fe##bits##_t *b, const fe##bits##_mod_t *m)  \
+{                                                                                            \
+   ul_t t[2 * FE_LIMBS(bits)];                                                               \
+                                                                                             \
+   _fe##bits##_mul_wide(t, a, b);                                                            \
+   _fe##bits##_##red##_reduce(d, t, m);                                                      \
+}                                                                                            \
+                                                                                             \
+/* D = A * A mod P, on plain residues. */                                                    \
+static inline void fe##bits##_##red##_sqr(fe##bits##_t *d, const fe##bits##_t *a,            \
+                                          const fe##bits##_mod_t *m)                         \
+{                                                                                            \
+   ul_t t[2 * FE_LIMBS(bits)];                                                               \
+                                                                                             \
+   _fe##bits##_sqr_wide(t, a);                                                               \
+   _fe##bits##_##red##_reduce(d, t, m);                                                      \
+}
+
+
+/* P-256: P = 2**256 - 2**224 + 2**192 + 2**96 - 1, the word sums of FIPS 186-4, D.2.3. */
+static inline void _fe256_p256_reduce(fe256_t *d, const ul_t *t, const fe256_mod_t *m)
+{
+   static const s32 f[8] = { 1, 0, 0, -1, 0, 0, -1, 1 };
+   ul_t r[FE_LIMBS(256)];
+   u32 c[16];
+   s64 a[8];
+
+   _fe_get_words(c, t, 16);
+
+   a[0] = (s64)c[0] + c[8] + c[9] - c[11] - c[12] - c[13] - c[14];
+   a[1] = (s64)c[1] + c[9] + c[10] - c[12] - c[13] - c[14] - c[15];
+   a[2] = (s64)c[2] + c[10] + c[11] - c[13] - c[14] - c[15];
+   a[3] = (s64)c[3] + 2 * ((s64)c[11] + c[12]) + c[13] - c[15] - c[8] - c[9];
+   a[4] = (s64)c[4] + 2 * ((s64)c[12] + c[13]) + c[14] - c[9] - c[10];
+   a[5] = (s64)c[5] + 2 * ((s64)c[13] + c[14]) + c[15] - c[10] - c[11];
+   a[6] = (s64)c[6] + 3 * (s64)c[14] + 2 * (s64)c[15] + c[13] - c[8] - c[9];
+   a[7] = (s64)c[7] + 3 * (s64)c[15] + c[8] - c[10] - c[11] - c[12] - c[13];
+
+   _fe_fold_words(r, FE_LIMBS(256), a, 8, f);
+   _fe256_reduce(d, r, 0, m);
+}
+
+/* secp256k1: P = 2**256 - 2**32 - 977, so 2**256 = 2**32 + 977 mod P. */
+static inline void _fe256_k256_reduce(fe256_t *d, const ul_t *t, const fe256_mod_t *m)
+{
+   static const u32 w[2] = { 977, 1 };
+   ul_t c[FE_LIMBS(34)], r[FE_LIMBS(256)];
+
+   _fe_set_words(c, FE_LIMBS(34), w, 2);
+   _fe256_fold(r, t, c, FE_LIMBS(33));
+   _fe256_reduce(d, r, 0, m);
+}
+
+/* P = 2**255 - 19: 2**256 = 38 mod P, then bit 255 times 19. */
+static inline void _fe256_25519_reduce(fe256_t *d, const ul_t *t, const fe256_mod_t *m)
+{
+   static const ul_t c[1] = { 38 };
+   ul_t r[FE_LIMBS(256)];
+   ull_t C;
+
+   _fe256_fold(r, t, c, 1);
+
+   // Below 2**255 + 19 < 2P after this
+   C = 19 * (ull_t)(r[FE_LIMBS(256) - 1] >> (BN_LIMB_BITS - 1));
+   r[FE_LIMBS(256) - 1] &= (ul_t)-1 >> 1;
+
+   FE_UNROLL
+   for(int i = 0; i < FE_LIMBS(256); i++)
+   {
+      C += r[i];
+      r[i] = C;
+      C >>= BN_LIMB_BITS;
+   }
+
+   _fe256_reduce(d, r, 0, m);
+}
+
+/* P-384: P = 2**384 - 2**128 - 2**96 + 2**32 - 1, the word sums of FIPS 186-4, D.2.4. */
+static inline void _fe384_p384_reduce(fe384_t *d, const ul_t *t, const fe384_mod_t *m)
+{
+   static const s32 f[12] = { 1, -1, 0, 1, 1 };
+   ul_t r[FE_LIMBS(384)];
+   u32 c[24];
+   s64 a[12];
+
+   _fe_get_words(c, t, 24);
+
+   a[0] = (s64)c[0] + c[12] + c[21] + c[20] - c[23];
+   a[1] = (s64)c[1] + c[13] + c[22] + c[23] - c[12] - c[20];
+   a[2] = (s64)c[2] + c[14] + c[23] - c[13] - c[21];
+   a[3] = (s64)c[3] + c[15] + c[12] + c[20] + c[21] - c[14] - c[22] - c[23];
+   a[4] = (s64)c[4] + 2 * (s64)c[21] + c[16] + c[13] + c[12] + c[20] + c[22] - c[15] - 2 * (s64)c[23];
+   a[5] = (s64)c[5] + 2 * (s64)c[22] + c[17] + c[14] + c[13] + c[21] + c[23] - c[16];
+   a[6] = (s64)c[6] + 2 * (s64)c[23] + c[18] + c[15] + c[14] + c[22] - c[17];
+   a[7] = (s64)c[7] + c[19] + c[16] + c[15] + c[23] - c[18];
+   a[8] = (s64)c[8] + c[20] + c[17] + c[16] - c[19];
+   a[9] = (s64)c[9] + c[21] + c[18] + c[17] - c[20];
+   a[10] = (s64)c[10] + c[22] + c[19] + c[18] - c[21];
+   a[11] = (s64)c[11] + c[23] + c[20] + c[19] - c[22];
+
+   _fe_fold_words(r, FE_LIMBS(384), a, 12, f);
+   _fe384_reduce(d, r, 0, m);
+}
+
+/* P-521: P = 2**521 - 1, so the bits from 521 up are added to the ones below, twice. */
+static inline void _fe521_p521_reduce(fe521_t *d, const ul_t *t, const fe521_mod_t *m)
+{
+   enum { N = FE_LIMBS(521), K = 521 / BN_LIMB_BITS, S = 521 % BN_LIMB_BITS };
+   const ul_t M = ((ul_t)1 << S) - 1;
+   ul_t r[N];
+   ull_t C = 0;
+
+   FE_UNROLL
+   for(int i = 0; i < N; i++)
+   {
+      C += (ull_t)(i < N - 1 ? t[i] : t[i] & M) + (ul_t)((t[K + i] >> S) | (t[K + i + 1] << (BN_LIMB_BITS - S)));
+      r[i] = C;
+      C >>= BN_LIMB_BITS;
+   }
+
+   // Below 2**522, and at most P after folding bit 521
+   C = r[N - 1] >> S;
+   r[N - 1] &= M;
+
+   FE_UNROLL
+   for(int i = 0; i < N; i++)
+   {
+      C += r[i];
+      r[i] = C;
+      C >>= BN_LIMB_BITS;
+   }
+
+   _fe521_reduce(d, r, 0, m);
+}
+
+FE_REDUCE_DEFINE(256, p256)
+FE_REDUCE_DEFINE(256, k256)
+FE_REDUCE_DEFINE(256, 25519)
+FE_REDUCE_DEFINE(384, p384)
+FE_REDUCE_DEFINE(521, p521)
+
+#endif // _FE_H_
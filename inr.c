@@ -17,7 +17,7 @@ void inr_sign(inr_ctxt_t *ctxt, inr_sig_t *sig, bn_t *m)
 	{
 		bn_reduce(bn_rand(k), ctxt->q); // TODO: should be k \in [1,q-1].
 		bn_to_mon(bn_reduce(bn_copy(sig->r, m), ctxt->p), ctxt->p); // r=m (mod p)
-		bn_mon_pow(t, ctxt->g, ctxt->p, k);                         // t=g^k
+		bn_mon_pow(t, ctxt->g, k, ctxt->p);                         // t=g^k
 		bn_mon_mul(sig->r, sig->r, t, ctxt->p);                     // r=m*g^k
 		bn_from_mon(sig->r, ctxt->p);
 		bn_reduce(bn_copy(r2, sig->r), ctxt->q);                    // r2 = r mod q
@@ -41,17 +41,15 @@ int inr_verify(inr_ctxt_t *ctxt, inr_sig_t *sig, bn_t *m)
 	bn_t *r2 = bn_alloc(ctxt->p->n),
 		*m2 = bn_alloc(ctxt->p->n),
 		*t = bn_alloc(ctxt->p->n);
+	bn_t *b[2] = { ctxt->g, ctxt->y },
+		*e[2] = { sig->s, r2 };
 
 	bn_to_mon(bn_copy(m2, sig->r), ctxt->p);
 	bn_reduce(bn_copy(r2, sig->r), ctxt->q);  // r2 = r mod q
-	bn_to_mon(sig->r, ctxt->p);
 
-	bn_mon_pow(t, ctxt->g, ctxt->p, sig->s);  // t=g^s
-	bn_mon_mul(m2, m2, t, ctxt->p);           // m2=r*g^s
-	bn_mon_pow(t, ctxt->y, ctxt->p, r2);      // t=y^r2
+	bn_mon_pow_multi(t, b, e, 2, ctxt->p);    // t=g^s*y^r2
 	bn_mon_mul(m2, m2, t, ctxt->p);           // m2=r*g^s*y^r2
 
-	bn_from_mon(sig->r, ctxt->p);
 	bn_from_mon(m2, ctxt->p);
 
 	int res = bn_cmp(bn_reduce(bn_copy(t, m), ctxt->p), m2) == BN_CMP_E;
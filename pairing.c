@@ -8,6 +8,7 @@
 #include <stdlib.h>
 
 #include "pairing.h"
+#include "recode.h"
 
 poly_t *_pairing_line(poly_t *d, ec_pqr_point_t *P, ec_pqr_point_t *R, ec_pqr_point_t *Q, ec_pqr_group_t *ecg)
 {
@@ -74,6 +75,7 @@ poly_t *_pairing_miller(poly_t *d, ec_pqr_point_t *P, ec_pqr_point_t *Q, bn_t *n
 	assert(!bn_is_zero(n));
 
 	int i;
+	s16 bits[RECODE_DIGITS(n)];
 
 	ec_pqr_point_t *R = ec_pqr_point_copy(ec_pqr_point_alloc(ecg), P);
 	ec_pqr_point_t *S = ec_pqr_point_alloc(ecg);
@@ -83,7 +85,7 @@ poly_t *_pairing_miller(poly_t *d, ec_pqr_point_t *P, ec_pqr_point_t *Q, bn_t *n
 
 	poly_one(d);
 
-	for (i = bn_maxbit(n) - 1; i >= 0; i--)
+	for (i = recode_binary(bits, n) - 2; i >= 0; i--)
 	{
 		ec_pqr_point_double(S, R, ecg); //S = [2]R
 		_pairing_line(l, R, R, Q, ecg); //l_{R,R}
@@ -96,7 +98,7 @@ poly_t *_pairing_miller(poly_t *d, ec_pqr_point_t *P, ec_pqr_point_t *Q, bn_t *n
 
 		ec_pqr_point_copy(R, S);
 
-		if (!bn_getbit(n, i))
+		if (!bits[i])
 			continue;
 
 		ec_pqr_point_add(S, R, P, ecg); //S = R + P
@@ -121,22 +123,31 @@ poly_t *_pairing_miller(poly_t *d, ec_pqr_point_t *P, ec_pqr_point_t *Q, bn_t *n
 
 poly_t *pairing_weil(poly_t *d, ec_pqr_point_t *P, ec_pqr_point_t *Q, bn_t *n, ec_pqr_group_t *ecg)
 {
-	poly_t *t = poly_alloc(d->degree, d->N, 1);
+	// Work in the scratch arena, only the copy into D goes to the heap.
+	arena_scope_t s, h;
+	arena_push(&s, arena_scratch());
 
-	//d = f_{n,P}(D_Q) / f_{n,Q}(D_P)
-	_pairing_miller(d, P, Q, n, ecg);
+	poly_t *r = poly_alloc(d->degree, d->N, 1),
+		*t = poly_alloc(d->degree, d->N, 1);
+
+	//r = f_{n,P}(D_Q) / f_{n,Q}(D_P)
+	_pairing_miller(r, P, Q, n, ecg);
 	_pairing_miller(t, Q, P, n, ecg);
 	pqr_inv(t, t, ecg->p);
-	pqr_mul(d, d, t, ecg->p);
+	pqr_mul(r, r, t, ecg->p);
 
 	if (bn_getbit(n, 0))
 	{
-		//d = -d
+		//r = -r
 		poly_zero(t);
-		pqr_sub(d, t, d, ecg->p);
+		pqr_sub(r, t, r, ecg->p);
 	}
 
-	poly_free(t, 1);
+	arena_push(&h, NULL);
+	poly_copy(d, r, 1);
+	arena_pop(&h);
+
+	arena_pop(&s);
 
 	return d;
 }
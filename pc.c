@@ -7,6 +7,7 @@
 #include <stdlib.h>
 
 #include "pc.h"
+#include "recode.h"
 
 static void _pc_add(bn_t *d, bn_t *a, bn_t *b, pc_group_t *pcg)
 {
@@ -25,7 +26,7 @@ static void _pc_mul(bn_t *d, bn_t *a, bn_t *b, pc_group_t *pcg)
 
 static void _pc_square(bn_t *d, bn_t *a, pc_group_t *pcg)
 {
-	_pc_mul(d, a, a, pcg);
+	bn_mon_sqr(d, a, pcg->p);
 }
 
 static void _pc_inv(bn_t *d, bn_t *a, pc_group_t *pcg)
@@ -38,12 +39,14 @@ static void _pc_inv(bn_t *d, bn_t *a, pc_group_t *pcg)
 pc_point_t *pc_point_alloc(u32 n)
 {
 	pc_point_t *res;
+	bn_t *c[2];
 
-	if ((res = (pc_point_t *)mem_alloc(sizeof(pc_point_t))) == NULL)
+	// The coordinates live in the same block, right after the point.
+	if ((res = (pc_point_t *)bn_alloc_block(sizeof(pc_point_t), c, 2, n)) == NULL)
 		return NULL;
 
-	res->x = bn_alloc(n);
-	res->y = bn_alloc(n);
+	res->x = c[0];
+	res->y = c[1];
 
 	return res;
 }
@@ -90,6 +93,15 @@ void pc_point_from_mon(pc_point_t *p, pc_group_t *pcg)
 	bn_from_mon(p->y, pcg->p);
 }
 
+pc_point_t *pc_point_neg(pc_point_t *r, pc_point_t *p, pc_group_t *pcg)
+{
+	// The inverse is the conjugate (x, -y).
+	bn_copy(r->x, p->x);
+	bn_sub(r->y, pcg->p, p->y, pcg->p);
+
+	return r;
+}
+
 pc_point_t *pc_point_add(pc_point_t *r, pc_point_t *p, pc_point_t *q, pc_group_t *pcg)
 {
 	bn_t *x1 = p->x, *y1 = p->y, *x2 = q->x, *y2 = q->y;
@@ -116,22 +128,71 @@ pc_point_t *pc_point_add(pc_point_t *r, pc_point_t *p, pc_point_t *q, pc_group_t
 	return r;
 }
 
+pc_point_t *pc_point_double(pc_point_t *r, pc_point_t *p, pc_group_t *pcg)
+{
+	bn_t *x = p->x, *y = p->y;
+	bn_t *s = bn_alloc(pcg->p->n), *t = bn_alloc(pcg->p->n);
+
+	// r.y = 2*x*y
+	_pc_mul(s, x, y, pcg);
+
+	// r.x = x*x + D*y*y
+	_pc_square(t, y, pcg);
+	_pc_mul(t, pcg->D, t, pcg);
+	_pc_square(r->x, x, pcg);
+	_pc_add(r->x, r->x, t, pcg);
+
+	_pc_add(r->y, s, s, pcg);
+
+	bn_free(t);
+	bn_free(s);
+
+	return r;
+}
 
 pc_point_t *pc_point_mul(pc_point_t *d, bn_t *a, pc_point_t *b, pc_group_t *pcg)
 {
-	int i;
-	pc_point_t *bt = pc_point_copy(pc_point_alloc(b->x->n), b);
+	int i, j, w = recode_wnaf_width(bn_maxbit(a) + 1), h = 1 << (w - 2), set = 0;
+	pc_point_t *pos[h], *neg[h];
+	s16 dig[RECODE_DIGITS(a)];
 
+	// Odd multiples b, 3b, ..., (2h - 1)b and their conjugates (before d is touched, it may be b).
+	pos[0] = pc_point_copy(pc_point_alloc(b->x->n), b);
+	if (h > 1)
+	{
+		pc_point_t *b2 = pc_point_double(pc_point_alloc(b->x->n), b, pcg);
+		for (j = 1; j < h; j++)
+			pos[j] = pc_point_add(pc_point_alloc(b->x->n), pos[j - 1], b2, pcg);
+		pc_point_free(b2);
+	}
+	for (j = 0; j < h; j++)
+		neg[j] = pc_point_neg(pc_point_alloc(b->x->n), pos[j], pcg);
+
+	// The identity (1, 0), in montgomery form.
 	pc_point_zero(d);
+	bn_copy(d->x, bn_mon_ctxt(pcg->p)->one);
 
-	for (i = 0; i <= bn_maxbit(a); i++)
+	// Left to right over the wNAF digits of a, one addition per non-zero digit.
+	for (i = recode_wnaf(dig, a, w) - 1; i >= 0; i--)
 	{
-		if (bn_getbit(a, i))
-			pc_point_add(d, d, bt, pcg);
-		pc_point_add(bt, bt, bt, pcg);
+		if (set)
+			pc_point_double(d, d, pcg);
+		if (dig[i])
+		{
+			pc_point_t *t = (dig[i] > 0) ? pos[dig[i] >> 1] : neg[-dig[i] >> 1];
+			if (set)
+				pc_point_add(d, d, t, pcg);
+			else
+				pc_point_copy(d, t);
+			set = 1;
+		}
 	}
 
-	pc_point_free(bt);
+	for (j = 0; j < h; j++)
+	{
+		pc_point_free(pos[j]);
+		pc_point_free(neg[j]);
+	}
 
 	return d;
 }
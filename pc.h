@@ -62,13 +62,23 @@ void pc_point_to_mon(pc_point_t *p, pc_group_t *pcg);
 */
 void pc_point_from_mon(pc_point_t *p, pc_group_t *pcg);
 
+/*!
+* \brief Negate point (conjugate).
+*/
+pc_point_t *pc_point_neg(pc_point_t *r, pc_point_t *p, pc_group_t *pcg);
+
 /*!
 * \brief Add two points.
 */
 pc_point_t *pc_point_add(pc_point_t *r, pc_point_t *p, pc_point_t *q, pc_group_t *pcg);
 
 /*!
-* \brief Multiply point with bignum (d = a * b).
+* \brief Double point.
+*/
+pc_point_t *pc_point_double(pc_point_t *r, pc_point_t *p, pc_group_t *pcg);
+
+/*!
+* \brief Multiply point with bignum (d = a * b), using the wNAF of a.
 */
 pc_point_t *pc_point_mul(pc_point_t *d, bn_t *a, pc_point_t *b, pc_group_t *pcg);
 
@@ -95,27 +95,23 @@ void poly_print(FILE *fp, const s8 *pre, poly_t *p, const s8 *post)
 poly_t *poly_alloc(int degree, bn_t *N, int alloc_coeffs)
 {
 	poly_t *res;
+	bn_t **coeffs;
 
-	if ((res = (poly_t *)mem_alloc(sizeof(poly_t))) == NULL)
+	// Degree + 1 coeffs, the pointers apart since poly_adjust resizes them.
+	if ((coeffs = (bn_t **)mem_alloc(sizeof(bn_t *) * (degree + 1))) == NULL)
 		return NULL;
 
-	// Degree + 1 coeffs.
-	if ((res->coeffs = (bn_t **)mem_alloc(sizeof(bn_t *) * (degree + 1))) == NULL)
+	// Allocated coefficients live in the same block as the polynomial.
+	if ((res = (poly_t *)bn_alloc_block(sizeof(poly_t), coeffs, alloc_coeffs ? degree + 1 : 0, N->n)) == NULL)
 	{
-		mem_free(res);
+		mem_free(coeffs);
 		return NULL;
 	}
 
+	res->coeffs = coeffs;
 	res->degree = degree;
 	res->N = N;
 
-	if (alloc_coeffs)
-	{
-		int i;
-		for (i = 0; i < degree + 1; i++)
-			res->coeffs[i] = bn_zero(bn_alloc(N->n));
-	}
-
 	return res;
 }
 
@@ -140,7 +136,7 @@ poly_t *poly_adjust(poly_t *p, int degree, int alloc_free_coeffs)
 	if (p->degree < degree)
 	{
 		// Grow polynomial.
-		p->coeffs = (bn_t **)realloc(p->coeffs, sizeof(bn_t *) * (degree + 1));
+		p->coeffs = (bn_t **)mem_realloc(p->coeffs, sizeof(bn_t *) * (degree + 1));
 
 		if (alloc_free_coeffs)
 		{
@@ -163,7 +159,7 @@ poly_t *poly_adjust(poly_t *p, int degree, int alloc_free_coeffs)
 		}
 
 		// Shrink polynomial.
-		p->coeffs = (bn_t **)realloc(p->coeffs, sizeof(bn_t *) * (degree + 1));
+		p->coeffs = (bn_t **)mem_realloc(p->coeffs, sizeof(bn_t *) * (degree + 1));
 		p->degree = degree;
 	}
 
@@ -254,23 +250,19 @@ poly_t *poly_one(poly_t *p)
 	assert(p->degree >= 0 && p->coeffs[0] != NULL);
 
 	poly_zero(p);
-	bn_set_ui(p->coeffs[0], 1);
-	bn_to_mon(p->coeffs[0], p->N);
+	bn_copy(p->coeffs[0], bn_mon_ctxt(p->N)->one);
 
 	return p;
 }
 
 int poly_is_one(poly_t *p)
 {
-	int i, is_one = 0;
+	int i;
 
 	assert(p->degree >= 0 && p->coeffs[0] != NULL);
 
-	//Check if the linear coeff is 1.
-	bn_from_mon(p->coeffs[0], p->N);
-	is_one = bn_cmp_ui(p->coeffs[0], 1) == BN_CMP_E;
-	bn_to_mon(p->coeffs[0], p->N);
-	if (!is_one)
+	//Check if the linear coeff is 1 (compared in montgomery form).
+	if (bn_cmp(p->coeffs[0], bn_mon_ctxt(p->N)->one) != BN_CMP_E)
 		return 0;
 
 	// Return 1 if we only have a linear term.
@@ -386,7 +378,7 @@ bn_t *poly_eval(poly_t *p, bn_t *dst, bn_t *x)
 	{
 		bn_set_ui(e, i);
 		// t = x^e
-		bn_mon_pow(t, tx, p->N, e);
+		bn_mon_pow(t, tx, e, p->N);
 		// dst += t * a_i
 		bn_add(dst, dst, bn_mon_mul(t, t, p->coeffs[i], p->N), p->N);
 	}
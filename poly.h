@@ -47,6 +47,7 @@ void poly_print(FILE *fp, const s8 *pre, poly_t *p, const s8 *post);
 
 /*!
 * \brief Allocate polynomial (with zero coefficients).
+*        Allocated coefficients are stored inline and go with the polynomial.
 */
 poly_t *poly_alloc(int degree, bn_t *N, int alloc_coeffs);
 
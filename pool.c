@@ -0,0 +1,297 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#if !defined(NAKED)
+   #include <stdlib.h>
+   #include <string.h>
+
+   #if !defined(_WIN32) && !defined(_MSC_VER)
+      #include <pthread.h>
+   #else
+      #include <windows.h>
+   #endif
+#endif
+
+#include "bn.h"
+
+#if defined(_MSC_VER)
+   #define POOL_TLS __declspec(thread)
+#else
+   #define POOL_TLS __thread
+#endif
+
+/*! Block header (the size class, 0 for blocks from malloc), keeps the data 16-byte aligned. */
+#define POOL_HDR 16
+
+/*! Size classes, POOL_HDR bytes apart. */
+#define POOL_CLASSES (BN_POOL_MAX_BYTES / POOL_HDR)
+
+/*! Blocks moved to the depot at a time. */
+#define POOL_BATCH (BN_POOL_CACHE_BLOCKS / 2)
+
+#define _pool_class(p) (*(u32 *)((u8 *)(p) - POOL_HDR))
+
+/*! Free block: the next one in its list, and the next batch while in the depot. */
+typedef struct _pool_block_t
+{
+   struct _pool_block_t *next, *batch;
+} pool_block_t;
+
+/*! Free list of one class. */
+typedef struct _pool_list_t
+{
+   pool_block_t *head;
+   int count;
+} pool_list_t;
+
+/*! Cache of one thread. */
+typedef struct _pool_cache_t
+{
+   pool_list_t l[POOL_CLASSES + 1];
+   size_t hits, refills, misses, large;
+} pool_cache_t;
+
+// Per-class stacks of batches, pushed with CAS and only ever emptied whole (no ABA)
+static pool_block_t *_pool_depot[POOL_CLASSES + 1];
+static size_t _pool_depot_puts = 0, _pool_depot_gets = 0;
+
+static POOL_TLS pool_cache_t *_pool_cache = NULL;
+
+#if defined(_MSC_VER)
+   #define _pool_load(p) (*(pool_block_t * volatile *)(p))
+   #define _pool_xchg(p, v) ((pool_block_t *)InterlockedExchangePointer((PVOID volatile *)(p), (v)))
+   #define _pool_cas(p, o, n) (InterlockedCompareExchangePointer((PVOID volatile *)(p), (n), (o)) == (o))
+   #define _pool_count(c) InterlockedExchangeAddSizeT(&(c), 1)
+   #define _pool_load_count(c) (*(volatile size_t *)&(c))
+#else
+   #define _pool_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+   #define _pool_xchg(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+   #define _pool_cas(p, o, n) __extension__({ pool_block_t *_o = (o); \
+      __atomic_compare_exchange_n((p), &_o, (n), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED); })
+   #define _pool_count(c) __atomic_fetch_add(&(c), 1, __ATOMIC_RELAXED)
+   #define _pool_load_count(c) __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#endif
+
+// Push the batches FIRST to LAST (linked through batch) on the depot of class C
+static void _pool_depot_put(int c, pool_block_t *first, pool_block_t *last)
+{
+   pool_block_t *h;
+
+   do
+   {
+      h = _pool_load(&_pool_depot[c]);
+      last->batch = h;
+   } while(!_pool_cas(&_pool_depot[c], h, first));
+}
+
+// Take one batch off the depot of class C: empty it, keep the top batch and push the rest back
+static pool_block_t *_pool_depot_get(int c)
+{
+   pool_block_t *b, *last;
+
+   if(_pool_load(&_pool_depot[c]) == NULL || (b = _pool_xchg(&_pool_depot[c], NULL)) == NULL)
+      return NULL;
+
+   if(b->batch != NULL)
+   {
+      for(last = b->batch; last->batch != NULL; last = last->batch)
+         ;
+
+      _pool_depot_put(c, b->batch, last);
+   }
+
+   _pool_count(_pool_depot_gets);
+
+   return b;
+}
+
+// Hand the whole list of class C to the depot
+static void _pool_spill(pool_list_t *l, int c)
+{
+   if(l->head == NULL)
+      return;
+
+   l->head->batch = NULL;
+   _pool_depot_put(c, l->head, l->head);
+   _pool_count(_pool_depot_puts);
+
+   l->head = NULL;
+   l->count = 0;
+}
+
+static void _pool_cache_flush(pool_cache_t *t)
+{
+   for(int c = 1; c <= POOL_CLASSES; c++)
+      _pool_spill(&t->l[c], c);
+}
+
+#if !defined(_WIN32) && !defined(_MSC_VER)
+static pthread_key_t _pool_key;
+static pthread_once_t _pool_once = PTHREAD_ONCE_INIT;
+
+// Thread exit: give the cache back
+static void _pool_exit(void *t)
+{
+   _pool_cache_flush((pool_cache_t *)t);
+   free(t);
+   _pool_cache = NULL;
+}
+
+static void _pool_key_init(void)
+{
+   pthread_key_create(&_pool_key, _pool_exit);
+}
+#endif
+
+static pool_cache_t *_pool_cache_get(void)
+{
+   if(_pool_cache == NULL)
+   {
+      _pool_cache = (pool_cache_t *)calloc(1, sizeof(pool_cache_t));
+
+#if !defined(_WIN32) && !defined(_MSC_VER)
+      pthread_once(&_pool_once, _pool_key_init);
+      pthread_setspecific(_pool_key, _pool_cache);
+#endif
+   }
+
+   return _pool_cache;
+}
+
+void *pool_alloc(size_t size)
+{
+   size_t c = size ? (size + POOL_HDR - 1) / POOL_HDR : 1;
+   pool_cache_t *t = _pool_cache_get();
+   pool_block_t *b;
+   u8 *p;
+
+   if(c > POOL_CLASSES)
+   {
+      t->large++;
+
+      if((p = (u8 *)malloc(size + POOL_HDR)) == NULL)
+         return NULL;
+
+      *(u32 *)p = 0;
+      return p + POOL_HDR;
+   }
+
+   pool_list_t *l = &t->l[c];
+
+   if(l->head == NULL && (l->head = _pool_depot_get(c)) != NULL)
+   {
+      t->refills++;
+
+      for(b = l->head; b != NULL; b = b->next)
+         l->count++;
+   }
+   else if(l->head != NULL)
+      t->hits++;
+
+   if((b = l->head) != NULL)
+   {
+      l->head = b->next;
+      l->count--;
+
+      return b;
+   }
+
+   t->misses++;
+
+   if((p = (u8 *)malloc(c * POOL_HDR + POOL_HDR)) == NULL)
+      return NULL;
+
+   *(u32 *)p = c;
+   return p + POOL_HDR;
+}
+
+void *pool_realloc(void *p, size_t size)
+{
+   if(p == NULL)
+      return pool_alloc(size);
+
+   u32 c = _pool_class(p);
+
+   if(c == 0)
+   {
+      u8 *q = (u8 *)realloc((u8 *)p - POOL_HDR, size + POOL_HDR);
+
+      return q ? q + POOL_HDR : NULL;
+   }
+
+   if(size <= c * POOL_HDR)
+      return p;
+
+   void *q = pool_alloc(size);
+
+   if(q != NULL)
+   {
+      memcpy(q, p, c * POOL_HDR);
+      pool_free(p);
+   }
+
+   return q;
+}
+
+void pool_free(void *p)
+{
+   if(p == NULL)
+      return;
+
+   u32 c = _pool_class(p);
+
+   if(c == 0)
+   {
+      free((u8 *)p - POOL_HDR);
+      return;
+   }
+
+   pool_cache_t *t = _pool_cache_get();
+   pool_list_t *l = &t->l[c];
+   pool_block_t *b = (pool_block_t *)p;
+
+   // A full list keeps its newest POOL_BATCH blocks and gives the older ones away
+   if(l->count >= BN_POOL_CACHE_BLOCKS)
+   {
+      pool_block_t *k = l->head;
+
+      for(int i = 1; i < POOL_BATCH; i++)
+         k = k->next;
+
+      pool_list_t r = { k->next, l->count - POOL_BATCH };
+
+      k->next = NULL;
+      l->count = POOL_BATCH;
+      _pool_spill(&r, c);
+   }
+
+   b->next = l->head;
+   l->head = b;
+   l->count++;
+}
+
+void pool_flush(void)
+{
+   if(_pool_cache != NULL)
+      _pool_cache_flush(_pool_cache);
+}
+
+void pool_stats(pool_stats_t *s)
+{
+   pool_cache_t *t = _pool_cache_get();
+
+   memset(s, 0, sizeof(pool_stats_t));
+
+   s->hits = t->hits;
+   s->refills = t->refills;
+   s->misses = t->misses;
+   s->large = t->large;
+
+   for(int c = 1; c <= POOL_CLASSES; c++)
+      s->cached += t->l[c].count;
+
+   s->depot_puts = _pool_load_count(_pool_depot_puts);
+   s->depot_gets = _pool_load_count(_pool_depot_gets);
+}
@@ -0,0 +1,61 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#if !defined(NAKED)
+   #include <stddef.h>
+#endif
+
+/*!
+* Thread-caching pools of fixed-size blocks, one per 16-byte size class up to
+* BN_POOL_MAX_BYTES. Each thread allocates from and frees to its own free lists
+* without locking; a list that grows past BN_POOL_CACHE_BLOCKS hands a batch to
+* a lock-free global depot, where other threads pick it up when theirs run dry.
+* So blocks freed on another thread than the one that allocated them are reused
+* too. Bigger blocks go straight to malloc.
+*/
+
+/*! Pool counters. */
+typedef struct _pool_stats_t
+{
+   /*! Allocations the calling thread served from its cache, from a depot batch, and from malloc. */
+   size_t hits, refills, misses;
+   /*! Allocations of the calling thread too big for any class. */
+   size_t large;
+   /*! Blocks in the calling thread's cache. */
+   size_t cached;
+   /*! Batches handed to and taken from the depot, by all threads. */
+   size_t depot_puts, depot_gets;
+} pool_stats_t;
+
+/*!
+* \brief Allocate a block of at least size bytes.
+*/
+void *pool_alloc(size_t size);
+
+/*!
+* \brief Resize a block from pool_alloc.
+*/
+void *pool_realloc(void *p, size_t size);
+
+/*!
+* \brief Free a block from pool_alloc, on any thread.
+*/
+void pool_free(void *p);
+
+/*!
+* \brief Hand the calling thread's cache to the depot. Threads do this on exit
+*        by themselves, except under Windows.
+*/
+void pool_flush(void);
+
+/*!
+* \brief Get the pool counters.
+*/
+void pool_stats(pool_stats_t *s);
+
+#endif // _POOL_H_
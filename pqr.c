@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "pqr.h"
+#include "recode.h"
 
 poly_t *pqr_add(poly_t *d, poly_t *a, poly_t *b, poly_t *N)
 {
@@ -114,6 +115,7 @@ poly_t *pqr_inv(poly_t *d, poly_t *p, poly_t *N)
 poly_t *pqr_exp_fast(poly_t *d, poly_t *p, bn_t *e, poly_t *N)
 {
 	int i;
+	s16 bits[RECODE_DIGITS(e)];
 
 	assert(d->degree == p->degree);
 	assert(d != p);
@@ -122,10 +124,10 @@ poly_t *pqr_exp_fast(poly_t *d, poly_t *p, bn_t *e, poly_t *N)
 
 	poly_t *r = poly_alloc(p->degree, d->N, 1);
 
-	for (i = bn_maxbit(e); i >= 0; i--)
+	for (i = recode_binary(bits, e) - 1; i >= 0; i--)
 	{
 		pqr_mul_fast(r, d, d, N);
-		if (bn_getbit(e, i))
+		if (bits[i])
 			pqr_mul_fast(d, r, p, N);
 		else
 			poly_copy(d, r, 0);
@@ -0,0 +1,141 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#if !defined(NAKED)
+   #include <string.h>
+#endif
+
+#include "recode.h"
+
+// Bits x to x + n - 1 of K (n <= 16), with zeroes past its top.
+static int _recode_bits(bn_t *k, int x, int n)
+{
+   u32 v = 0;
+
+   for(int got = 0; got < n; )
+   {
+      int i = (x + got) / BN_LIMB_BITS, o = (x + got) % BN_LIMB_BITS;
+
+      if(i >= k->used)
+         break;
+
+      v |= (u32)(k->l[i] >> o) << got;
+      got += BN_LIMB_BITS - o;
+   }
+
+   return v & ((1 << n) - 1);
+}
+
+int recode_binary(s16 *d, bn_t *k)
+{
+   int len = bn_is_zero(k) ? 0 : bn_maxbit(k) + 1;
+
+   for(int i = 0; i < len; i++)
+      d[i] = _recode_bits(k, i, 1);
+
+   return len;
+}
+
+int recode_window(s16 *d, bn_t *k, int w)
+{
+   int len = bn_is_zero(k) ? 0 : (bn_maxbit(k) + w) / w;
+
+   for(int i = 0; i < len; i++)
+      d[i] = _recode_bits(k, i * w, w);
+
+   return len;
+}
+
+int recode_sliding(s16 *d, bn_t *k, int w)
+{
+   int len = bn_is_zero(k) ? 0 : bn_maxbit(k) + 1;
+
+   memset(d, 0, len * sizeof(s16));
+
+   for(int x = len - 1; x >= 0; )
+   {
+      if(!_recode_bits(k, x, 1))
+      {
+         x--;
+         continue;
+      }
+
+      // The window runs from x down to its lowest set bit
+      int lo = MAX(x - w + 1, 0);
+
+      while(!_recode_bits(k, lo, 1))
+         lo++;
+
+      d[lo] = _recode_bits(k, lo, x - lo + 1);
+      x = lo - 1;
+   }
+
+   return len;
+}
+
+int recode_wnaf(s16 *d, bn_t *k, int w)
+{
+   int len = 0, top = bn_is_zero(k) ? 0 : bn_maxbit(k) + 2, c = 0;
+
+   memset(d, 0, top * sizeof(s16));
+
+   // Take w bits plus the carry at each odd position. Digits of 2**(w - 1) and
+   // up become negative, which carries 2**w into the next window
+   for(int x = 0; x < top; )
+   {
+      if(_recode_bits(k, x, 1) == c)
+      {
+         x++;
+         continue;
+      }
+
+      int n = MIN(w, top - x), v = _recode_bits(k, x, n) + c;
+
+      c = (v >> (w - 1)) & 1;
+      d[x] = v - (c << w);
+      len = x + 1;
+      x += n;
+   }
+
+   return len;
+}
+
+int recode_wnaf_width(int bits)
+{
+   int best = 2, cost = -1;
+
+   for(int w = 2; w <= 8; w++)
+   {
+      int c = (1 << (w - 2)) + bits / (w + 1);
+
+      if(cost < 0 || c < cost)
+      {
+         best = w;
+         cost = c;
+      }
+   }
+
+   return best;
+}
+
+int recode_comb(s16 *d, bn_t *k, int h, int v, int b)
+{
+   int a = v * b;
+
+   for(int x = 0; x < b; x++)
+   {
+      for(int j = 0; j < v; j++)
+      {
+         int u = 0;
+
+         for(int i = 0; i < h; i++)
+            u |= _recode_bits(k, i * a + j * b + x, 1) << i;
+
+         d[x * v + j] = u;
+      }
+   }
+
+   return a;
+}
@@ -0,0 +1,61 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#ifndef _RECODE_H_
+#define _RECODE_H_
+
+#include "bn.h"
+
+/*!
+* Scalar recodings. Each one turns K into an array of digits once, least
+* significant first, so that exponentiation and point multiplication loops
+* just walk the digits instead of fetching bits of K one by one. The caller
+* provides the digits, and every function returns how many it wrote (0 for
+* K = 0).
+*/
+
+/*! Digits the binary, sliding window and wNAF recodings of K may need. */
+#define RECODE_DIGITS(k) (bn_maxbit(k) + 2)
+
+/*!
+* \brief Binary: K = sum of d[i] * 2**i, with d[i] in {0, 1}.
+*/
+int recode_binary(s16 *d, bn_t *k);
+
+/*!
+* \brief Fixed windows of w <= 15 bits: K = sum of d[i] * 2**(w * i), with d[i]
+*        in [0, 2**w).
+*/
+int recode_window(s16 *d, bn_t *k, int w);
+
+/*!
+* \brief Sliding windows of at most w <= 15 bits, taken from the top (HAC 14.85):
+*        K = sum of d[i] * 2**i, where each non-zero d[i] is the odd value of the
+*        window whose lowest bit is i.
+*/
+int recode_sliding(s16 *d, bn_t *k, int w);
+
+/*!
+* \brief Width-w NAF (2 <= w <= 15): K = sum of d[i] * 2**i, where each non-zero
+*        d[i] is odd, of absolute value below 2**(w - 1), and followed by at
+*        least w - 1 zeroes.
+*/
+int recode_wnaf(s16 *d, bn_t *k, int w);
+
+/*!
+* \brief wNAF width with the fewest additions for a scalar of the given bits,
+*        counting the table of odd multiples (one doubling and 2**(w - 2) - 1
+*        additions).
+*/
+int recode_wnaf_width(int bits);
+
+/*!
+* \brief Lim-Lee comb: h <= 15 teeth a = v * b bits apart, each tooth split in
+*        v blocks of b bits. Bit i of d[k * v + j] is bit i * a + j * b + k of
+*        K. Writes all b * v digits and returns how many there are.
+*/
+int recode_comb(s16 *d, bn_t *k, int h, int v, int b);
+
+#endif // _RECODE_H_
@@ -0,0 +1,145 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#if !defined(NAKED)
+#include <stdlib.h>
+
+#if !defined(_WIN32) && !defined(_MSC_VER)
+#include <pthread.h>
+#define RSA_PTHREADS
+#endif
+#endif
+
+#include "rsa.h"
+
+/*! One half of a CRT private operation, m = (c mod n)^d mod n. */
+typedef struct _rsa_half_t
+{
+	bn_t *m;
+	bn_t *c;
+	bn_t *d;
+	bn_t *n;
+} rsa_half_t;
+
+static void *_rsa_half(void *arg)
+{
+	rsa_half_t *h = (rsa_half_t *)arg;
+
+	bn_pow_mod(h->m, bn_reduce(h->c, h->n), h->d, h->n);
+
+	return NULL;
+}
+
+rsa_key_t *rsa_key_init(bn_t *p, bn_t *q, bn_t *e)
+{
+	rsa_key_t *res;
+	bn_t *p1, *q1, *phi;
+
+	if (p == NULL || q == NULL || e == NULL)
+		return NULL;
+
+	if ((res = (rsa_key_t *)mem_alloc(sizeof(rsa_key_t))) == NULL)
+		return NULL;
+
+	res->p = bn_copy(bn_alloc(p->n), p);
+	res->q = bn_copy(bn_alloc(q->n), q);
+	res->N = bn_mul(bn_alloc(p->n + q->n), p, q);
+	res->e = bn_copy(bn_alloc(res->N->n), e);
+	res->threads = 0;
+
+	// phi = (p - 1)(q - 1), which is not prime, hence bn_inv.
+	p1 = bn_sub_ui(bn_alloc(p->n), p, 1, p);
+	q1 = bn_sub_ui(bn_alloc(q->n), q, 1, q);
+	phi = bn_mul(bn_alloc(res->N->n), p1, q1);
+
+	res->d = bn_inv(bn_alloc(res->N->n), e, phi);
+	res->dp = bn_inv(bn_alloc(p->n), e, p1);
+	res->dq = bn_inv(bn_alloc(q->n), e, q1);
+	res->qinv = bn_inv(bn_alloc(p->n), q, p);
+
+	bn_free(p1);
+	bn_free(q1);
+	bn_free(phi);
+
+	// e must be invertible, and p and q distinct primes.
+	if (bn_is_zero(res->d) || bn_is_zero(res->qinv))
+	{
+		rsa_key_free(res);
+		return NULL;
+	}
+
+	// Build the contexts cached in p and q now, rather than in both halves at once.
+	bn_mon_ctxt(res->p);
+	bn_mon_ctxt(res->q);
+	bn_barrett_ctxt(res->p);
+	bn_barrett_ctxt(res->q);
+
+	bn_to_mon(res->qinv, res->p);
+
+	return res;
+}
+
+void rsa_key_free(rsa_key_t *key)
+{
+	if (key == NULL)
+		return;
+
+	bn_free(key->N);
+	bn_free(key->e);
+	bn_free(key->d);
+	bn_free(key->p);
+	bn_free(key->q);
+	bn_free(key->dp);
+	bn_free(key->dq);
+	bn_free(key->qinv);
+	mem_free(key);
+}
+
+bn_t *rsa_public(bn_t *c, bn_t *m, rsa_key_t *key)
+{
+	return bn_pow_mod(c, m, key->e, key->N);
+}
+
+bn_t *rsa_private(bn_t *m, bn_t *c, rsa_key_t *key)
+{
+	bn_t *N = key->N, *p = key->p, *q = key->q;
+	bn_t *m1 = bn_alloc(p->n), *m2 = bn_alloc(q->n),
+		*c1 = bn_copy(bn_alloc(N->n), c), *c2 = bn_copy(bn_alloc(N->n), c),
+		*h = bn_alloc(p->n), *t = bn_alloc(N->n);
+	rsa_half_t hp = { m1, c1, key->dp, p },
+		hq = { m2, c2, key->dq, q };
+
+	// m1 = c^dp mod p, m2 = c^dq mod q
+#if defined(RSA_PTHREADS)
+	pthread_t th;
+
+	if (key->threads && pthread_create(&th, NULL, _rsa_half, &hq) == 0)
+	{
+		_rsa_half(&hp);
+		pthread_join(th, NULL);
+	}
+	else
+#endif
+	{
+		_rsa_half(&hp);
+		_rsa_half(&hq);
+	}
+
+	// Garner: h = qinv*(m1 - m2) mod p, m = m2 + h*q
+	bn_copy(h, bn_reduce(bn_copy(t, m2), p));
+	bn_sub(h, m1, h, p);
+	bn_mon_mul(h, h, key->qinv, p);
+	bn_mul(m, h, q);
+	bn_add(m, m, bn_copy(t, m2), N);
+
+	bn_free(m1);
+	bn_free(m2);
+	bn_free(c1);
+	bn_free(c2);
+	bn_free(h);
+	bn_free(t);
+
+	return m;
+}
@@ -0,0 +1,57 @@
+/*
+* Licensed under the terms of the GNU GPL, version 2
+* http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+*/
+
+#ifndef _RSA_H_
+#define _RSA_H_
+
+#include "bn.h"
+
+/*! RSA key, with the precomputed material for CRT private operations. */
+typedef struct _rsa_key_t
+{
+	/*! Modulus N = p*q. */
+	bn_t *N;
+	/*! Public exponent e. */
+	bn_t *e;
+	/*! Private exponent d = e^-1 mod (p - 1)(q - 1). */
+	bn_t *d;
+	/*! Primes p and q. */
+	bn_t *p;
+	bn_t *q;
+	/*! dp = d mod (p - 1), dq = d mod (q - 1). */
+	bn_t *dp;
+	bn_t *dq;
+	/*! qinv = q^-1 mod p. (mon!) */
+	bn_t *qinv;
+	/*! Run the two halves of private operations on two threads (if available). */
+	int threads;
+} rsa_key_t;
+
+/*!
+* \brief Initialize RSA key from its primes.
+* \param p Prime p.
+* \param q Prime q.
+* \param e Public exponent, coprime to (p - 1)(q - 1).
+* \return NULL on error.
+*/
+rsa_key_t *rsa_key_init(bn_t *p, bn_t *q, bn_t *e);
+
+/*!
+* \brief Free key.
+*/
+void rsa_key_free(rsa_key_t *key);
+
+/*!
+* \brief Public operation (encrypt/verify), c = m^e mod N.
+*/
+bn_t *rsa_public(bn_t *c, bn_t *m, rsa_key_t *key);
+
+/*!
+* \brief Private operation (decrypt/sign), m = c^d mod N.
+*        Uses two half-size exponentiations and Garner's recombination.
+*/
+bn_t *rsa_private(bn_t *m, bn_t *c, rsa_key_t *key);
+
+#endif
@@ -45,41 +45,43 @@ bn_t *ssecrets_create_share(poly_t *p, bn_t *x)
 bn_t *ssecrets_calc_secret(bn_t **x, bn_t **s, u32 cnt, bn_t *N)
 {
 	u32 i, j;
-	BOOL first;
 
-	bn_t *res = bn_alloc(N->n), *t = bn_alloc(N->n), *a = bn_alloc(N->n), *b = bn_alloc(N->n);
+	bn_t *res = bn_alloc(N->n), *t = bn_alloc(N->n);
+	bn_t **num = (bn_t **)mem_alloc(sizeof(bn_t *) * cnt), **den = (bn_t **)mem_alloc(sizeof(bn_t *) * cnt);
 
 	// Compute secret by using Lagrange polynomial interpolation algorithm for x = 0.
 	// s = \sum s_i \prod_{j \ne i} (-x_j)(x_i - x_j)^{-1} \mod N
 	for (i = 0; i < cnt; i++)
 	{
-		bn_zero(t);
-		first = TRUE;
+		// num_i = \prod_{j \ne i} (-x_j), den_i = \prod_{j \ne i} (x_i - x_j)
+		num[i] = bn_to_mon(bn_set_ui(bn_alloc(N->n), 1), N);
+		den[i] = bn_to_mon(bn_set_ui(bn_alloc(N->n), 1), N);
 		for (j = 0; j < cnt; j++)
 		{
 			if (j == i)
 				continue;
 
-			// b = (x_i - x_j)^(-1)
-			bn_mon_inv(b, bn_to_mon(bn_sub(b, x[i], x[j], N), N), N);
-			// a = -x_j*b
-			bn_mon_mul(a, bn_to_mon(bn_sub(a, bn_zero(a), x[j], N), N), b, N);
-			// t *= a
-			if (first == TRUE)
-			{
-				bn_to_mon(bn_copy(t, a), N);
-				first = FALSE;
-			}
-			else
-				bn_mon_mul(t, t, a, N);
+			bn_mon_mul(num[i], num[i], bn_to_mon(bn_sub(t, bn_zero(t), x[j], N), N), N);
+			bn_mon_mul(den[i], den[i], bn_to_mon(bn_sub(t, x[i], x[j], N), N), N);
 		}
-		// res += s_i * t
-		bn_add(res, res, bn_from_mon(bn_mon_mul(t, s[i], t, N), N), N);
 	}
 
+	// Invert all the denominators at once.
+	bn_mon_inv_batch(den, den, cnt, N);
+
+	// res += s_i * num_i / den_i. The shares are in Montgomery form, so the sum is too.
+	for (i = 0; i < cnt; i++)
+	{
+		bn_mon_mul(t, num[i], den[i], N);
+		bn_add(res, res, bn_mon_mul(t, t, s[i], N), N);
+
+		bn_free(num[i]);
+		bn_free(den[i]);
+	}
+
+	mem_free(num);
+	mem_free(den);
 	bn_free(t);
-	bn_free(a);
-	bn_free(b);
 
-	return res;
+	return bn_from_mon(res, N);
 }
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+#include "bn.h"
+
+// Small chunks, so that a few blocks already need another one
+#define CHUNK 256
+
+int main()
+{
+   arena_t *a = arena_alloc(CHUNK);
+   arena_scope_t s, t, h;
+   int bad[4] = { 0 };
+   u8 *p, *q, *r;
+
+   // Scopes: blocks are aligned, the last one goes back on free, arena_pop releases the rest
+   arena_push(&s, a);
+
+   p = arena_mem_alloc(40);
+   q = arena_mem_alloc(24);
+   bad[0] += ((size_t)p | (size_t)q) % 16 != 0 || q <= p;
+
+   arena_mem_free(q);
+   bad[0] += arena_mem_alloc(8) != q;
+
+   arena_mem_free(p);
+   bad[0] += arena_mem_alloc(8) == p;
+
+   arena_push(&t, a);
+   r = arena_mem_alloc(32);
+   arena_pop(&t);
+   bad[0] += arena_mem_alloc(32) != r;
+
+   arena_pop(&s);
+
+   arena_push(&s, a);
+   bad[0] += arena_mem_alloc(40) != p;
+   arena_pop(&s);
+
+   // A block goes back to its own arena, whichever scope is innermost
+   arena_t *b = arena_alloc(CHUNK);
+
+   arena_push(&s, a);
+   p = arena_mem_alloc(16);
+
+   arena_push(&t, b);
+   q = arena_mem_alloc(16);
+   arena_mem_free(p);
+   arena_pop(&t);
+
+   bad[0] += arena_mem_alloc(16) != p;
+   arena_pop(&s);
+
+   arena_push(&s, b);
+   bad[0] += arena_mem_alloc(16) != q;
+   arena_pop(&s);
+
+   arena_free(b);
+
+   printf("%s\n", bad[0] ? "SCOPE MISMATCH" : "SCOPE OK");
+
+   // Realloc: in place while nothing follows the block, by copy once it has to move
+   arena_push(&s, a);
+
+   p = arena_mem_alloc(32);
+   memset(p, 0xA5, 32);
+
+   bad[1] += arena_mem_realloc(p, 16) != p || arena_mem_realloc(p, 64) != p;
+
+   q = arena_mem_alloc(16);
+   r = arena_mem_realloc(p, 96);
+   bad[1] += r == p || r == q;
+
+   // Bigger than a chunk
+   p = arena_mem_realloc(r, 4 * CHUNK);
+
+   for(int i = 0; i < 32; i++)
+      bad[1] += p[i] != 0xA5;
+
+   memset(p, 0x5A, 4 * CHUNK);
+   arena_pop(&s);
+
+   printf("%s\n", bad[1] ? "REALLOC MISMATCH" : "REALLOC OK");
+
+   // A nested heap scope outlives the arena scope
+   arena_push(&s, a);
+   p = arena_mem_alloc(16);
+
+   arena_push(&h, NULL);
+   q = arena_mem_alloc(48);
+   arena_pop(&h);
+
+   memset(q, 0x3C, 48);
+   arena_pop(&s);
+
+   arena_push(&s, a);
+   memset(arena_mem_alloc(64), 0, 64);
+   arena_pop(&s);
+
+   for(int i = 0; i < 48; i++)
+      bad[2] += q[i] != 0x3C;
+
+   // Freed on the heap outside of any scope, as are blocks from outside of one
+   arena_mem_free(q);
+   arena_mem_free(arena_mem_realloc(arena_mem_alloc(8), 4096));
+
+   printf("%s\n", bad[2] ? "HEAP SCOPE MISMATCH" : "HEAP SCOPE OK");
+
+   // Bignum arithmetic in a scratch scope, against the same outside of it
+   bn_t *n = bn_from_str(bn_alloc(64), "F1A3A3B7A5F62B4C8E3D5E5A9AB2C6EEC7E5AB8E33D3C1A4B5E3C3A7D9E1F4C3"
+                                       "A9F8E7D6C5B4A39281706F5E4D3C2B1A09F8E7D6C5B4A3928170695E4D3C2B1B");
+   bn_t *g = bn_set_ui(bn_alloc(64), 3), *d = bn_alloc(64), *e = bn_alloc(64);
+
+   for(int i = 0; i < 512; i += 5)
+      bn_setbit(e, i);
+
+   bn_pow_mod(d, g, e, n);
+
+   for(int i = 0; i < 3; i++)
+   {
+      bn_t *x;
+
+      arena_push(&s, arena_scratch());
+      x = bn_pow_mod(bn_alloc(64), g, e, n);
+      bad[3] += bn_cmp(x, d) != BN_CMP_E;
+      arena_pop(&s);
+   }
+
+   printf("%s\n", bad[3] ? "SCRATCH MISMATCH" : "SCRATCH OK");
+
+   bn_free(n);
+   bn_free(g);
+   bn_free(d);
+   bn_free(e);
+
+   arena_scratch_free();
+   arena_free(a);
+
+   return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include "bn.h"
+
+// Bignums whose top limb is in use, so that nothing may be written past it
+#define BYTES 24
+
+int main()
+{
+   const s8 *as = "C90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74";
+   bn_t *a = bn_alloc(BYTES), *d = bn_alloc(BYTES), *r = bn_alloc(BYTES);
+   bn_t *n = bn_from_str(bn_alloc(BYTES), "F1A3A3B7A5F62B4C8E3D5E5A9AB2C6EEC7E5AB8E33D3C1A5");
+   int bad = 0;
+
+   // Shifts by more than a limb, the bits shifted out of the top are lost
+   bn_lshift(bn_from_str(bn_zero(a), as), 100);
+   bad += bn_cmp(a, bn_from_str(bn_zero(r), "0DC1CD129024E088A67CC740000000000000000000000000")) != BN_CMP_E;
+
+   bn_lshift(bn_set_ui(a, 1), 100);
+   bad += bn_cmp(a, bn_from_str(bn_zero(r), "10000000000000000000000000")) != BN_CMP_E;
+
+   bn_rshift(bn_from_str(bn_zero(a), as), 100);
+   bad += bn_cmp(a, bn_from_str(bn_zero(r), "0C90FDAA22168C234C4C6628")) != BN_CMP_E;
+
+   printf("%s\n", bad ? "SHIFT MISMATCH" : "SHIFT OK");
+
+   // A product that does not fit in D is truncated
+   bn_mul_ui(d, bn_from_str(bn_zero(a), as), 0xFB);
+   bad = bn_cmp(d, bn_from_str(bn_zero(r), "228B5CF6C1B669BCEE829EC757D041133542825FB3C575BC")) != BN_CMP_E;
+
+   printf("%s\n", bad ? "MUL UI MISMATCH" : "MUL UI OK");
+
+   // A / R mod N, which goes through both of the above
+   bn_mon_reduce(bn_from_str(bn_zero(a), as), n);
+   bad = bn_cmp(a, bn_from_str(bn_zero(r), "1AAF83C7A1E1955F618A79F31E31C2F9BE14C0037AB34221")) != BN_CMP_E;
+
+   printf("%s\n", bad ? "MON REDUCE MISMATCH" : "MON REDUCE OK");
+
+   bn_free(a);
+   bn_free(d);
+   bn_free(r);
+   bn_free(n);
+
+   return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "bn.h"
+#include "dh.h"
+
+#define THREADS 8
+
+static dh_params_t *params;
+static dh_ctxt_t *ctxt[THREADS];
+
+// Every thread starts a key exchange with the same parameters, and so the same comb
+static void *dh_thread(void *arg)
+{
+   ctxt[(size_t)arg] = dh_init(params);
+
+   return arg;
+}
+
+int main()
+{
+   bn_t *g = bn_set_ui(bn_alloc(64), 5);
+   bn_t *p = bn_set_ui(bn_alloc(64), 97);
+   bn_t *e = bn_alloc(128);
+   bn_t *d = bn_alloc(64);
+   bn_t *r = bn_alloc(64);
+   bn_comb_ctxt_t *comb;
+   int bad = 0;
+
+   // Small modulus: 5**3 % 97 = 28
+   comb = bn_comb_ctxt_alloc(g, p, 8);
+   bn_comb_pow_mod(d, bn_set_ui(e, 3), comb);
+   bad += bn_cmp_ui(d, 28) != BN_CMP_E;
+
+   // The comb keeps its own copies of G and N: 5**3 % 97 = 28 still
+   bn_set_ui(g, 7);
+   bn_ctxt_invalidate(p);
+   bn_set_ui(p, 101);
+
+   bn_comb_pow_mod(d, e, comb);
+   bad += bn_cmp_ui(d, 28) != BN_CMP_E;
+   bn_comb_ctxt_free(comb);
+
+   // And past its exponent size: 5**300 % 97 = 64
+   comb = bn_comb_ctxt_alloc(bn_set_ui(g, 5), bn_set_ui(p, 97), 8);
+   bn_comb_pow_mod(d, bn_set_ui(e, 300), comb);
+   bad += bn_cmp_ui(d, 64) != BN_CMP_E;
+   bn_comb_ctxt_free(comb);
+
+   printf("%s\n", bad ? "COMB (copies) MISMATCH" : "COMB (copies) OK");
+
+   // 512-bit modulus against bn_pow_mod, for exponents of every size up to the comb's
+   // and one past it
+   bn_ctxt_invalidate(p);
+   bn_from_str(p, "F1A3A3B7A5F62B4C8E3D5E5A9AB2C6EEC7E5AB8E33D3C1A4B5E3C3A7D9E1F4C3"
+                  "A9F8E7D6C5B4A39281706F5E4D3C2B1A09F8E7D6C5B4A3928170695E4D3C2B1B");
+   bn_from_str(g, "02");
+   comb = bn_comb_ctxt_alloc(g, p, 512);
+   bad = 0;
+
+   for(int bits = 0; bits <= 520; bits += 13)
+   {
+      bn_zero(e);
+
+      for(int i = 0; i < bits; i += 3)
+         bn_setbit(e, i);
+
+      bn_comb_pow_mod(d, e, comb);
+      bn_pow_mod(r, g, e, p);
+      bad += bn_cmp(d, r) != BN_CMP_E;
+   }
+
+   bn_comb_ctxt_free(comb);
+
+   printf("%s\n", bad ? "COMB MISMATCH" : "COMB OK");
+
+   // Concurrent key exchanges sharing one set of 1024-bit DH parameters
+   bn_t *dp = bn_from_bin(bn_alloc(128), bP_1024, 128), *dg = bn_set_ui(bn_alloc(128), 2);
+   bn_t *c = bn_alloc(128);
+   pthread_t t[THREADS];
+
+   params = dh_params_init(dp, dg);
+   bad = 0;
+
+   for(size_t i = 0; i < THREADS; i++)
+      pthread_create(&t[i], NULL, dh_thread, (void *)i);
+
+   for(int i = 0; i < THREADS; i++)
+   {
+      pthread_join(t[i], NULL);
+
+      bad += bn_cmp(ctxt[i]->C, bn_pow_mod(c, dg, ctxt[i]->c, dp)) != BN_CMP_E;
+      dh_free(ctxt[i]);
+   }
+
+   dh_params_free(params);
+
+   printf("%s\n", bad ? "COMB (DH threads) MISMATCH" : "COMB (DH threads) OK");
+
+   bn_free(g);
+   bn_free(p);
+   bn_free(e);
+   bn_free(d);
+   bn_free(r);
+   bn_free(dp);
+   bn_free(dg);
+   bn_free(c);
+
+   return 0;
+}
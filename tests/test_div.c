@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include "bn.h"
+
+// A, B, A / B and A % B
+static const s8 *vec[][4] =
+{
+   // Knuth's add-back step, for 8, 16, 32 and 64-bit limbs, then assorted sizes
+   { "01000000",
+     "010001",
+     "FF",
+     "FF01" },
+   { "01000000000000",
+     "0100000001",
+     "FFFF",
+     "FFFF0001" },
+   { "01000000000000000000000000",
+     "010000000000000001",
+     "FFFFFFFF",
+     "FFFFFFFF00000001" },
+   { "01000000000000000000000000000000000000000000000000",
+     "0100000000000000000000000000000001",
+     "FFFFFFFFFFFFFFFF",
+     "FFFFFFFFFFFFFFFF0000000000000001" },
+   { "09CFBAC67687A66E",
+     "0DF915",
+     "B3C198322C",
+     "02BCD2" },
+   { "DDD6FF552FA73207237751AA4462EBFC",
+     "81A5BA50AD38835E",
+     "01B60AC1ADA144AD45",
+     "589E62B56068FDA6" },
+   { "9DDCC6F8EFB6FBFE8DE4AB47558298E214B044D79ACD8ACDE5F6DB1D76B6745180B65386569C8036",
+     "B4174A672B5EBAA061076DC3BA6ACE6C0A78250FB339A476",
+     "E066E9F715FD56731DA67CE05FCF9522",
+     "AB6D865AFF853F1F3701C85F47D0CE68A35DE53C36D1FA8A" },
+   { "C632976A10363C5F972651DAFDB119A9EC801BDFDF2965B3819AD93B21E6A46F1C670EA90D243A163CEE5E2C2B1E1885283B73A66C2EA417B99DE255F386825473B7A490F23B2CC4",
+     "CA8AA593EB40A9B81A070205E323BB2ABF00188DCA22E4C76237DBE6B03DA701",
+     "FA826E5AF200FF8C8A5457360EBD8DE9BA6F99BD1305A8E794F710AD14897EA0C4AB43F218DC5039",
+     "94A46DCA3F24FD85D638F4218B1D4B38D77244A9D20F92C17722388AD374AD8B" },
+   { "CF3C17E55777039E47FBB3B46583D61435BB5C11E95027004448A6A1C5C7D1861674518DE3BB41B36BF82959CB01C357B9C7E435396BCB8FAC9ABB0C3478442B",
+     "0ECBAC3C9A8DF50602FE0C239EDD3A7DE0D208D886C5D060FA1C95E553FB510E06ACD4694398C5E11E99FB01597AC1E2EB17C8B573F6C5331155190B0ECF26",
+     "0E01",
+     "09E0E8A7190F5518140BB591CBC5F76C5E0E31B1F7FBE235BE578148B56770AAFA06F7C81CD69DDE6DD54BE4F1AE2CFB8FD2802C790BFF86E207585A156105" },
+   { "821CD6FF548914EF33FB4B4FDA298ADEE5329B4E329A86139425B3E2C3AD4D991F0916CB00FDED6598CAE043F6C986F21CAF107AD9C98C23E80A86CFBC79CE03",
+     "01",
+     "821CD6FF548914EF33FB4B4FDA298ADEE5329B4E329A86139425B3E2C3AD4D991F0916CB00FDED6598CAE043F6C986F21CAF107AD9C98C23E80A86CFBC79CE03",
+     "00" },
+   { "8004789365EAEB999B8A2E547E22184E8215607DF9E4794195",
+     "0B1365EC29F8119E333A6B8C290D32BBA064EBC1D3D2899F57F77F2A75EC92AEB20C15B7D95F",
+     "00",
+     "8004789365EAEB999B8A2E547E22184E8215607DF9E4794195" },
+   { "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+     "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+     "010000000000000000000000000000000000000000000000000000000000000001",
+     "00" },
+   { "029D42B64E76714244CB",
+     "029D42B64E76714244CB",
+     "01",
+     "00" },
+};
+
+#define VECS (int)(sizeof(vec) / sizeof(vec[0]))
+
+// A, N and A % N
+static const s8 *red[][3] =
+{
+   // Up to twice the modulus size (Barrett), and wider (bn_reduce_slow)
+   { "088CEA2904CDEFCF84B683A749F9C5470B9805D2D6B8777DC59A3AD035D259766BAD0734C2DA8003CC0F2793FDCAB87B89296C6DCBAC5008577EB1924770D3",
+     "BEDC25E6F3EBCF12F3D06F863FFFC830137A977753E8EB437D763FB9854A9657",
+     "3A02437505371523CE41EE1F827207563DFC0E185EB8717C068ED9BED5FDCFC6" },
+   { "ACB7362C74F2E2ED432779EEACCA7F0DD3AC535F489B340F6BD7F50361B0EE095AE6A2289A6AB329238123E5DC3383836B9F15C40B680C1C5C74E45EFF1E5BEF",
+     "DC2C2E2CC49104D074F942CB220ADB0A5CD2875EA96EC2B34D984BFFAF949E5E",
+     "96706B0AF0DDBF265FF58F69834DE0C56CB3AF325912FCD84C949898AE8ACF05" },
+   { "953B00B00B54AA22600FECC19D02FC90708CC1B6F829D29F3D4806C2FB7F6F5D",
+     "44A6F55A4D88450FE8DAC663F0E5865031E875BA224C06013C53D0E30109C207",
+     "0BED15FB704420028E5A5FF9BB37EFF00CBBD642B391C69CC4A064FCF96BEB4F" },
+   { "033D7C95F9E5F0307EC5A56D7E5DBBB7CE",
+     "018C8A18B2AAAC3142",
+     "010DE4EBD3A33F8446" },
+   { "F843BDB8396BA83AD798C9CF280B11FD807DA245D814D575531EC56C95A4D257A7298C6610A37558785036DE6F9FB997",
+     "CD1919A07F21682208208D090973E89C3D06143769B1DCBF",
+     "339D421D70606FA7F0B5871F2988D198D35A2BE471291FA7" },
+   { "C68800F6BB5EA11CE80B12265039F699EF1857E9B7EA615FC9EBA4F2108D619136580B626946462651F63714B91C79DAE98554EC9CCE6F889263CE1270DEE2A86B8A6E9B4F32AFD167533A",
+     "01F29C11AD30E0888FCEB506F6FB605EE62A96D06A7109799918BB28E9C5EC6148",
+     "C347F9AD7E495ADCBD3CDDC30EC8FEB7B33593D81CC39E4CF905C7FC304D90FA" },
+   { "0F6A013380F871CFDE6EE84270",
+     "BE",
+     "24" },
+   { "D1E59CF78F54E77CDB0B2E2669B66B32848B7B537801483DE2394227456F4930C853FBFF6C58FA6E1CC5D974667AEA05982D143295C70AFC922C9F7296D230B46CF16A1E3FA612D49EA911655E2A395D334D753AC174AB0A38445BE2C51E9667C2DD68F2012DAF94C185986ADB9E04470624BD48204652F62DAE4839A1",
+     "038FF6052881E5319535971C67A07B5472B3CB0B43032E3E1475F78D3E1C8521",
+     "01E42E559A6D8C02CB94A74F59D2F4F274A374320840F7F6C1771D95FD1B1991" },
+};
+
+#define REDS (int)(sizeof(red) / sizeof(red[0]))
+
+int main()
+{
+   bn_t *a = bn_alloc(128), *b = bn_alloc(128), *q = bn_alloc(128), *r = bn_alloc(128);
+   bn_t *eq = bn_alloc(128), *er = bn_alloc(128);
+   int bad = 0;
+
+   for(int i = 0; i < VECS; i++)
+   {
+      bn_from_str(bn_zero(a), vec[i][0]);
+      bn_from_str(bn_zero(b), vec[i][1]);
+      bn_from_str(bn_zero(eq), vec[i][2]);
+      bn_from_str(bn_zero(er), vec[i][3]);
+
+      bn_divrem(q, r, a, b);
+      bad += bn_cmp(q, eq) != BN_CMP_E || bn_cmp(r, er) != BN_CMP_E;
+
+      // The quotient and the remainder may alias the operands
+      bn_divrem(a, b, a, b);
+      bad += bn_cmp(a, eq) != BN_CMP_E || bn_cmp(b, er) != BN_CMP_E;
+   }
+
+   printf("%s\n", bad ? "DIVREM MISMATCH" : "DIVREM OK");
+
+   // The same N, changing value from one reduction to the next, with its cached
+   // Barrett context dropped in between
+   bad = 0;
+
+   for(int i = 0; i < REDS; i++)
+   {
+      bn_from_str(bn_zero(a), red[i][0]);
+      bn_ctxt_invalidate(b);
+      bn_from_str(bn_zero(b), red[i][1]);
+      bn_from_str(bn_zero(er), red[i][2]);
+
+      bn_reduce(a, b);
+      bad += bn_cmp(a, er) != BN_CMP_E;
+   }
+
+   printf("%s\n", bad ? "REDUCE MISMATCH" : "REDUCE OK");
+
+   bn_free(a);
+   bn_free(b);
+   bn_free(q);
+   bn_free(r);
+   bn_free(eq);
+   bn_free(er);
+
+   return 0;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include "ec.h"
+
+// A curve with its special prime, k * G and k * G + k2 * (3 * G) (plain coordinates)
+static const struct
+{
+   const s8 *name;
+   int red, size;
+   const s8 *p, *a, *b, *gx, *gy, *k, *k2, *x, *y, *x2, *y2;
+} curves[] =
+{
+   {
+      "P-256", EC_RED_P256, 32,
+      "FFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFF",
+      "FFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFC",
+      "5AC635D8AA3A93E7B3EBBD55769886BC651D06B0CC53B0F63BCE3C3E27D2604B",
+      "6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296",
+      "4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5",
+      "D76D4330F1446BEAB0C11FDECB91CE375BC8FBBCBDE5C0994164D8399F767C46",
+      "C6A5387777330BDBD7210DFF076CE2EF87B0B125EC1D7DA0A6EB8C9EBD69FE2A",
+      "6A1918D922BFE0889368D4EC1F4C8DB715B14017F80952188E889E0DE2BCFAC1",
+      "D9C3B56C51861817E8CD49B6A6ED67B17941B48CCFD25A556F4EE151DBB3E8CB",
+      "64C69E80F321C2E406C65C2A9DFDAEC0C2A8ACE47B845F11AE1CDF1B2D6188A0",
+      "2CF333B5DEF393E2CBC2C35AEEB482EA43DEE7A84D3F985FDA215D982FC79D6E"
+   },
+   {
+      "P-384", EC_RED_P384, 48,
+      "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFE"
+      "FFFFFFFF0000000000000000FFFFFFFF",
+      "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFE"
+      "FFFFFFFF0000000000000000FFFFFFFC",
+      "B3312FA7E23EE7E4988E056BE3F82D19181D9C6EFE8141120314088F5013875A"
+      "C656398D8A2ED19D2A85C8EDD3EC2AEF",
+      "AA87CA22BE8B05378EB1C71EF320AD746E1D3B628BA79B9859F741E082542A38"
+      "5502F25DBF55296C3A545E3872760AB7",
+      "3617DE4A96262C6F5D9E98BF9292DC29F8F41DBD289A147CE9DA3113B5F0B8C0"
+      "0A60B1CE1D7E819D7A431D7C90EA0E5F",
+      "687C966C377B9AA2BB2EDB20035B73993FD4235992EDCF451A1AFE878B33E968"
+      "617959CE3F1F65A8DE5271007814E8A3",
+      "9E30691C238642EA126A1E48CC11D357C30D8B7628DBD25E63B229F1C4069545"
+      "DE11CC9DEA959C212E9C82B1478C281E",
+      "B507DEB969E259BC304A6C18DCB162D11028D45E6524F52FDD05F2A84113CE84"
+      "77C3035BE233A6517E59B4E411C28BF7",
+      "3051E56E5DCA4134AC9A94EC5922E85148BABBEF22D41E516D7E26F42D421BA3"
+      "CC581EFCD0490F9B201C3F59D14DBA62",
+      "E24C1856A18E5F5E751C087F9929BDA8AF66FE3B1EDAFEDAC40E4E133922CBD1"
+      "998F0F837327BD2AF21D0034AA85EA43",
+      "3C1663068D71A99D4427A2A807A41FAECF95CF1C322323B2905D8A3AF7FE755A"
+      "F4F4BC39558277646BCF83F90389B135"
+   },
+   {
+      "P-521", EC_RED_P521, 66,
+      "01FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+      "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+      "FFFF",
+      "01FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+      "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+      "FFFC",
+      "0051953EB9618E1C9A1F929A21A0B68540EEA2DA725B99B315F3B8B489918EF1"
+      "09E156193951EC7E937B1652C0BD3BB1BF073573DF883D2C34F1EF451FD46B50"
+      "3F00",
+      "00C6858E06B70404E9CD9E3ECB662395B4429C648139053FB521F828AF606B4D"
+      "3DBAA14B5E77EFE75928FE1DC127A2FFA8DE3348B3C1856A429BF97E7E31C2E5"
+      "BD66",
+      "011839296A789A3BC0045C8A5FB42C7D1BD998F54449579B446817AFBD17273E"
+      "662C97EE72995EF42640C550B9013FAD0761353C7086A272C24088BE94769FD1"
+      "6650",
+      "0161F7F35634F0E3CD972E81D66D346C6E2BA02FDAA1AD864C44E049548E8A0A"
+      "8C9632EA6928F6236BF2504B74BA4A0FE75D2A9EBA0CDF561D802A759159FB7F"
+      "F338",
+      "01A24D25DEB354F46A6910ACFF0043892DFC254CB864EF901B932A7C18806A37"
+      "53915C76F18A0585A01C4C7D6DF0621AEF57E4CC4132F7108E96F770C2263266"
+      "AA3C",
+      "00BE218495D8916A702BDF78BF3B7E6F1011BCB3655E97886217C623B5AAB00E"
+      "BA14C6386F472B8ED40A93D8756F89C1FC8E177A17948AE72F271B245911DCC0"
+      "B5A8",
+      "017DF124AED5C9DE53010BE8A5DCFE475358A9ECB9889035CD1E16963FA745FF"
+      "52AE2B984A2BDCA7B9073C0DC6CF7C82C9ABCF669B1839E3C632C7E3C103424B"
+      "43C4",
+      "011520C40D3E6CA6DE5AC57292EFFB0F822572C004FB5E49D265D725DD078DD3"
+      "49023FD31014C2F7C3F05A1A8F52B0DD595EBF2482E99913557D6F57862F48BD"
+      "B232",
+      "0013A58DC76C9122AAD34C5BBD393DD1D38997CF4F6D122DFCA94BC215EF536E"
+      "491307F1B963826882DC34F3F6F9C21C65CD6F12F881371F8B1D7CDCBE5E81DC"
+      "B10D"
+   },
+   {
+      "secp256k1", EC_RED_K256, 32,
+      "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F",
+      "0000000000000000000000000000000000000000000000000000000000000000",
+      "0000000000000000000000000000000000000000000000000000000000000007",
+      "79BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798",
+      "483ADA7726A3C4655DA4FBFC0E1108A8FD17B448A68554199C47D08FFB10D4B8",
+      "05DA8467F06313FFF9A01FE8419521FE0E979CF32D1634B4B465325278F845F6",
+      "C9A937A68C8F95EF04A012E8677FD139D84A1D3A5B8E8FB2BFF29101F3001CEF",
+      "430C72FA234348DB92B482C6BB20395A445C0CE7A16409F5CC9C52161A856447",
+      "E68E4D1A8307220F0CD713415544F5F266135B3954BCEE48B50B1BEE5CC3F2B8",
+      "1AC8E2021B0CC3E429BB64696E6E60F0C6BB3D94A7C09463ECBABD4723B83C41",
+      "3F114B7C5FF36940CCAFF98BBFF98B0A35649C4B4F69439F0D6471F75FA52778"
+   },
+   {
+      "Wei25519", EC_RED_25519, 32,
+      "7FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFED",
+      "2AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA984914A144",
+      "7B425ED097B425ED097B425ED097B425ED097B425ED097B4260B5E9C7710C864",
+      "2AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAD245A",
+      "20AE19A1B8A086B4E01EDD2C7748D14C923D4D7E6D7C61B229E9C5A27ECED3D9",
+      "0B5A77468332F05A5829681876531737F129C8C6D1CA4DC4EDFDE4163EFF8B40",
+      "09FF97E817921E6C8B8E8F4EB3DE08F9EC9837044692BA035707967025F02629",
+      "0A9C83D73BEA0B16C0FE05B70589B01A3B328988DF9D786800F0057EF8260655",
+      "3A2AB22742D0B9052F49ACC952986C6E1E5124C2585DF2A2A9716362AE7E5E49",
+      "515209F1853892190C81538390DD62F31A0D84CBC3A56F3BFC92233218BD1F8F",
+      "1CA9B64E7DBEF766C051FB0344C28322E8992276FEB6B35BBF5E0F7B914F652B"
+   },
+};
+
+#define CURVES (int)(sizeof(curves) / sizeof(curves[0]))
+
+// k * G and the sum of two products with back end red, p allocated in size bytes. Returns the mismatches.
+static int check(int c, int red, int size)
+{
+   ec_group_t g;
+   ec_point_t *G = ec_point_alloc(size), *Q = ec_point_alloc(size), *R = ec_point_alloc(size);
+   bn_t *k = bn_from_str(bn_alloc(size), curves[c].k), *k2 = bn_alloc(size), *x = bn_alloc(size);
+   int bad = 0;
+
+   g.p = bn_from_str(bn_alloc(size), curves[c].p);
+   g.a = bn_to_mon(bn_from_str(bn_alloc(size), curves[c].a), g.p);
+   g.b = bn_to_mon(bn_from_str(bn_alloc(size), curves[c].b), g.p);
+   g.red = red;
+
+   ec_group_setup(&g);
+
+   // The requested back end if it works for p, the detected one if not
+   int ok = red == EC_RED_MON || (red == curves[c].red && size == curves[c].size);
+
+   bad += g.red != (ok ? red : ec_group_red(g.p));
+
+   bn_from_str(G->x, curves[c].gx);
+   bn_from_str(G->y, curves[c].gy);
+   ec_point_to_mon(G, &g);
+
+   ec_point_mul(R, k, G, &g);
+   ec_point_from_mon(R, &g);
+   bad += bn_cmp(R->x, bn_from_str(x, curves[c].x)) != BN_CMP_E;
+   bad += bn_cmp(R->y, bn_from_str(x, curves[c].y)) != BN_CMP_E;
+
+   ec_point_mul(Q, bn_set_ui(k2, 3), G, &g);
+   ec_point_mul2(R, k, G, bn_from_str(k2, curves[c].k2), Q, &g);
+   ec_point_from_mon(R, &g);
+   bad += bn_cmp(R->x, bn_from_str(x, curves[c].x2)) != BN_CMP_E;
+   bad += bn_cmp(R->y, bn_from_str(x, curves[c].y2)) != BN_CMP_E;
+
+   ec_point_free(G);
+   ec_point_free(Q);
+   ec_point_free(R);
+
+   bn_free(g.p);
+   bn_free(g.a);
+   bn_free(g.b);
+   bn_free(k);
+   bn_free(k2);
+   bn_free(x);
+
+   return bad;
+}
+
+int main()
+{
+   for(int c = 0; c < CURVES; c++)
+   {
+      int size = curves[c].size, bad = 0;
+
+      // Its own back end, Montgomery, detected, and one for another prime
+      bad += check(c, curves[c].red, size);
+      bad += check(c, EC_RED_MON, size);
+      bad += check(c, EC_RED_AUTO, size);
+      bad += check(c, curves[c].red == EC_RED_P521 ? EC_RED_P256 : EC_RED_P521, size);
+
+      // A p one limb wider than the fixed-width elements, its own back end must not be taken
+      bad += check(c, curves[c].red, size + BN_LIMB_BYTES);
+
+      printf("%s %s\n", curves[c].name, bad ? "MISMATCH" : "OK");
+   }
+
+   return 0;
+}
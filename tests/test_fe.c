@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include "fe.h"
+#include "mt19937.h"
+
+#define ROUNDS 200
+
+static mt19937_ctxt_t mt;
+
+// Random A < N, of the size of N
+static bn_t *rand_below(bn_t *a, bn_t *n)
+{
+   s8 buf[LIMBS_TO_BYTES(n->n_limbs)];
+
+   for(int i = 0; i < (int)sizeof(buf); i++)
+      buf[i] = (s8)mt19937_update(&mt);
+
+   bn_zero(a);
+   bn_from_bin(a, buf, sizeof(buf));
+
+   while(bn_cmp(a, n) >= 0)
+      bn_rshift(a, 1);
+
+   return a;
+}
+
+// Every fe<bits> operation against bn_* modulo P, on random elements. Returns the mismatches.
+#define CHECK_DEFINE(bits)                                                        \
+static int check##bits(const s8 *ps)                                              \
+{                                                                                 \
+   bn_t *p = bn_from_str(bn_alloc_limbs(FE_LIMBS(bits)), ps);                     \
+   bn_t *a = bn_alloc_limbs(FE_LIMBS(bits)), *b = bn_alloc_limbs(FE_LIMBS(bits)); \
+   bn_t *d = bn_alloc_limbs(FE_LIMBS(bits)), *r = bn_alloc_limbs(FE_LIMBS(bits)); \
+   fe##bits##_mod_t m;                                                            \
+   fe##bits##_t x, y, z;                                                          \
+   int bad = 0;                                                                   \
+                                                                                  \
+   fe##bits##_mod_init(&m, p);                                                    \
+                                                                                  \
+   for(int i = 0; i < ROUNDS; i++)                                                \
+   {                                                                              \
+      rand_below(a, p);                                                           \
+      rand_below(b, p);                                                           \
+                                                                                  \
+      /* The extremes as well */                                                  \
+      if(i == 0)                                                                  \
+         bn_zero(a);                                                              \
+      if(i == 1)                                                                  \
+         bn_sub_ui(a, bn_zero(a), 1, p);                                          \
+      if(i == 1)                                                                  \
+         bn_copy(b, a);                                                           \
+                                                                                  \
+      fe##bits##_load(&x, a);                                                     \
+      fe##bits##_load(&y, b);                                                     \
+                                                                                  \
+      fe##bits##_add(&z, &x, &y, &m);                                             \
+      bad += bn_cmp(fe##bits##_store(d, &z), bn_add(r, a, b, p)) != BN_CMP_E;     \
+                                                                                  \
+      fe##bits##_sub(&z, &x, &y, &m);                                             \
+      bad += bn_cmp(fe##bits##_store(d, &z), bn_sub(r, a, b, p)) != BN_CMP_E;     \
+                                                                                  \
+      fe##bits##_mon_mul(&z, &x, &y, &m);                                         \
+      bad += bn_cmp(fe##bits##_store(d, &z), bn_mon_mul(r, a, b, p)) != BN_CMP_E; \
+                                                                                  \
+      fe##bits##_mon_sqr(&z, &x, &m);                                             \
+      bad += bn_cmp(fe##bits##_store(d, &z), bn_mon_sqr(r, a, p)) != BN_CMP_E;    \
+                                                                                  \
+      /* In place */                                                              \
+      fe##bits##_mon_mul(&x, &x, &y, &m);                                         \
+      bad += bn_cmp(fe##bits##_store(d, &x), bn_mon_mul(r, a, b, p)) != BN_CMP_E; \
+                                                                                  \
+      fe##bits##_sub(&x, &y, &y, &m);                                             \
+      bad += !fe##bits##_is_zero(&x);                                             \
+   }                                                                              \
+                                                                                  \
+   bn_free(p);                                                                    \
+   bn_free(a);                                                                    \
+   bn_free(b);                                                                    \
+   bn_free(d);                                                                    \
+   bn_free(r);                                                                    \
+                                                                                  \
+   return bad;                                                                    \
+}
+
+CHECK_DEFINE(256)
+CHECK_DEFINE(384)
+CHECK_DEFINE(521)
+
+int main()
+{
+   mt19937_init(&mt, 20);
+
+   // The curve primes, and an odd modulus of each width that is not special at all
+   int bad = check256("FFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFF") +
+             check256("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F") +
+             check256("C90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B23");
+
+   printf("%s\n", bad ? "FE256 MISMATCH" : "FE256 OK");
+
+   bad = check384("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFE"
+                  "FFFFFFFF0000000000000000FFFFFFFF") +
+         check384("A2C5E3B1D9F7061E4D3C2B1A0F9E8D7C6B5A49382716F5E4D3C2B1A09F8E7D6C"
+                  "5B4A39281706F5E4D3C2B1A09F8E7D6D");
+
+   printf("%s\n", bad ? "FE384 MISMATCH" : "FE384 OK");
+
+   bad = check521("01FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+                  "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF") +
+         check521("0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF01"
+                  "23456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123");
+
+   printf("%s\n", bad ? "FE521 MISMATCH" : "FE521 OK");
+
+   return 0;
+}
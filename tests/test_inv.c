@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include "bn.h"
+
+// A, N and A**-1 % N (0 when there is none): odd moduli of growing size,
+// then an even one, the extremes of A and two with gcd(A, N) != 1
+static const s8 *vec[][3] =
+{
+   { "DB5B5FAB8F4D3E28",
+     "DDA1494C73CF256D",
+     "3DF6C575F6EFC40A" },
+   { "184EB5BC965EDA32DAE445508201E2BE",
+     "79D5A43B7734D7C1C7FDE805EC99108D",
+     "73508712A197F381E3A2A748CF37825F" },
+   { "73F778AAF6FA5DB8656ABD72FB710734986E86CB0AB8AB67A26B7F62B1852F28",
+     "AFA91425CB0088539D2C67EDA13FFE7979CB9E86830C71C2CDCC69292F45E679",
+     "689B5F227D5AB8FBE5277A955E8F3C549A2C3691892C5D61021C86F56EC4B6D1" },
+   { "15C1D2DFA9964AEF012D0EA67FF122294B4D8474A3EA284D3BD0334684E55160320094EAD7A94DED97491E2370C6A5B85387F61376C468AEC7321CC007B37E15",
+     "998092253DEFFA38E12B2B8F30B17D0B09208A650F3EBDD3102B938B8743FEB6D4EA65D003D716849F8558A628518867A66B0D389D95847EBD299753A7677797",
+     "80E0A91D12CB48C36BCE9C56562FF74FF554174062B06420EF7859FD4314085155FE60965628AF86A9E43839299206ADFE4B548D2929746233ACE950C5AE2B6F" },
+   { "97BDD982CDAC6046F9903B72F88ECE64DD44FD3645114889001EDC8E367E5D6DFD7410696BB6A3DE65151C401DD377BF623D8EB7A4CA83B26B52B08D21870F0BC4FF64DEBB5D6B48FC3B66FA30D0B19482450164728A6FCF303A07B28F2DF760AE9CA08B2D7C50487CA07386CC099A1E77064C2C0F552C9402CDF2AF19DE2BC2",
+     "AF5570EED8E94B150452EF05F542441D111B8AAA62F28D1A4A789CB3D8B9B45C1B98FBE466809A111BA1192EC42B7170902A174F11FA2AC0079DD25A49FE85B0834C687A3ACB6266C20BA2C250B601FC4105CCA7B53302FC154CD2AAD7185DDAEE82EC3FFEE5A5B28D1FE1DAFF6665896822A6B24735AF1CA7A1149075139237",
+     "9389954A08735B3910E78BB6C47AD020E802A08C0EED5E673F0AFCDDCE115271F220E24763F319969D7CEB2254349F2790E0B40FA01267A53E40032EEEED7B703949411252D6094E19BE6B81345DA8B9773DBADF5F51DE7969EFE3C7CA45C1F3AE6FC8245D2F980267962C2B6745BF148389837AF3A79F3899A0AEEC6E6D6EDD" },
+   { "62D74145DDD4A05422BFB8E0931719FDD5157E9D7BD55EE6965768E0F589D99A20918FA7740572419F452C075F27FF09",
+     "93B3A3D9A44F576A9A1DE24EDAB871D5FEEF16E964EF2EBE2FF3600735F11AF2050684BFE286852CFF769E374DDC74C8",
+     "5A64AEA1CEE11CE208F4CDDDF8663B1E9F35C5A29D1142F73D54B260696D50B11BF41F0235B018A81E0D9939AA1ABB21" },
+   { "01",
+     "D13A775505E88E752F4F91540C27756991A0931ED42ECDCC0B",
+     "01" },
+   { "F0BE600DA104A795BD4AEAB02891DD3C3096C6C8B9B338EB3FDF23489C461CB4",
+     "F0BE600DA104A795BD4AEAB02891DD3C3096C6C8B9B338EB3FDF23489C461CB5",
+     "F0BE600DA104A795BD4AEAB02891DD3C3096C6C8B9B338EB3FDF23489C461CB4" },
+   { "388395",
+     "0A2A2F8880CE1F217A372F8098D6245691589298D362",
+     "00" },
+   { "0C3B701296A77F21729F7F6CBC48CF0E66875BB96A7892987D9F074F78E525180D4B0B205A",
+     "39EB4B7CB081AEEA3485072621B99102776ED17D470EF595A4ECF42103ED054D8D8FD9C92E82",
+     "00" },
+};
+
+#define VECS (int)(sizeof(vec) / sizeof(vec[0]))
+
+// Inputs of the batch inversion test
+#define BATCH 9
+
+int main()
+{
+   bn_t *a = bn_alloc(128), *n = bn_alloc(128), *d = bn_alloc(128), *e = bn_alloc(128);
+   int bad = 0;
+
+   for(int i = 0; i < VECS; i++)
+   {
+      bn_from_str(bn_zero(a), vec[i][0]);
+      bn_ctxt_invalidate(n);
+      bn_from_str(bn_zero(n), vec[i][1]);
+      bn_from_str(bn_zero(e), vec[i][2]);
+
+      bn_inv(d, a, n);
+      bad += bn_cmp(d, e) != BN_CMP_E;
+   }
+
+   printf("%s\n", bad ? "INV MISMATCH" : "INV OK");
+
+   // Same in Montgomery form (safegcd), which needs an odd N and an inverse to exist
+   bad = 0;
+
+   for(int i = 0; i < VECS; i++)
+   {
+      bn_from_str(bn_zero(a), vec[i][0]);
+      bn_ctxt_invalidate(n);
+      bn_from_str(bn_zero(n), vec[i][1]);
+      bn_from_str(bn_zero(e), vec[i][2]);
+
+      if(!(n->l[0] & 1) || bn_is_zero(e))
+         continue;
+
+      bn_mon_inv(d, bn_to_mon(a, n), n);
+      bad += bn_cmp(bn_from_mon(d, n), e) != BN_CMP_E;
+   }
+
+   printf("%s\n", bad ? "MON INV MISMATCH" : "MON INV OK");
+
+   // A batch modulo the 256-bit N, against one inversion at a time. Zeros at both ends
+   // and in the middle have to come out as zeros, and half the batch is inverted in place
+   bn_t *in[BATCH], *out[BATCH], *ref[BATCH];
+
+   bn_ctxt_invalidate(n);
+   bn_from_str(bn_zero(n), vec[2][1]);
+   bad = 0;
+
+   for(int i = 0; i < BATCH; i++)
+   {
+      in[i] = bn_alloc(128);
+      out[i] = (i & 1) ? in[i] : bn_alloc(128);
+      ref[i] = bn_alloc(128);
+
+      if(i == 0 || i == BATCH / 2 || i == BATCH - 1)
+         continue;
+
+      bn_to_mon(bn_set_ui(in[i], 1000003 * i * i + 7), n);
+      bn_mon_inv(ref[i], in[i], n);
+   }
+
+   bn_mon_inv_batch(out, in, BATCH, n);
+
+   for(int i = 0; i < BATCH; i++)
+   {
+      bad += bn_cmp(out[i], ref[i]) != BN_CMP_E;
+
+      if(out[i] != in[i])
+         bn_free(out[i]);
+
+      bn_free(in[i]);
+      bn_free(ref[i]);
+   }
+
+   printf("%s\n", bad ? "MON INV BATCH MISMATCH" : "MON INV BATCH OK");
+
+   bn_free(a);
+   bn_free(n);
+   bn_free(d);
+   bn_free(e);
+
+   return 0;
+}
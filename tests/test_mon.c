@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "bn.h"
+
+#define THREADS 8
+
+static bn_t *tn, *ta, *te, *tw, *td[THREADS], *tq[THREADS];
+
+// Every thread raises A to E and reduces W modulo the same N, whose contexts none of them
+// has built yet
+static void *pow_thread(void *arg)
+{
+   bn_pow_mod(td[(size_t)arg], ta, te, tn);
+   bn_reduce(bn_copy(tq[(size_t)arg], tw), tn);
+
+   return arg;
+}
+
+int main()
+{
+   bn_t *n = bn_set_ui(bn_alloc(8), 97);
+   bn_t *m = bn_set_ui(bn_alloc(8), 101);
+   bn_t *a = bn_set_ui(bn_alloc(8), 5);
+   bn_t *e = bn_set_ui(bn_alloc(8), 3);
+   bn_t *d = bn_alloc(8);
+   int bad = 0;
+
+   // 5^3 % 97 = 28, building the Montgomery context of n
+   bn_pow_mod(d, a, e, n);
+   printf("%s\n", bn_cmp_ui(d, 28) == BN_CMP_E ? "POW OK" : "POW MISMATCH");
+
+   // The same bignum reused as another modulus: 5^3 % 101 = 24
+   bn_ctxt_invalidate(n);
+   bn_copy(n, m);
+   bn_pow_mod(d, a, e, n);
+   printf("%s\n", bn_cmp_ui(d, 24) == BN_CMP_E ? "POW (new modulus) OK" : "POW (new modulus) MISMATCH");
+
+   // Same through the Montgomery primitives
+   bn_to_mon(bn_set_ui(d, 5), n);
+   bn_mon_sqr(d, d, n);
+   bn_mon_mul(d, d, bn_to_mon(bn_set_ui(a, 5), n), n);
+   bn_from_mon(d, n);
+   printf("%s\n", bn_cmp_ui(d, 24) == BN_CMP_E ? "MON OK" : "MON MISMATCH");
+
+   // Threads racing on the first use of a modulus all get the same results
+   tn = bn_from_str(bn_alloc(128), "C90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22"
+                                   "514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245"
+                                   "E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7EDEE386BFB5A899FA5"
+                                   "AE9F24117C4B1FE649286651ECE65381FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+   ta = bn_set_ui(bn_alloc(128), 2);
+   te = bn_from_str(bn_alloc(128), "F1A3A3B7A5F62B4C8E3D5E5A9AB2C6EEC7E5AB8E33D3C1A4B5E3C3A7D9E1F4C3");
+   tw = bn_from_str(bn_alloc(256), "C90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22"
+                                   "514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245"
+                                   "E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7EDEE386BFB5A899FA5"
+                                   "AE9F24117C4B1FE649286651ECE65381FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+                                   "F1A3A3B7A5F62B4C8E3D5E5A9AB2C6EEC7E5AB8E33D3C1A4B5E3C3A7D9E1F4C3");
+   bn_t *r = bn_alloc(128), *c = bn_copy(bn_alloc(128), tn), *q = bn_copy(bn_alloc(256), tw);
+
+   bn_pow_mod(r, ta, te, c);
+   bn_reduce_slow(q, c);
+
+   for(int i = 0; i < THREADS; i++)
+   {
+      td[i] = bn_alloc(128);
+      tq[i] = bn_alloc(256);
+   }
+
+   for(int k = 0; k < 20; k++)
+   {
+      pthread_t t[THREADS];
+
+      for(size_t i = 0; i < THREADS; i++)
+         pthread_create(&t[i], NULL, pow_thread, (void *)i);
+
+      for(int i = 0; i < THREADS; i++)
+      {
+         pthread_join(t[i], NULL);
+         bad += bn_cmp(td[i], r) != BN_CMP_E || bn_cmp(tq[i], q) != BN_CMP_E;
+      }
+
+      bn_ctxt_invalidate(tn);
+   }
+
+   printf("%s\n", bad ? "THREADS MISMATCH" : "THREADS OK");
+
+   for(int i = 0; i < THREADS; i++)
+   {
+      bn_free(td[i]);
+      bn_free(tq[i]);
+   }
+
+   bn_free(n);
+   bn_free(m);
+   bn_free(a);
+   bn_free(e);
+   bn_free(d);
+   bn_free(tn);
+   bn_free(ta);
+   bn_free(te);
+   bn_free(tw);
+   bn_free(r);
+   bn_free(c);
+   bn_free(q);
+
+   return 0;
+}
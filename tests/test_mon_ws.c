@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bn.h"
+#include "mt19937.h"
+
+#define ROUNDS 4
+
+static mt19937_ctxt_t mt;
+
+// Random limbs in every limb of A
+static bn_t *rand_bn(bn_t *a)
+{
+   s8 buf[LIMBS_TO_BYTES(a->n_limbs)];
+
+   for(int i = 0; i < (int)sizeof(buf); i++)
+      buf[i] = (s8)mt19937_update(&mt);
+
+   return bn_from_bin(bn_zero(a), buf, sizeof(buf));
+}
+
+// The workspace entry points against their allocating counterparts, for an nl limb modulus. The
+// workspaces have exactly the advertised size and start out as garbage. Returns the mismatches.
+static int check(int nl)
+{
+   bn_t *n = rand_bn(bn_alloc_limbs(nl)), *a = bn_alloc_limbs(nl), *b = bn_alloc_limbs(nl);
+   bn_t *e = bn_alloc_limbs(nl), *d = bn_alloc_limbs(nl), *r = bn_alloc_limbs(nl);
+   ul_t *ws = malloc(LIMBS_TO_BYTES(BN_MON_WS_LIMBS(nl)));
+   ul_t *pw = malloc(LIMBS_TO_BYTES(BN_MON_POW_WS_LIMBS(nl)));
+   int bad = 0;
+
+   bn_setbit(n, 0);
+   bn_setbit(n, nl * BN_LIMB_BITS - 1);
+
+   for(int i = 0; i < ROUNDS; i++)
+   {
+      memset(ws, 0xA5, LIMBS_TO_BYTES(BN_MON_WS_LIMBS(nl)));
+      memset(pw, 0x5A, LIMBS_TO_BYTES(BN_MON_POW_WS_LIMBS(nl)));
+
+      bn_reduce(rand_bn(a), n);
+      bn_reduce(rand_bn(b), n);
+
+      bn_mon_mul_ws(d, a, b, n, ws);
+      bad += bn_cmp(d, bn_mon_mul(r, a, b, n)) != BN_CMP_E;
+
+      bn_mon_sqr_ws(d, a, n, ws);
+      bad += bn_cmp(d, bn_mon_sqr(r, a, n)) != BN_CMP_E;
+      bad += bn_cmp(d, bn_mon_mul(r, a, a, n)) != BN_CMP_E;
+
+      // Exponents of half the size, all ones, and zero
+      rand_bn(e);
+      bn_rshift(e, i == 1 ? 0 : nl * BN_LIMB_BITS / 2);
+
+      if(i == 2)
+         bn_sub_ui(e, bn_zero(e), 1, n);
+      if(i == 3)
+         bn_zero(e);
+
+      bn_from_mon(bn_mon_pow_ws(d, bn_to_mon(bn_copy(r, a), n), e, n, pw), n);
+      bad += bn_cmp(d, bn_pow_mod(r, a, e, n)) != BN_CMP_E;
+   }
+
+   free(ws);
+   free(pw);
+
+   bn_free(n);
+   bn_free(a);
+   bn_free(b);
+   bn_free(e);
+   bn_free(d);
+   bn_free(r);
+
+   return bad;
+}
+
+int main()
+{
+   // Below and above the size from which the products need multiplication scratch
+   const int sizes[] = { 1, 5, BN_MON_KARATSUBA_THRESHOLD - 1, BN_MON_KARATSUBA_THRESHOLD, BN_MON_KARATSUBA_THRESHOLD + 9 };
+   int bad = 0;
+
+   mt19937_init(&mt, 2);
+
+   for(int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+      bad += check(sizes[s]);
+
+   printf("%s\n", bad ? "MON WS MISMATCH" : "MON WS OK");
+
+   return 0;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+
+// Thresholds low enough for every multiplication tier to run on small operands
+#define BN_KARATSUBA_THRESHOLD 4
+#define BN_TOOM3_THRESHOLD 12
+#define BN_NTT_THRESHOLD 40
+#define BN_MON_KARATSUBA_THRESHOLD 4
+
+// The tiers are internal, so build them in with these thresholds
+#include "bn.c"
+#include "mt19937.h"
+
+#define MAX_LIMBS 160
+
+static mt19937_ctxt_t mt;
+
+// Random limbs, or all ones to get the most carries
+static void rand_limbs(ul_t *a, int nl, int ones)
+{
+   for(int i = 0; i < nl; i++)
+   {
+      u64 v = ((u64)mt19937_update(&mt) << 32) | mt19937_update(&mt);
+
+      a[i] = ones ? (ul_t)-1 : (ul_t)v;
+   }
+}
+
+// Tier a size nl runs on: 0 schoolbook, 1 Karatsuba, 2 Toom-3, 3 NTT
+static int tier(int nl)
+{
+   return (nl >= BN_NTT_THRESHOLD) + (nl >= BN_TOOM3_THRESHOLD) + (nl >= BN_KARATSUBA_THRESHOLD);
+}
+
+int main()
+{
+   static const char *name[4] = { "SCHOOLBOOK", "KARATSUBA", "TOOM-3", "NTT" };
+   static ul_t a[MAX_LIMBS], b[MAX_LIMBS], d[2 * MAX_LIMBS], r[2 * MAX_LIMBS], ws[_BN_MUL_WS_LIMBS(MAX_LIMBS)];
+   int bad[4] = { 0 }, sqr[4] = { 0 };
+
+   mt19937_init(&mt, 1);
+
+   // Every size up to MAX_LIMBS against schoolbook, products and squares
+   for(int nl = 1; nl <= MAX_LIMBS; nl++)
+   {
+      for(int ones = 0; ones < 2; ones++)
+      {
+         rand_limbs(a, nl, ones);
+         rand_limbs(b, nl, ones);
+
+         _bn_mul_limbs(r, a, nl, b, nl);
+         _bn_mul_n(d, a, b, nl, ws);
+         bad[tier(nl)] += memcmp(d, r, 2 * nl * BN_LIMB_BYTES) != 0;
+
+         _bn_mul_limbs(r, a, nl, a, nl);
+         _bn_sqr_n(d, a, nl, ws);
+         sqr[tier(nl)] += memcmp(d, r, 2 * nl * BN_LIMB_BYTES) != 0;
+      }
+   }
+
+   for(int i = 1; i < 4; i++)
+   {
+      printf("%s %s\n", name[i], bad[i] ? "MISMATCH" : "OK");
+      printf("%s (squares) %s\n", name[i], sqr[i] ? "MISMATCH" : "OK");
+   }
+
+   // bn_mul on unbalanced operands, in chunks of the shorter one
+   int mb = 0;
+   bn_t *x = bn_alloc_limbs(MAX_LIMBS), *y = bn_alloc_limbs(MAX_LIMBS), *z = bn_alloc_limbs(2 * MAX_LIMBS);
+
+   for(int an = 1; an <= MAX_LIMBS; an += 13)
+   {
+      for(int bl = 1; bl <= an; bl += 7)
+      {
+         bn_zero(x);
+         bn_zero(y);
+         rand_limbs(a, an, 0);
+         rand_limbs(b, bl, 0);
+
+         _bn_mul_limbs(r, a, an, b, bl);
+         bn_mul(z, _bn_store_limbs(x, a, an), _bn_store_limbs(y, b, bl));
+         mb += memcmp(z->l, r, (an + bl) * BN_LIMB_BYTES) != 0;
+      }
+   }
+
+   printf("BN_MUL %s\n", mb ? "MISMATCH" : "OK");
+
+   // Montgomery products on the Karatsuba path, against a plain product and reduction
+   int mm = 0;
+
+   for(int nl = BN_MON_KARATSUBA_THRESHOLD; nl <= 64; nl += 5)
+   {
+      bn_t *n = bn_alloc_limbs(nl), *p = bn_alloc_limbs(nl), *q = bn_alloc_limbs(nl);
+      bn_t *w = bn_alloc_limbs(2 * nl), *v = bn_alloc_limbs(nl);
+
+      rand_limbs(a, nl, 0);
+      a[0] |= 1;
+      a[nl - 1] |= (ul_t)1 << (BN_LIMB_BITS - 1);
+      _bn_store_limbs(n, a, nl);
+
+      rand_limbs(a, nl, 0);
+      rand_limbs(b, nl, 0);
+      bn_reduce(_bn_store_limbs(p, a, nl), n);
+      bn_reduce(_bn_store_limbs(q, b, nl), n);
+
+      bn_reduce(bn_mul(w, p, q), n);
+
+      bn_to_mon(p, n);
+      bn_to_mon(q, n);
+      bn_from_mon(bn_mon_mul(v, p, q, n), n);
+      mm += bn_cmp(v, w) != BN_CMP_E;
+
+      bn_from_mon(p, n);
+      bn_reduce(bn_mul(w, p, p), n);
+
+      bn_to_mon(p, n);
+      bn_from_mon(bn_mon_sqr(v, p, n), n);
+      mm += bn_cmp(v, w) != BN_CMP_E;
+
+      bn_free(n);
+      bn_free(p);
+      bn_free(q);
+      bn_free(w);
+      bn_free(v);
+   }
+
+   printf("MONTGOMERY (Karatsuba) %s\n", mm ? "MISMATCH" : "OK");
+
+   bn_free(x);
+   bn_free(y);
+   bn_free(z);
+
+   return 0;
+}
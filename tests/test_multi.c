@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include "bn.h"
+
+// Enough bases for Pippenger to beat Straus
+#define MAX_BASES 400
+
+int main()
+{
+   bn_t *n = bn_from_str(bn_alloc(32), "D526CA59E01656388D727223E4727ACEFB7C236072DE2F0ADD2835F2BCE8A787");
+   bn_t *a[MAX_BASES], *e[MAX_BASES];
+   bn_t *d = bn_alloc(32), *r = bn_alloc(32), *t = bn_alloc(32);
+   int bad = 0;
+
+   for(int i = 0; i < MAX_BASES; i++)
+   {
+      a[i] = bn_set_ui(bn_alloc(32), 3 + 2 * i);
+      e[i] = bn_alloc(32);
+
+      // Exponents of assorted sizes, some of them zero
+      for(int x = 0; x < (i * 37) % 256; x += 1 + i % 5)
+         bn_setbit(e[i], x);
+   }
+
+   // Few bases take Straus, many Pippenger
+   static const int ks[] = { 1, 2, 7, 33, MAX_BASES };
+
+   for(int j = 0; j < (int)(sizeof(ks) / sizeof(ks[0])); j++)
+   {
+      int k = ks[j];
+
+      bn_set_ui(r, 1);
+
+      for(int i = 0; i < k; i++)
+      {
+         bn_pow_mod(t, a[i], e[i], n);
+         bn_from_mon(bn_mon_mul(r, bn_to_mon(r, n), bn_to_mon(t, n), n), n);
+      }
+
+      for(int i = 0; i < k; i++)
+         bn_to_mon(a[i], n);
+
+      bn_from_mon(bn_mon_pow_multi(d, a, e, k, n), n);
+      bad += bn_cmp(d, r) != BN_CMP_E;
+
+      for(int i = 0; i < k; i++)
+         bn_from_mon(a[i], n);
+   }
+
+   printf("%s\n", bad ? "POW MULTI MISMATCH" : "POW MULTI OK");
+
+   for(int i = 0; i < MAX_BASES; i++)
+   {
+      bn_free(a[i]);
+      bn_free(e[i]);
+   }
+
+   bn_free(n);
+   bn_free(d);
+   bn_free(r);
+   bn_free(t);
+
+   return 0;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "bn.h"
+
+// Blocks handed from one thread to another, more than a thread caches
+#define BLOCKS 256
+#define SIZE 200
+
+#define THREADS 4
+#define ROUNDS 20000
+#define LIVE 200
+
+static u8 *blocks[BLOCKS];
+
+// Counters of the thread that ran the worker
+static pool_stats_t worker_stats;
+
+static void *alloc_blocks(void *arg)
+{
+   for(int i = 0; i < BLOCKS; i++)
+      memset(blocks[i] = pool_alloc(SIZE), i, SIZE);
+
+   pool_stats(&worker_stats);
+
+   return arg;
+}
+
+// Take the blocks another thread freed, then free them here
+static void *reuse_blocks(void *arg)
+{
+   u8 *got[BLOCKS];
+   int *bad = arg;
+
+   for(int i = 0; i < BLOCKS; i++)
+   {
+      int found = 0;
+
+      got[i] = pool_alloc(SIZE);
+
+      for(int j = 0; j < BLOCKS; j++)
+         found += got[i] == blocks[j];
+
+      *bad += found != 1;
+   }
+
+   pool_stats(&worker_stats);
+
+   for(int i = 0; i < BLOCKS; i++)
+      pool_free(got[i]);
+
+   return arg;
+}
+
+// Blocks of assorted classes, tagged with their owner, spilled to and refilled from the depot
+static void *churn(void *arg)
+{
+   size_t tag = (size_t)arg;
+   size_t *live[LIVE] = { NULL };
+   int bad = 0;
+
+   for(int i = 0; i < ROUNDS; i++)
+   {
+      int j = (i * 7919) % LIVE;
+
+      if(live[j] != NULL)
+      {
+         bad += live[j][0] != tag || live[j][1] != (size_t)j;
+         pool_free(live[j]);
+      }
+
+      live[j] = pool_alloc(16 + (i % 8) * 16);
+      live[j][0] = tag;
+      live[j][1] = j;
+   }
+
+   for(int j = 0; j < LIVE; j++)
+   {
+      bad += live[j][0] != tag || live[j][1] != (size_t)j;
+      pool_free(live[j]);
+   }
+
+   return (void *)(size_t)bad;
+}
+
+int main()
+{
+   pool_stats_t s0, s1;
+   int bad[4] = { 0 };
+   u8 *p, *q;
+
+   // The last block freed is the next one of its class, a block of another class is not
+   pool_stats(&s0);
+
+   p = pool_alloc(40);
+   pool_free(p);
+   q = pool_alloc(33);
+   bad[0] += q != p || (size_t)q % 16 != 0;
+   bad[0] += (q = pool_alloc(100)) == p;
+   pool_free(q);
+
+   pool_stats(&s1);
+   bad[0] += s1.misses - s0.misses != 2 || s1.hits - s0.hits != 1;
+
+   printf("%s\n", bad[0] ? "REUSE MISMATCH" : "REUSE OK");
+
+   // Realloc: in place within the class, by copy to a bigger class or a large block
+   memset(p, 0xA5, 48);
+
+   bad[1] += pool_realloc(p, 48) != p;
+
+   q = pool_realloc(p, 1000);
+   p = pool_realloc(q, 5000);
+
+   for(int i = 0; i < 48; i++)
+      bad[1] += p[i] != 0xA5;
+
+   memset(p, 0x5A, 5000);
+   p = pool_realloc(p, 10000);
+
+   for(int i = 0; i < 5000; i++)
+      bad[1] += p[i] != 0x5A;
+
+   pool_free(p);
+   pool_free(pool_alloc(BN_POOL_MAX_BYTES + 1));
+
+   pool_stats(&s0);
+   bad[1] += s0.large - s1.large != 2;
+
+   printf("%s\n", bad[1] ? "REALLOC MISMATCH" : "REALLOC OK");
+
+   // Blocks allocated on one thread and freed on another go to the depot, and a third thread
+   // takes them from there without any malloc
+   pthread_t t[THREADS];
+
+   pthread_create(&t[0], NULL, alloc_blocks, NULL);
+   pthread_join(t[0], NULL);
+
+   bad[2] += worker_stats.misses != BLOCKS;
+
+   for(int i = 0; i < BLOCKS; i++)
+   {
+      for(int j = 0; j < SIZE; j++)
+         bad[2] += blocks[i][j] != (u8)i;
+
+      pool_free(blocks[i]);
+   }
+
+   pool_stats(&s1);
+   bad[2] += s1.depot_puts == s0.depot_puts;
+
+   pool_flush();
+   pool_stats(&s0);
+   bad[2] += s0.cached != 0;
+
+   pthread_create(&t[0], NULL, reuse_blocks, &bad[2]);
+   pthread_join(t[0], NULL);
+
+   pool_stats(&s1);
+   bad[2] += worker_stats.misses != 0 || worker_stats.refills == 0 || s1.depot_gets == s0.depot_gets;
+
+   // That thread gave them back on exit, the flushed cache here has none of its own
+   pool_free(pool_alloc(SIZE));
+
+   pool_stats(&s0);
+   bad[2] += s0.refills != s1.refills + 1 || s0.hits != s1.hits;
+
+   printf("%s\n", bad[2] ? "DEPOT MISMATCH" : "DEPOT OK");
+
+   // Threads racing on the depot never get the same block
+   for(size_t i = 0; i < THREADS; i++)
+      pthread_create(&t[i], NULL, churn, (void *)(i + 1));
+
+   for(int i = 0; i < THREADS; i++)
+   {
+      void *r;
+
+      pthread_join(t[i], &r);
+      bad[3] += (int)(size_t)r;
+   }
+
+   printf("%s\n", bad[3] ? "THREADS MISMATCH" : "THREADS OK");
+
+   return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Built together with bn.c, so that the IFMA code can be switched off below
+#include "bn.c"
+#include "mt19937.h"
+
+// Moduli of 512 to 4096 bits, and how many of each size the batch gets. The
+// counts are not multiples of the 8 IFMA lanes.
+static const int bits[] = { 512, 1024, 1536, 2048, 3072, 4096 };
+static const int count[] = { 3, 1, 2, 11, 1, 9 };
+
+#define SIZES (int)(sizeof(bits) / sizeof(bits[0]))
+#define CNT 27
+
+static mt19937_ctxt_t mt;
+
+// Random limbs in every limb of A
+static bn_t *rand_bn(bn_t *a)
+{
+   s8 buf[LIMBS_TO_BYTES(a->n_limbs)];
+
+   for(int i = 0; i < (int)sizeof(buf); i++)
+      buf[i] = (s8)mt19937_update(&mt);
+
+   return bn_from_bin(bn_zero(a), buf, sizeof(buf));
+}
+
+// The batch against bn_pow_mod one at a time. Returns the mismatches.
+static int check(bn_t **d, bn_t **a, bn_t **e, bn_t **n, bn_t **r)
+{
+   int bad = 0;
+
+   for(int i = 0; i < CNT; i++)
+      bn_zero(d[i]);
+
+   bn_pow_mod_batch(d, a, e, n, CNT);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(d[i], r[i]) != BN_CMP_E;
+
+   return bad;
+}
+
+int main()
+{
+   bn_t *d[CNT], *a[CNT], *e[CNT], *n[CNT], *r[CNT];
+   int bad = 0, k = 0;
+
+   mt19937_init(&mt, 8);
+
+   for(int s = 0; s < SIZES; s++)
+   {
+      for(int j = 0; j < count[s]; j++, k++)
+      {
+         int nl = bits[s] / BN_LIMB_BITS;
+
+         n[k] = rand_bn(bn_alloc_limbs(nl));
+         a[k] = bn_alloc_limbs(nl);
+         e[k] = bn_alloc_limbs(nl);
+         d[k] = bn_alloc_limbs(nl);
+         r[k] = bn_alloc_limbs(nl);
+
+         bn_setbit(n[k], 0);
+         bn_setbit(n[k], bits[s] - 1);
+         bn_reduce(rand_bn(a[k]), n[k]);
+
+         // Full size exponents, mixed with 0 and 65537 in the same lanes
+         if(j % 4 == 1)
+            bn_zero(e[k]);
+         else if(j % 4 == 2)
+            bn_set_ui(e[k], 65537);
+         else
+            rand_bn(e[k]);
+      }
+   }
+
+   // Shuffle, so that moduli of the same size are scattered across the batch
+   for(int i = CNT - 1; i > 0; i--)
+   {
+      int j = mt19937_update(&mt) % (i + 1);
+      bn_t *t;
+
+      t = n[i], n[i] = n[j], n[j] = t;
+      t = a[i], a[i] = a[j], a[j] = t;
+      t = e[i], e[i] = e[j], e[j] = t;
+      t = d[i], d[i] = d[j], d[j] = t;
+      t = r[i], r[i] = r[j], r[j] = t;
+   }
+
+   // The references, checked against the plain sliding window in turn
+   for(int i = 0; i < CNT; i++)
+   {
+      int nl = n[i]->n_limbs;
+      ul_t *ws = malloc(LIMBS_TO_BYTES(BN_MON_POW_WS_LIMBS(nl)));
+
+      bn_pow_mod(r[i], a[i], e[i], n[i]);
+
+      bn_mon_pow_ws(d[i], bn_to_mon(bn_copy(d[i], a[i]), n[i]), e[i], n[i], ws);
+      bad += bn_cmp(bn_from_mon(d[i], n[i]), r[i]) != BN_CMP_E;
+
+      free(ws);
+   }
+
+   bad += check(d, a, e, n, r);
+
+   printf("%s\n", bad ? "POW BATCH MISMATCH" : "POW BATCH OK");
+
+   // Once more without IFMA, as on CPUs that lack it
+#if defined(BN_X86_64)
+   _bn_has_ifma = 0;
+#endif
+
+   bad = check(d, a, e, n, r);
+
+   printf("%s\n", bad ? "POW BATCH (no IFMA) MISMATCH" : "POW BATCH (no IFMA) OK");
+
+   for(int i = 0; i < CNT; i++)
+   {
+      bn_free(d[i]);
+      bn_free(a[i]);
+      bn_free(e[i]);
+      bn_free(n[i]);
+      bn_free(r[i]);
+   }
+
+   return 0;
+}
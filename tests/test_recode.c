@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include "recode.h"
+
+// Room for the digit positions of every recoding of the scalars below
+#define MAX_BITS 320
+
+static const s8 *scalars[] =
+{
+   "01",
+   "0186A3",
+   "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+   "7FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFED",
+   "8000000000000000000000000000000000000000000000000000000000000001",
+   "C90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22",
+   "5555555555555555555555555555555555555555555555555555555555555555",
+};
+
+#define SCALARS (int)(sizeof(scalars) / sizeof(scalars[0]))
+
+// Signed digits d[i] at bit positions pos(i), summed back up bit by bit
+static int acc[MAX_BITS + 32];
+
+// Does the sum of the digits come back to K?
+static int check_sum(bn_t *k)
+{
+   int c = 0, ok = 1;
+
+   for(int i = 0; i < MAX_BITS + 32; i++)
+   {
+      c += acc[i];
+
+      ok &= (c & 1) == bn_getbit(k, i);
+      c = (c - (c & 1)) / 2;
+      acc[i] = 0;
+   }
+
+   return ok && c == 0;
+}
+
+int main()
+{
+   bn_t *k = bn_alloc((MAX_BITS + 32) / 8);
+   s16 d[MAX_BITS + 32];
+   int bad[5] = { 0 };
+
+   for(int s = 0; s < SCALARS; s++)
+   {
+      bn_from_str(bn_zero(k), scalars[s]);
+
+      // Binary
+      for(int i = 0, n = recode_binary(d, k); i < n; i++)
+      {
+         bad[0] += d[i] != 0 && d[i] != 1;
+         acc[i] += d[i];
+      }
+
+      bad[0] += !check_sum(k);
+
+      for(int w = 1; w <= 15; w++)
+      {
+         // Fixed windows
+         for(int i = 0, n = recode_window(d, k, w); i < n; i++)
+         {
+            bad[1] += d[i] < 0 || d[i] >= 1 << w;
+
+            for(int x = 0; x < w; x++)
+               acc[w * i + x] += (d[i] >> x) & 1;
+         }
+
+         bad[1] += !check_sum(k);
+
+         // Sliding windows: odd digits, each window clear of the next one
+         for(int i = 0, n = recode_sliding(d, k, w), next = 0; i < n; i++)
+         {
+            if(d[i] == 0)
+               continue;
+
+            bad[2] += !(d[i] & 1) || d[i] < 0 || d[i] >= 1 << w || i < next;
+
+            for(next = i; d[i] >> (next - i); next++)
+               ;
+
+            acc[i] += d[i];
+         }
+
+         bad[2] += !check_sum(k);
+
+         // wNAF: odd digits below 2**(w - 1), followed by w - 1 zeroes
+         if(w < 2)
+            continue;
+
+         int n = recode_wnaf(d, k, w);
+
+         for(int i = 0; i < n; i++)
+         {
+            if(d[i] == 0)
+               continue;
+
+            bad[3] += !(d[i] & 1) || d[i] <= -(1 << (w - 1)) || d[i] >= 1 << (w - 1);
+
+            for(int j = i + 1; j < i + w && j < n; j++)
+               bad[3] += d[j] != 0;
+
+            acc[i] += d[i];
+         }
+
+         bad[3] += !check_sum(k);
+      }
+
+      // Comb: bit i of d[c * v + j] is bit i * a + j * b + c of K
+      for(int h = 1; h <= 8; h++)
+      {
+         for(int v = 1; v <= 4; v++)
+         {
+            int a = (bn_maxbit(k) + 1 + h - 1) / h, b = (a + v - 1) / v;
+
+            bad[4] += recode_comb(d, k, h, v, b) != b * v;
+            a = b * v;
+
+            for(int c = 0; c < b; c++)
+               for(int j = 0; j < v; j++)
+                  for(int i = 0; i < h; i++)
+                     acc[i * a + j * b + c] += (d[c * v + j] >> i) & 1;
+
+            bad[4] += !check_sum(k);
+         }
+      }
+   }
+
+   // K = 0 has no digits
+   bn_zero(k);
+   bad[0] += recode_binary(d, k) != 0 || recode_sliding(d, k, 4) != 0 || recode_wnaf(d, k, 4) != 0;
+
+   printf("%s\n", bad[0] ? "BINARY MISMATCH" : "BINARY OK");
+   printf("%s\n", bad[1] ? "WINDOW MISMATCH" : "WINDOW OK");
+   printf("%s\n", bad[2] ? "SLIDING MISMATCH" : "SLIDING OK");
+   printf("%s\n", bad[3] ? "WNAF MISMATCH" : "WNAF OK");
+   printf("%s\n", bad[4] ? "COMB MISMATCH" : "COMB OK");
+
+   bn_free(k);
+
+   return 0;
+}
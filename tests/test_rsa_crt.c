@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include "rsa.h"
+
+int main()
+{
+   bn_t *p = bn_from_str(bn_alloc(32), "D526CA59E01656388D727223E4727ACEFB7C236072DE2F0ADD2835F2BCE8A787");
+   bn_t *q = bn_from_str(bn_alloc(32), "D10BF3D514FBBD8CB4299691EEB1316BF48FD32FAED002E1E292877641AA9F57");
+   bn_t *e = bn_from_bin(bn_alloc(64), "\x01\x00\x01", 3);
+
+   rsa_key_t *key = rsa_key_init(p, q, e);
+
+   bn_t *m1 = bn_from_bin(bn_alloc(64), "Hello World", 12);
+   bn_t *m2 = bn_alloc(64);
+   bn_t *m3 = bn_alloc(64);
+
+   bn_t *c = bn_alloc(64);
+
+   // RSA Encryption
+   // c = m1 ^ e % N
+   rsa_public(c, m1, key);
+
+   // RSA Decryption, without CRT
+   // m2 = c ^ d % N
+   bn_pow_mod(m2, c, key->d, key->N);
+
+   // RSA Decryption, with CRT, on one and two threads
+   rsa_private(m3, c, key);
+   printf("%s\n", bn_cmp(m2, m3) == BN_CMP_E ? "CRT OK" : "CRT MISMATCH");
+
+   key->threads = 1;
+   rsa_private(m3, c, key);
+   printf("%s\n", bn_cmp(m2, m3) == BN_CMP_E ? "CRT (threads) OK" : "CRT (threads) MISMATCH");
+
+   s8 plain[64];
+   bn_to_bin(plain, m3);
+
+   printf("%s\n", &plain[52]);
+
+   rsa_key_free(key);
+
+   bn_free(p);
+   bn_free(q);
+   bn_free(e);
+   bn_free(m1);
+   bn_free(m2);
+   bn_free(m3);
+   bn_free(c);
+
+   return 0;
+}
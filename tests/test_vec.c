@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include "bn.h"
+#include "mt19937.h"
+
+// Not a multiple of any SIMD width, so that the tail is exercised too
+#define CNT 13
+
+static mt19937_ctxt_t mt;
+
+// Random limbs in every limb of A
+static bn_t *rand_bn(bn_t *a)
+{
+   s8 buf[LIMBS_TO_BYTES(a->n_limbs)];
+
+   for(int i = 0; i < (int)sizeof(buf); i++)
+      buf[i] = (s8)mt19937_update(&mt);
+
+   return bn_from_bin(bn_zero(a), buf, sizeof(buf));
+}
+
+// Every element-wise operation in one layout, against bn_* one element at a time
+static int check(int size, int layout)
+{
+   bn_t *n = rand_bn(bn_alloc(size)), *r = bn_alloc(size), *e = bn_alloc(size);
+   bn_t *x[CNT], *y[CNT];
+   bn_vec_t *a = bn_vec_alloc(CNT, size, layout), *b = bn_vec_alloc(CNT, size, layout);
+   bn_vec_t *d = bn_vec_alloc(CNT, size, layout);
+   int bad = 0;
+
+   bn_setbit(n, 0);
+
+   for(int i = 0; i < CNT; i++)
+   {
+      x[i] = bn_reduce(rand_bn(bn_alloc(size)), n);
+      y[i] = bn_reduce(rand_bn(bn_alloc(size)), n);
+
+      // Zero and N - 1 as well
+      if(i == 0)
+         bn_zero(x[i]);
+      if(i == 1)
+         bn_sub_ui(y[i], bn_zero(y[i]), 1, n);
+
+      bn_vec_set(a, i, x[i]);
+      bn_vec_set(b, i, y[i]);
+   }
+
+   bn_vec_add(d, a, b, n);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(bn_vec_get(r, d, i), bn_add(e, x[i], y[i], n)) != BN_CMP_E;
+
+   bn_vec_sub(d, a, b, n);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(bn_vec_get(r, d, i), bn_sub(e, x[i], y[i], n)) != BN_CMP_E;
+
+   bn_vec_mon_mul(d, a, b, n);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(bn_vec_get(r, d, i), bn_mon_mul(e, x[i], y[i], n)) != BN_CMP_E;
+
+   // D = A, and back
+   bn_vec_to_mon(d, a, n);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(bn_vec_get(r, d, i), bn_to_mon(bn_copy(e, x[i]), n)) != BN_CMP_E;
+
+   bn_vec_from_mon(d, d, n);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(bn_vec_get(r, d, i), x[i]) != BN_CMP_E;
+
+   // Elements of any value
+   for(int i = 0; i < CNT; i++)
+      bn_vec_set(a, i, rand_bn(e));
+
+   bn_vec_reduce(d, a, n);
+
+   for(int i = 0; i < CNT; i++)
+      bad += bn_cmp(bn_vec_get(r, d, i), bn_reduce(bn_vec_get(e, a, i), n)) != BN_CMP_E;
+
+   for(int i = 0; i < CNT; i++)
+   {
+      bn_free(x[i]);
+      bn_free(y[i]);
+   }
+
+   bn_vec_free(a);
+   bn_vec_free(b);
+   bn_vec_free(d);
+
+   bn_free(n);
+   bn_free(r);
+   bn_free(e);
+
+   return bad;
+}
+
+int main()
+{
+   static const int sizes[] = { 8, 32, 48, 128 };
+   int bad[2] = { 0 };
+
+   mt19937_init(&mt, 24);
+
+   for(int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+   {
+      bad[BN_VEC_AOS] += check(sizes[s], BN_VEC_AOS);
+      bad[BN_VEC_SOA] += check(sizes[s], BN_VEC_SOA);
+   }
+
+   printf("%s\n", bad[BN_VEC_AOS] ? "VEC (AoS) MISMATCH" : "VEC (AoS) OK");
+   printf("%s\n", bad[BN_VEC_SOA] ? "VEC (SoA) MISMATCH" : "VEC (SoA) OK");
+
+   return 0;
+}